@@ -0,0 +1,379 @@
+#include "LedAccuracy.h"
+
+#ifndef ARDUINO
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+/**
+ * Reads a 16-bit value as a fraction in the range min..max
+ */
+static float fraction(const uint8_t *p, const float min, const float max) {
+	return min + (max - min) * (p[0] << 8 | p[1]) / 65535.0f;
+}
+
+/**
+ * Value of a sorted vector at a percentile
+ */
+static float percentile(const std::vector<float> &sorted, const float p) {
+	if (sorted.empty()) return 0;
+	size_t i = static_cast<size_t>(p / 100 * (sorted.size() - 1) + 0.5f);
+	return sorted[i];
+}
+
+LedAccuracy::LedAccuracy(const uint32_t seed) {
+	state_ = seed != 0 ? seed : 1;
+}
+
+LedAccuracyReport LedAccuracy::sweep(const uint16_t calibrations, const uint32_t targets) {
+	LedAccuracyReport total = {};
+	std::vector<Luv> luv(targets);
+	double nanoseconds = 0;
+	for (uint16_t i = 0; i < calibrations; ++i) {
+		LedCalibration calibration = randomCalibration();
+		for (uint32_t j = 0; j < targets; ++j) {
+			luv[j] = randomTarget(calibration);
+		}
+		LedAccuracyReport report = measure(calibration, luv.data(), targets);
+
+		// Percentiles of the whole sweep would need all distances, worst calibration is what matters anyway
+		total.count += report.count;
+		total.invalid += report.invalid;
+		if (report.maxDeltaUv > total.maxDeltaUv) total.maxDeltaUv = report.maxDeltaUv;
+		if (report.p50DeltaUv > total.p50DeltaUv) total.p50DeltaUv = report.p50DeltaUv;
+		if (report.p99DeltaUv > total.p99DeltaUv) total.p99DeltaUv = report.p99DeltaUv;
+		if (report.p999DeltaUv > total.p999DeltaUv) total.p999DeltaUv = report.p999DeltaUv;
+		if (report.maxDeltaL > total.maxDeltaL) total.maxDeltaL = report.maxDeltaL;
+		nanoseconds += static_cast<double>(report.nanosecondsPerSolve) * report.count;
+	}
+	total.nanosecondsPerSolve = total.count > 0 ? static_cast<float>(nanoseconds / total.count) : 0.0f;
+	return total;
+}
+
+LedRobustnessReport LedAccuracy::robustness(const uint16_t calibrations) {
+	LedRobustnessReport report = {};
+	LedBufferOutput<10> output;
+	LedEngine closed(output, 0, 1, 2, 3, 4, 4095);
+	LedEngine newton(output, 5, 6, 7, 8, 9, 4095);
+	newton.setSolverMode(LedSolverMode::Newton);
+	LedEngine *const engines[2] = { &closed, &newton };
+	for (LedEngine *engine : engines) engine->setOnOff(true);
+
+	// Default calibration first, its fits are not exact for additive mixing
+	for (uint16_t i = 0; i <= calibrations; ++i) {
+		LedCalibration calibration = i == 0 ? LedCalibration::defaults() : randomCalibration();
+		LedModel model(calibration);
+		for (LedEngine *engine : engines) engine->calibrate(model);
+		const LedSolver &solver = model.getSolver();
+		const Luv *leds[3] = { &calibration.redUv, &calibration.greenUv, &calibration.blueUv };
+		std::vector<Luv> targets;
+
+		// Primaries and edges, targets at the vertices appear once per edge
+		for (uint8_t e = 0; e < 3; ++e) {
+			const Luv &p0 = *leds[e];
+			const Luv &p1 = *leds[(e + 1) % 3];
+			for (uint8_t k = 0; k <= 64; ++k) {
+				float t = k / 64.0f;
+				for (float L : { 0.0f, 50.0f, 100.0f }) {
+					targets.push_back({ L, p0.u + (p1.u - p0.u) * t, p0.v + (p1.v - p0.v) * t });
+				}
+			}
+		}
+
+		// Inside the gamut
+		for (uint8_t a = 0; a <= 32; ++a) {
+			for (uint8_t b = 0; a + b <= 32; ++b) {
+				float wa = a / 32.0f;
+				float wb = b / 32.0f;
+				float wc = 1 - wa - wb;
+				targets.push_back({ 60, wa * leds[0]->u + wb * leds[1]->u + wc * leds[2]->u,
+					wa * leds[0]->v + wb * leds[1]->v + wc * leds[2]->v });
+			}
+		}
+
+		// Outside the gamut, including negative coordinates
+		for (float u = -1; u <= 1.5f; u += 0.0625f) {
+			for (float v = -1; v <= 1.5f; v += 0.0625f) targets.push_back({ 70, u, v });
+		}
+
+		// Non-finite lightness and coordinates
+		const float special[] = { NAN, INFINITY, -INFINITY };
+		for (float x : special) {
+			targets.push_back({ x, 0.2f, 0.45f });
+			targets.push_back({ 50, x, 0.45f });
+			targets.push_back({ 50, 0.2f, x });
+			targets.push_back({ x, x, x });
+			targets.push_back({ 50, leds[0]->u, x });
+		}
+
+		for (const Luv &target : targets) {
+			++report.count;
+			if (!robust_(solver, engines, target)) ++report.violations;
+		}
+	}
+	return report;
+}
+
+LedAccuracyReport LedAccuracy::measure(const LedCalibration &calibration, const Luv targets[], const uint32_t count) {
+	LedModel model(calibration);
+	LedBufferOutput<5> output;
+	LedEngine engine(output, 0, 1, 2, 3, 4, 65535);
+	engine.calibrate(model);
+
+	// Solve into 16-bit pixels which keep the levels at full resolution
+	std::vector<uint8_t> buffer(count * 6);
+	LedPixels pixels = { buffer.data(), count, 6, 0, 2, 4, 2 };
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	engine.setCie1976Ucs(targets, pixels);
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	LedAccuracyReport report = {};
+	report.count = count;
+	report.nanosecondsPerSolve = count > 0
+		? static_cast<float>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()) / count : 0.0f;
+
+	std::vector<float> deltaUv;
+	deltaUv.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t level[3];
+		for (uint8_t c = 0; c < 3; ++c) {
+			uint32_t x = buffer[i * 6 + c * 2] << 8 | buffer[i * 6 + c * 2 + 1];
+			level[c] = x + (x >> 15);
+		}
+		Luv produced = forward(calibration, level);
+		if (produced.L != produced.L || produced.u != produced.u || produced.v != produced.v) {
+			++report.invalid;
+			continue;
+		}
+		float du = produced.u - targets[i].u;
+		float dv = produced.v - targets[i].v;
+		deltaUv.push_back(sqrtf(du * du + dv * dv));
+
+		// Lightness is only reached when no LED had to be limited to full power
+		if (level[0] < 65536 && level[1] < 65536 && level[2] < 65536) {
+			float deltaL = fabsf(produced.L - targets[i].L);
+			if (deltaL > report.maxDeltaL) report.maxDeltaL = deltaL;
+		}
+	}
+
+	std::sort(deltaUv.begin(), deltaUv.end());
+	report.maxDeltaUv = deltaUv.empty() ? 0.0f : deltaUv.back();
+	report.p50DeltaUv = percentile(deltaUv, 50);
+	report.p99DeltaUv = percentile(deltaUv, 99);
+	report.p999DeltaUv = percentile(deltaUv, 99.9f);
+	return report;
+}
+
+LedCalibration LedAccuracy::randomCalibration() {
+	Luv redUv = { 100, uniform_(0.50f, 0.58f), uniform_(0.50f, 0.53f) };
+	Luv greenUv = { 100, uniform_(0.03f, 0.12f), uniform_(0.55f, 0.59f) };
+	Luv blueUv = { 100, uniform_(0.14f, 0.20f), uniform_(0.10f, 0.20f) };
+	return idealCalibration(redUv, greenUv, blueUv, uniform_(0.2f, 2.0f), uniform_(0.2f, 2.0f), uniform_(0.2f, 2.0f));
+}
+
+Luv LedAccuracy::randomTarget(const LedCalibration &calibration) {
+
+	// Uniform barycentric coordinates by folding the unit square
+	float a = uniform_(0, 1);
+	float b = uniform_(0, 1);
+	if (a + b > 1) {
+		a = 1 - a;
+		b = 1 - b;
+	}
+	float c = 1 - a - b;
+	Luv target = {
+		uniform_(20, 100),
+		a * calibration.redUv.u + b * calibration.greenUv.u + c * calibration.blueUv.u,
+		a * calibration.redUv.v + b * calibration.greenUv.v + c * calibration.blueUv.v
+	};
+	return target;
+}
+
+LedCalibration LedAccuracy::idealCalibration(const Luv redUv, const Luv greenUv, const Luv blueUv, const float redLum,
+	const float greenLum, const float blueLum) {
+
+	LedCalibration calibration = LedCalibration::defaults();
+	calibration.redUv = redUv;
+	calibration.greenUv = greenUv;
+	calibration.blueUv = blueUv;
+	calibration.redLum = redLum;
+	calibration.greenLum = greenLum;
+	calibration.blueLum = blueLum;
+	idealFit_(redUv, redLum, greenUv, greenLum, calibration.redToGreenFit);
+	idealFit_(greenUv, greenLum, blueUv, blueLum, calibration.greenToBlueFit);
+	idealFit_(blueUv, blueLum, redUv, redLum, calibration.blueToRedFit);
+	return calibration;
+}
+
+Luv LedAccuracy::forward(const LedCalibration &calibration, const uint32_t level[3]) {
+
+	// Mixture in u', v' is the average of LED coordinates weighted by luminance divided by v'
+	double w[3] = {
+		static_cast<double>(calibration.redLum) * level[0] / calibration.redUv.v,
+		static_cast<double>(calibration.greenLum) * level[1] / calibration.greenUv.v,
+		static_cast<double>(calibration.blueLum) * level[2] / calibration.blueUv.v
+	};
+	double sum = w[0] + w[1] + w[2];
+	Luv luv;
+	if (!(sum > 0)) {
+		luv.L = NAN;
+		luv.u = NAN;
+		luv.v = NAN;
+		return luv;
+	}
+	luv.u = static_cast<float>((w[0] * calibration.redUv.u + w[1] * calibration.greenUv.u + w[2] * calibration.blueUv.u) / sum);
+	luv.v = static_cast<float>((w[0] * calibration.redUv.v + w[1] * calibration.greenUv.v + w[2] * calibration.blueUv.v) / sum);
+
+	// Lightness 100 is all LEDs at full power
+	double Y = (static_cast<double>(calibration.redLum) * level[0] + static_cast<double>(calibration.greenLum) * level[1]
+		+ static_cast<double>(calibration.blueLum) * level[2]) / ((calibration.redLum + calibration.greenLum + calibration.blueLum) * 65536.0);
+	luv.L = LedLightness::fromLuma(Y < 1 ? static_cast<uint16_t>(Y * 65535 + 0.5) : 65535);
+	return luv;
+}
+
+void LedAccuracy::print(const LedAccuracyReport &report) {
+	printf("solves            %u\n", report.count);
+	printf("invalid           %u\n", report.invalid);
+	printf("delta u'v' max    %.6f\n", report.maxDeltaUv);
+	printf("delta u'v' p50    %.6f\n", report.p50DeltaUv);
+	printf("delta u'v' p99    %.6f\n", report.p99DeltaUv);
+	printf("delta u'v' p99.9  %.6f\n", report.p999DeltaUv);
+	printf("delta L max       %.4f\n", report.maxDeltaL);
+	printf("ns per solve      %.1f\n", report.nanosecondsPerSolve);
+}
+
+void LedAccuracy::print(const LedRobustnessReport &report) {
+	printf("robustness solves %u\n", report.count);
+	printf("violations        %u\n", report.violations);
+}
+
+void LedAccuracy::fuzz(const uint8_t *data, const size_t size) {
+
+	// Calibration from the first 18 bytes
+	if (size < 18) return;
+	Luv redUv = { 100, fraction(data, 0.50f, 0.58f), fraction(data + 2, 0.50f, 0.53f) };
+	Luv greenUv = { 100, fraction(data + 4, 0.03f, 0.12f), fraction(data + 6, 0.55f, 0.59f) };
+	Luv blueUv = { 100, fraction(data + 8, 0.14f, 0.20f), fraction(data + 10, 0.10f, 0.20f) };
+	LedCalibration calibration = idealCalibration(redUv, greenUv, blueUv,
+		fraction(data + 12, 0.2f, 2.0f), fraction(data + 14, 0.2f, 2.0f), fraction(data + 16, 0.2f, 2.0f));
+	data += 18;
+	size_t remaining = size - 18;
+
+	// Next 12 bytes as such are a target, any bit pattern including NaN and infinities must give a valid state
+	if (remaining >= sizeof(Luv)) {
+		Luv target;
+		memcpy(&target, data, sizeof(target));
+		data += sizeof(target);
+		remaining -= sizeof(target);
+		LedBufferOutput<5> output;
+		LedEngine engine(output, 0, 1, 2, 3, 4, 4095);
+		engine.calibrate(calibration);
+		engine.setCie1976Ucs(target);
+		LedState state = engine.getState();
+		float L = engine.getLightness();
+		if (L != L || state.duty[0] > 4095 || state.duty[1] > 4095 || state.duty[2] > 4095) abort();
+	}
+
+	// Rest are barycentric coordinates and lightness of targets within the gamut, which must be solved accurately
+	std::vector<Luv> targets;
+	for (; remaining >= 6; data += 6, remaining -= 6) {
+		float a = fraction(data, 0, 1);
+		float b = fraction(data + 2, 0, 1);
+		if (a + b > 1) {
+			a = 1 - a;
+			b = 1 - b;
+		}
+		float c = 1 - a - b;
+		Luv target = {
+			fraction(data + 4, 20, 100),
+			a * calibration.redUv.u + b * calibration.greenUv.u + c * calibration.blueUv.u,
+			a * calibration.redUv.v + b * calibration.greenUv.v + c * calibration.blueUv.v
+		};
+		targets.push_back(target);
+	}
+	if (!targets.empty()) {
+		LedAccuracyReport report = measure(calibration, targets.data(), static_cast<uint32_t>(targets.size()));
+		if (report.invalid > 0 || report.maxDeltaUv > MAX_DELTA_UV || report.maxDeltaL > MAX_DELTA_L) abort();
+	}
+}
+
+float LedAccuracy::uniform_(const float min, const float max) {
+
+	// Xorshift
+	state_ ^= state_ << 13;
+	state_ ^= state_ >> 17;
+	state_ ^= state_ << 5;
+	return min + (max - min) * (state_ >> 8) * (1.0f / 16777216);
+}
+
+void LedAccuracy::idealFit_(const Luv P0, const float lum0, const Luv P1, const float lum1, float fit[3]) {
+
+	// Additive mixing weights per unit level, the mixture is at normalized distance x = w1 / (w0 + w1) from the first
+	// LED when the levels sum up to one
+	double w0 = lum0 / P0.v;
+	double w1 = lum1 / P1.v;
+	if (w0 == w1) w1 *= 1.000001;
+
+	// First LED's level vs 1 - x when the second LED is more efficient, otherwise vs x
+	if (w1 > w0) {
+		fit[0] = static_cast<float>(w1 / (w1 - w0));
+		fit[1] = 0;
+		fit[2] = static_cast<float>(w0 / (w1 - w0));
+	}
+	else {
+		float k = static_cast<float>(w1 / (w0 - w1));
+		fit[0] = -k;
+		fit[1] = k;
+		fit[2] = k;
+	}
+}
+
+bool LedAccuracy::robust_(const LedSolver &solver, LedEngine *const engines[2], const Luv target) {
+
+	// Raw levels of each LED, negated comparisons catch NaN. Fits are floats, so a fit evaluated at the end of the
+	// gamut may exceed one by their rounding error.
+	const LedSolverChannel *channels[3] = { &solver.red, &solver.green, &solver.blue };
+	for (const LedSolverChannel *channel : channels) {
+		double level = channel->level(target.u, target.v);
+		if (!(level >= 0 && level <= 1 + 1e-6)) return false;
+	}
+	LedUvNode node = solver.node(target.u, target.v);
+	if (!(node.R >= 0 && node.R <= 1 && node.G >= 0 && node.G <= 1 && node.B >= 0 && node.B <= 1)) return false;
+
+	// Engines solve with their own square root and division, and Newton mode starts from the previous target
+	for (uint8_t i = 0; i < 2; ++i) {
+		engines[i]->setCie1976Ucs(target);
+		LedState state = engines[i]->getState();
+		float L = engines[i]->getLightness();
+		if (state.duty[0] > 4095 || state.duty[1] > 4095 || state.duty[2] > 4095 || !(L >= 0 && L <= 100)) return false;
+	}
+	return true;
+}
+
+#ifdef LED_ENGINE_ACCURACY_MAIN
+int main(int argc, char **argv) {
+	uint16_t calibrations = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 100;
+	uint32_t targets = argc > 2 ? static_cast<uint32_t>(atol(argv[2])) : 10000;
+	uint32_t seed = argc > 3 ? static_cast<uint32_t>(atol(argv[3])) : 1;
+	LedAccuracy accuracy(seed);
+	LedAccuracyReport report = accuracy.sweep(calibrations, targets);
+	LedAccuracy::print(report);
+	LedRobustnessReport robustness = accuracy.robustness(calibrations);
+	LedAccuracy::print(robustness);
+	return report.invalid > 0 || report.maxDeltaUv > LedAccuracy::MAX_DELTA_UV || robustness.violations > 0 ? 1 : 0;
+}
+#endif
+
+#ifdef LED_ENGINE_FUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	LedAccuracy::fuzz(data, size);
+	return 0;
+}
+#endif
+
+#endif
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ARDUINO
+
+#include "LedEngine.h"
+
+/**
+ * Statistics of a solver accuracy run
+ */
+struct LedAccuracyReport {
+	/**
+	 * Number of solved targets
+	 */
+	uint32_t count;
+
+	/**
+	 * Number of solves which produced no light at all
+	 */
+	uint32_t invalid;
+
+	/**
+	 * Largest distance in u', v' between target and the color produced by the solved levels
+	 */
+	float maxDeltaUv;
+
+	/**
+	 * Median distance in u', v'
+	 */
+	float p50DeltaUv;
+
+	/**
+	 * 99th percentile distance in u', v'
+	 */
+	float p99DeltaUv;
+
+	/**
+	 * 99.9th percentile distance in u', v'
+	 */
+	float p999DeltaUv;
+
+	/**
+	 * Largest lightness error of targets whose lightness is achievable
+	 */
+	float maxDeltaL;
+
+	/**
+	 * Average batch solve time per target in nanoseconds
+	 */
+	float nanosecondsPerSolve;
+};
+
+/**
+ * Statistics of a solver robustness run
+ */
+struct LedRobustnessReport {
+	/**
+	 * Number of solved targets
+	 */
+	uint32_t count;
+
+	/**
+	 * Number of solves with a NaN level, a level outside 0..1, a duty above the PWM range or a NaN lightness
+	 */
+	uint32_t violations;
+};
+
+/**
+ * Accuracy and robustness harness for the chromaticity solver on host builds
+ *
+ * Solved levels are checked against a forward model of additive mixing: LED chromaticities weighted by luminous flux
+ * times level divided by v'. Random calibrations get rational fits which are exact for that model, so any error that
+ * remains comes from the solver itself and from quantization.
+ *
+ * Deterministic sweep, e.g. before and after changing the solver:
+ *
+ *     LedAccuracy accuracy(1);
+ *     LedAccuracyReport report = accuracy.sweep(100, 10000);
+ *     LedAccuracy::print(report);
+ *
+ * Robustness run over the whole gamut, its vertices and edges, targets outside of it and non-finite targets:
+ *
+ *     LedRobustnessReport robustness = accuracy.robustness(100);
+ *
+ * Building with LED_ENGINE_ACCURACY_MAIN defined adds a main function which runs both and building with
+ * LED_ENGINE_FUZZER defined adds a libFuzzer entry point:
+ *
+ *     clang++ -g -O1 -fsanitize=fuzzer,address,undefined -DLED_ENGINE_FUZZER Led*.cpp -o led_fuzzer
+ */
+class LedAccuracy {
+public:
+	/**
+	 * Largest distance in u', v' accepted by the fuzzer for targets within the gamut
+	 */
+	static constexpr float MAX_DELTA_UV = 0.002f;
+
+	/**
+	 * Largest lightness error accepted by the fuzzer for achievable lightness
+	 */
+	static constexpr float MAX_DELTA_L = 0.1f;
+
+	/**
+	 * Constructor
+	 *
+	 * \param seed Random seed, the same seed always generates the same calibrations and targets
+	 */
+	LedAccuracy(const uint32_t seed = 1);
+
+	/**
+	 * Solves random targets with random calibrations
+	 *
+	 * \param calibrations Number of calibrations
+	 * \param targets Number of targets per calibration
+	 * \return Statistics
+	 */
+	LedAccuracyReport sweep(const uint16_t calibrations, const uint32_t targets);
+
+	/**
+	 * Solves the default and random calibrations at targets where the solver is prone to fail
+	 *
+	 * Targets are the LED primaries, a grid along each gamut edge, a barycentric grid inside the gamut, a u', v' grid
+	 * reaching far outside of it and NaN and infinite lightness and coordinates. Every target is solved by the
+	 * runtime solver of each LED and by engines in closed form and Newton mode.
+	 *
+	 * \param calibrations Number of random calibrations
+	 * \return Statistics
+	 */
+	LedRobustnessReport robustness(const uint16_t calibrations);
+
+	/**
+	 * Solves targets with a calibration
+	 *
+	 * \param calibration Calibration parameters
+	 * \param targets Targets
+	 * \param count Number of targets
+	 * \return Statistics
+	 */
+	static LedAccuracyReport measure(const LedCalibration &calibration, const Luv targets[], const uint32_t count);
+
+	/**
+	 * Generates a random calibration with LEDs in typical red, green and blue regions and fits matching additive mixing
+	 *
+	 * \return Calibration parameters
+	 */
+	LedCalibration randomCalibration();
+
+	/**
+	 * Generates a random target within the gamut of a calibration
+	 *
+	 * Lightness is at least 20, below that quantization of the dimmest LED to 16 bits dominates the error.
+	 *
+	 * \param calibration Calibration parameters
+	 * \return CIE 1976 UCS coordinates and lightness
+	 */
+	Luv randomTarget(const LedCalibration &calibration);
+
+	/**
+	 * Builds calibration whose fits are exact for additive mixing of the LEDs
+	 *
+	 * \param redUv CIE 1976 UCS coordinates for red LED
+	 * \param greenUv CIE 1976 UCS coordinates for green LED
+	 * \param blueUv CIE 1976 UCS coordinates for blue LED
+	 * \param redLum Luminous flux for red LED
+	 * \param greenLum Luminous flux for green LED
+	 * \param blueLum Luminous flux for blue LED
+	 * \return Calibration parameters
+	 */
+	static LedCalibration idealCalibration(const Luv redUv, const Luv greenUv, const Luv blueUv, const float redLum,
+		const float greenLum, const float blueLum);
+
+	/**
+	 * Forward model, computes the color produced by LED levels with additive mixing
+	 *
+	 * \param calibration Calibration parameters
+	 * \param level Red, green and blue levels, 65536 is full power
+	 * \return CIE 1976 UCS coordinates and lightness, lightness 100 is all LEDs at full power
+	 */
+	static Luv forward(const LedCalibration &calibration, const uint32_t level[3]);
+
+	/**
+	 * Prints a report to standard output
+	 *
+	 * \param report Statistics
+	 */
+	static void print(const LedAccuracyReport &report);
+
+	/**
+	 * Prints a robustness report to standard output
+	 *
+	 * \param report Statistics
+	 */
+	static void print(const LedRobustnessReport &report);
+
+	/**
+	 * Checks a single fuzzer input, aborts if the solver misbehaves
+	 *
+	 * \param data Input bytes, calibration and targets are decoded from them
+	 * \param size Number of bytes
+	 */
+	static void fuzz(const uint8_t *data, const size_t size);
+
+private:
+	/**
+	 * Random generator state
+	 */
+	uint32_t state_;
+
+	/**
+	 * Generates a random number
+	 *
+	 * \param min Smallest value
+	 * \param max Largest value
+	 * \return Uniformly distributed value
+	 */
+	float uniform_(const float min, const float max);
+
+	/**
+	 * Computes rational fit of the first LED's level vs normalized distance along an edge for additive mixing
+	 *
+	 * \param P0 CIE 1976 UCS coordinates for the first LED
+	 * \param lum0 Luminous flux for the first LED
+	 * \param P1 CIE 1976 UCS coordinates for the second LED
+	 * \param lum1 Luminous flux for the second LED
+	 * \param fit Rational function coefficients
+	 */
+	static void idealFit_(const Luv P0, const float lum0, const Luv P1, const float lum1, float fit[3]);
+
+	/**
+	 * Solves a target and checks the levels
+	 *
+	 * \param solver Solver coefficients
+	 * \param engines Engines calibrated with the same model, each in a different solver mode
+	 * \param target Target
+	 * \return Did every level and duty stay within range
+	 */
+	static bool robust_(const LedSolver &solver, LedEngine *const engines[2], const Luv target);
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include <string.h>
+#include "LedApa102.h"
+
+/**
+ * Marker bits of the pixel header byte, the low five bits are global brightness
+ */
+static const uint8_t HEADER = 0xE0;
+
+LedApa102Strip::LedApa102Strip(LedSpiBus &bus, uint8_t *buffer, const uint16_t count) {
+	bus_ = &bus;
+	buffer_ = buffer;
+	count_ = count;
+
+	// Start frame, pixels off and end frame are all zeros apart from the pixel headers
+	memset(buffer_, 0, bufferSize(count_));
+	setBrightness(MAX_BRIGHTNESS);
+}
+
+uint16_t LedApa102Strip::getCount() {
+	return count_;
+}
+
+uint8_t LedApa102Strip::getBrightness() {
+	return brightness_;
+}
+
+void LedApa102Strip::setBrightness(const uint8_t brightness) {
+	brightness_ = brightness < MAX_BRIGHTNESS ? brightness : MAX_BRIGHTNESS;
+	uint8_t *header = buffer_ + 4;
+	for (uint16_t i = 0; i < count_; ++i) {
+		header[4 * static_cast<uint32_t>(i)] = HEADER | brightness_;
+	}
+}
+
+LedPixels LedApa102Strip::getPixels(const uint16_t first, const uint16_t count) {
+	uint16_t start = first < count_ ? first : count_;
+	uint16_t n = count_ - start;
+	if (count < n) n = count;
+
+	// Header, blue, green, red
+	LedPixels pixels = { buffer_ + 4 + 4 * static_cast<uint32_t>(start), n, 4, 3, 2, 1, 1 };
+	return pixels;
+}
+
+const uint8_t *LedApa102Strip::getBuffer() {
+	return buffer_;
+}
+
+bool LedApa102Strip::show() {
+	return bus_->write(buffer_, bufferSize(count_));
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "LedOutput.h"
+#include "LedSpi.h"
+
+/**
+ * APA102 and SK9822 addressable LED strip
+ *
+ * Pixels live in a caller owned buffer which is kept in the wire format: a start frame of four zero bytes, four bytes
+ * per pixel (global brightness byte, blue, green, red) and an end frame. Engines convert colors straight into the
+ * buffer with the batch setters through getPixels and show sends the buffer as is in one write, so the buffer can be
+ * placed in DMA capable memory and nothing is copied:
+ *
+ *     static uint8_t buffer[LedApa102Strip::bufferSize(300)];
+ *     LedApa102Strip strip(bus, buffer, 300);
+ *     engine.setCie1976Ucs(targets, strip.getPixels());
+ *     strip.show();
+ */
+class LedApa102Strip {
+public:
+	/**
+	 * Maximum global brightness
+	 */
+	static const uint8_t MAX_BRIGHTNESS = 31;
+
+	/**
+	 * Get frame buffer size needed for a strip
+	 *
+	 * End frame has a clock edge for every two pixels for APA102 and 32 extra zero bits for SK9822.
+	 *
+	 * \param count Number of pixels
+	 * \return Frame buffer size in bytes
+	 */
+	static constexpr uint32_t bufferSize(const uint16_t count) {
+		return 4 + 4 * static_cast<uint32_t>(count) + 4 + (count + 15) / 16;
+	}
+
+	/**
+	 * Constructor, formats the buffer with all pixels off at full global brightness
+	 *
+	 * \param bus SPI bus
+	 * \param buffer Frame buffer of at least bufferSize(count) bytes
+	 * \param count Number of pixels
+	 */
+	LedApa102Strip(LedSpiBus &bus, uint8_t *buffer, const uint16_t count);
+
+	/**
+	 * Get number of pixels
+	 *
+	 * \return Number of pixels
+	 */
+	uint16_t getCount();
+
+	/**
+	 * Get global brightness
+	 *
+	 * \return Global brightness in the range 0..31
+	 */
+	uint8_t getBrightness();
+
+	/**
+	 * Sets global brightness of all pixels
+	 *
+	 * \param brightness Global brightness in the range 0..31, higher values are limited
+	 */
+	void setBrightness(const uint8_t brightness);
+
+	/**
+	 * Get view of pixel colors in the frame buffer
+	 *
+	 * \param first Index of the first pixel in the view
+	 * \param count Maximum number of pixels in the view
+	 * \return 8-bit pixels from first to the end of the strip or count pixels, whichever comes first
+	 */
+	LedPixels getPixels(const uint16_t first = 0, const uint16_t count = 0xFFFF);
+
+	/**
+	 * Get frame buffer
+	 *
+	 * \return Frame buffer in the wire format
+	 */
+	const uint8_t *getBuffer();
+
+	/**
+	 * Sends the frame buffer to the strip
+	 *
+	 * \return Were all bytes written
+	 */
+	bool show();
+
+private:
+	/**
+	 * SPI bus
+	 */
+	LedSpiBus *bus_;
+
+	/**
+	 * Frame buffer
+	 */
+	uint8_t *buffer_;
+
+	/**
+	 * Number of pixels
+	 */
+	uint16_t count_;
+
+	/**
+	 * Global brightness
+	 */
+	uint8_t brightness_ = MAX_BRIGHTNESS;
+};
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "LedOutput.h"
+
+#if !defined(ARDUINO) || defined(ESP32)
+#include <atomic>
+#define LED_ASYNC_ATOMIC 1
+#endif
+
+#ifndef ARDUINO
+#include <chrono>
+#include <thread>
+#endif
+
+/**
+ * Output backend which hands finished frames over to another thread or task for writing
+ *
+ * Engines stage duties and flush in the caller's context as usual, but a flush only publishes a snapshot of all
+ * channels. The output side calls service, or on host builds runs the built-in thread with start, and writes the
+ * newest snapshot to the wrapped backend. Slow bus writes therefore never stall the thread setting the colors.
+ *
+ * Snapshots are exchanged through a three slot single producer single consumer ring: the producer always has a free
+ * slot, the consumer always gets the newest complete frame and frames which were superseded before the output side
+ * got to them are coalesced away. Neither side waits for the other.
+ *
+ * Engines must be constructed, i.e. channels attached, before the output side starts.
+ *
+ * \tparam Channels Number of channels, channel numbers of the wrapped backend must be less than this
+ */
+template <uint16_t Channels>
+class LedAsyncOutput : public LedOutput {
+public:
+	/**
+	 * Constructor
+	 *
+	 * \param output Backend which writes the frames
+	 */
+	LedAsyncOutput(LedOutput &output) {
+		output_ = &output;
+	}
+
+	LedAsyncOutput(const LedAsyncOutput &) = delete;
+
+	LedAsyncOutput &operator=(const LedAsyncOutput &) = delete;
+
+#ifndef ARDUINO
+	~LedAsyncOutput() {
+		stop();
+	}
+#endif
+
+	void attach(const uint16_t channel, const uint16_t pwmRange) override {
+		if (channel >= Channels) return;
+		attached_[channel / 8] |= 1 << (channel % 8);
+		staged_[channel] = 0;
+		output_->attach(channel, pwmRange);
+	}
+
+	void set(const uint16_t channel, const uint16_t duty) override {
+		if (channel < Channels) staged_[channel] = duty;
+	}
+
+	/**
+	 * Writes the newest published frame to the wrapped backend, called by the output thread or task
+	 *
+	 * \return Was there a new frame
+	 */
+	bool service() {
+		if (!(load_() & FRESH)) return false;
+		front_ = exchange_(front_) & INDEX;
+
+		// Wrapped backend skips channels which have not changed
+		const uint16_t *frame = frames_[front_];
+		for (uint16_t i = 0; i < Channels; ++i) {
+			if (attached_[i / 8] & (1 << (i % 8))) {
+				output_->set(i, frame[i]);
+			}
+		}
+		output_->flush();
+		increment_(writtenCount_);
+		return true;
+	}
+
+	/**
+	 * Get number of frames written to the wrapped backend
+	 *
+	 * \return Number of written frames
+	 */
+	uint32_t getWrittenCount() {
+		return get_(writtenCount_);
+	}
+
+	/**
+	 * Get number of frames which were superseded before they were written
+	 *
+	 * \return Number of coalesced frames
+	 */
+	uint32_t getCoalescedCount() {
+		return get_(coalescedCount_);
+	}
+
+#ifndef ARDUINO
+	/**
+	 * Starts a thread which writes new frames at a fixed refresh rate
+	 *
+	 * \param refreshRate Frames per second
+	 */
+	void start(const uint16_t refreshRate) {
+		if (running_) return;
+		running_ = true;
+		thread_ = std::thread([this, refreshRate] {
+			std::chrono::nanoseconds period(1000000000LL / (refreshRate > 0 ? refreshRate : 1));
+			std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+			while (running_) {
+				service();
+				next += period;
+				std::this_thread::sleep_until(next);
+			}
+
+			// Latest frame must not be lost when stopping
+			service();
+		});
+	}
+
+	/**
+	 * Stops the output thread after writing the newest frame
+	 */
+	void stop() {
+		if (!thread_.joinable()) return;
+		running_ = false;
+		thread_.join();
+	}
+#endif
+
+protected:
+	void write_() override {
+		memcpy(frames_[back_], staged_, sizeof(staged_));
+		uint8_t previous = exchange_(back_ | FRESH);
+		back_ = previous & INDEX;
+		if (previous & FRESH) increment_(coalescedCount_);
+	}
+
+private:
+	/**
+	 * Slot index bits of the middle slot
+	 */
+	static const uint8_t INDEX = 0x03;
+
+	/**
+	 * Flag telling that the middle slot holds a frame the consumer has not taken yet
+	 */
+	static const uint8_t FRESH = 0x04;
+
+	/**
+	 * Backend which writes the frames
+	 */
+	LedOutput *output_;
+
+	/**
+	 * Duties staged by the engines
+	 */
+	uint16_t staged_[Channels] = {};
+
+	/**
+	 * Frame slots
+	 */
+	uint16_t frames_[3][Channels] = {};
+
+	/**
+	 * Slot being filled by the producer
+	 */
+	uint8_t back_ = 0;
+
+	/**
+	 * Slot being written out by the consumer
+	 */
+	uint8_t front_ = 1;
+
+	/**
+	 * Slot index of the newest published frame and fresh flag
+	 */
+#ifdef LED_ASYNC_ATOMIC
+	std::atomic<uint8_t> middle_{2};
+#else
+	volatile uint8_t middle_ = 2;
+#endif
+
+	/**
+	 * Bit mask of attached channels
+	 */
+	uint8_t attached_[(Channels + 7) / 8] = {};
+
+	/**
+	 * Number of frames written to the wrapped backend, updated by the output thread
+	 */
+#ifdef LED_ASYNC_ATOMIC
+	std::atomic<uint32_t> writtenCount_{0};
+#else
+	volatile uint32_t writtenCount_ = 0;
+#endif
+
+	/**
+	 * Number of frames superseded before they were written, updated by the producer
+	 */
+#ifdef LED_ASYNC_ATOMIC
+	std::atomic<uint32_t> coalescedCount_{0};
+#else
+	volatile uint32_t coalescedCount_ = 0;
+#endif
+
+#ifndef ARDUINO
+	/**
+	 * Output thread
+	 */
+	std::thread thread_;
+
+	/**
+	 * Should the output thread keep running?
+	 */
+	std::atomic<bool> running_{false};
+#endif
+
+	/**
+	 * Reads the middle slot
+	 *
+	 * \return Slot index and fresh flag
+	 */
+	uint8_t load_() {
+#ifdef LED_ASYNC_ATOMIC
+		return middle_.load(std::memory_order_acquire);
+#else
+		return middle_;
+#endif
+	}
+
+	/**
+	 * Swaps a slot with the middle slot
+	 *
+	 * \param value Slot index and fresh flag to put in the middle
+	 * \return Previous slot index and fresh flag of the middle
+	 */
+	uint8_t exchange_(const uint8_t value) {
+#ifdef LED_ASYNC_ATOMIC
+		return middle_.exchange(value, std::memory_order_acq_rel);
+#else
+		// Single threaded builds call service from the same context as the setters
+		uint8_t previous = middle_;
+		middle_ = value;
+		return previous;
+#endif
+	}
+
+	/**
+	 * Counts a frame, relaxed because readers only need the count itself
+	 *
+	 * \param counter Frame counter
+	 */
+#ifdef LED_ASYNC_ATOMIC
+	static void increment_(std::atomic<uint32_t> &counter) {
+		counter.fetch_add(1, std::memory_order_relaxed);
+	}
+#else
+	static void increment_(volatile uint32_t &counter) {
+		counter = counter + 1;
+	}
+#endif
+
+	/**
+	 * Reads a frame counter from any thread
+	 *
+	 * \param counter Frame counter
+	 * \return Count
+	 */
+#ifdef LED_ASYNC_ATOMIC
+	static uint32_t get_(const std::atomic<uint32_t> &counter) {
+		return counter.load(std::memory_order_relaxed);
+	}
+#else
+	static uint32_t get_(const volatile uint32_t &counter) {
+		return counter;
+	}
+#endif
+};
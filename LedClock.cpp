@@ -0,0 +1,37 @@
+#include "LedClock.h"
+
+#ifdef ARDUINO
+#include "Arduino.h"
+#else
+#include <chrono>
+#endif
+
+LedSystemClock &LedSystemClock::instance() {
+	static LedSystemClock clock;
+	return clock;
+}
+
+uint32_t LedSystemClock::micros() {
+#ifdef ARDUINO
+	return ::micros();
+#else
+	return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+LedSimulatedClock::LedSimulatedClock(const uint32_t micros) {
+	micros_ = micros;
+}
+
+uint32_t LedSimulatedClock::micros() {
+	return micros_;
+}
+
+void LedSimulatedClock::advance(const uint32_t micros) {
+	micros_ += micros;
+}
+
+void LedSimulatedClock::set(const uint32_t micros) {
+	micros_ = micros;
+}
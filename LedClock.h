@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Monotonic microsecond time source for time based features
+ *
+ * Injecting the clock lets the same code run on the hardware timer of a device and on a simulated clock on a host,
+ * where timing sensitive behavior is reproducible and runs faster than real time.
+ */
+class LedClock {
+public:
+	virtual ~LedClock() {}
+
+	/**
+	 * Get current time
+	 *
+	 * \return Microseconds from an arbitrary origin, wraps around every 71 minutes
+	 */
+	virtual uint32_t micros() = 0;
+};
+
+/**
+ * Clock of the system, micros() on Arduino and the steady clock on a host
+ */
+class LedSystemClock : public LedClock {
+public:
+	/**
+	 * Get shared instance
+	 *
+	 * \return System clock
+	 */
+	static LedSystemClock &instance();
+
+	uint32_t micros() override;
+};
+
+/**
+ * Clock which only moves when it is told to
+ *
+ *     LedSimulatedClock clock;
+ *     LedTicker ticker(clock, transitions, 4);
+ *     for (uint32_t i = 0; i < 3600000; ++i) {
+ *         clock.advance(1000);
+ *         ticker.tick();
+ *     }
+ */
+class LedSimulatedClock : public LedClock {
+public:
+	/**
+	 * Constructor
+	 *
+	 * \param micros Initial time in microseconds
+	 */
+	LedSimulatedClock(const uint32_t micros = 0);
+
+	uint32_t micros() override;
+
+	/**
+	 * Moves the time forward
+	 *
+	 * \param micros Microseconds to advance
+	 */
+	void advance(const uint32_t micros);
+
+	/**
+	 * Sets the time
+	 *
+	 * \param micros Time in microseconds
+	 */
+	void set(const uint32_t micros);
+
+private:
+	/**
+	 * Current time in microseconds
+	 */
+	uint32_t micros_;
+};
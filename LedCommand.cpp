@@ -0,0 +1,255 @@
+#include "LedCommand.h"
+
+#if defined(LED_ENGINE_COMMAND_BENCHMARK) && !defined(ARDUINO)
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+/**
+ * Scales from record fields to lightness, u', v' coordinates, Duv and raw levels
+ */
+static const float L16 = 100.0f / 65535;
+static const float UV16 = 0.625f / 65535;
+static const float DUV16 = 1.0f / 524288;
+static const float RAW16 = 1.0f / 65535;
+
+static uint16_t get16(const uint8_t *p) {
+	return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p) {
+	return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16
+		| static_cast<uint32_t>(p[3]) << 24;
+}
+
+static void put16(uint8_t *p, const uint16_t x) {
+	p[0] = x & 0xFF;
+	p[1] = x >> 8;
+}
+
+/**
+ * Rounds a scaled value to an unsigned 16-bit field, NaN is treated as zero
+ */
+static uint16_t quantize(const float x, const float scale) {
+	float y = x * scale + 0.5f;
+	if (!(y > 0)) return 0;
+	if (y >= 65535) return 65535;
+	return static_cast<uint16_t>(y);
+}
+
+bool LedCommandReceiver::parse(const uint8_t *record, LedCommand &command) {
+	command.type = static_cast<LedCommandType>(record[0]);
+	command.target = record[1];
+	const uint8_t *p = record + 2;
+	switch (command.type) {
+	case LedCommandType::Luv:
+		command.luv.L = get16(p) * L16;
+		command.luv.u = get16(p + 2) * UV16;
+		command.luv.v = get16(p + 4) * UV16;
+		return true;
+	case LedCommandType::Kelvin:
+		command.luv.L = get16(p) * L16;
+		command.T = get16(p + 2);
+		command.duv = static_cast<int16_t>(get16(p + 4)) * DUV16;
+		return true;
+	case LedCommandType::Raw:
+		command.raw.R = get16(p) * RAW16;
+		command.raw.G = get16(p + 2) * RAW16;
+		command.raw.B = get16(p + 4) * RAW16;
+		return true;
+	case LedCommandType::OnOff:
+		command.onOff = p[0] != 0;
+		return true;
+	case LedCommandType::Transition:
+		command.duration = get32(p);
+		return true;
+	}
+	return false;
+}
+
+void LedCommandReceiver::encode(const LedCommand &command, uint8_t *record) {
+	record[0] = static_cast<uint8_t>(command.type);
+	record[1] = command.target;
+	uint8_t *p = record + 2;
+	for (uint8_t i = 0; i < RECORD_SIZE - 2; ++i) p[i] = 0;
+	switch (command.type) {
+	case LedCommandType::Luv:
+		put16(p, quantize(command.luv.L, 1 / L16));
+		put16(p + 2, quantize(command.luv.u, 1 / UV16));
+		put16(p + 4, quantize(command.luv.v, 1 / UV16));
+		break;
+	case LedCommandType::Kelvin: {
+		put16(p, quantize(command.luv.L, 1 / L16));
+		put16(p + 2, command.T);
+		float duv = command.duv / DUV16;
+		if (!(duv > -32767 && duv < 32767)) duv = duv > 0 ? 32767.0f : (duv < 0 ? -32767.0f : 0.0f);
+		put16(p + 4, static_cast<uint16_t>(static_cast<int16_t>(duv < 0 ? duv - 0.5f : duv + 0.5f)));
+		break;
+	}
+	case LedCommandType::Raw:
+		put16(p, quantize(command.raw.R, 1 / RAW16));
+		put16(p + 2, quantize(command.raw.G, 1 / RAW16));
+		put16(p + 4, quantize(command.raw.B, 1 / RAW16));
+		break;
+	case LedCommandType::OnOff:
+		p[0] = command.onOff ? 1 : 0;
+		break;
+	case LedCommandType::Transition:
+		put16(p, command.duration & 0xFFFF);
+		put16(p + 2, command.duration >> 16);
+		break;
+	}
+}
+
+LedCommandReceiver::LedCommandReceiver(LedEngine *const *engines, const uint8_t count, LedTransition *transitions,
+	LedOutput *output) {
+	engines_ = engines;
+	count_ = count;
+	transitions_ = transitions;
+	output_ = output;
+}
+
+uint16_t LedCommandReceiver::handle(const uint8_t *message, const uint16_t length, const uint32_t now) {
+	uint16_t applied = 0;
+	uint32_t duration = 0;
+	if (output_) output_->beginFrame();
+	for (uint16_t i = 0; i + RECORD_SIZE <= length; i += RECORD_SIZE) {
+		LedCommand command;
+		if (!parse(message + i, command)) {
+			++errorCount_;
+			continue;
+		}
+
+		// Fade duration applies to the color records which follow
+		if (command.type == LedCommandType::Transition) {
+			duration = command.duration;
+			++applied;
+			continue;
+		}
+		if (dispatch(command, duration, now)) ++applied;
+		else ++errorCount_;
+	}
+	if (output_) output_->commitFrame();
+	commandCount_ += applied;
+	return applied;
+}
+
+bool LedCommandReceiver::dispatch(const LedCommand &command, const uint32_t duration, const uint32_t now) {
+	if (command.target == ALL) {
+		for (uint8_t i = 0; i < count_; ++i) {
+			apply_(i, command, duration, now);
+		}
+		return count_ > 0;
+	}
+	if (command.target >= count_) return false;
+	apply_(command.target, command, duration, now);
+	return true;
+}
+
+uint8_t LedCommandReceiver::update(const uint32_t now) {
+	if (!transitions_) return 0;
+	uint8_t running = 0;
+	if (output_) output_->beginFrame();
+	for (uint8_t i = 0; i < count_; ++i) {
+		if (transitions_[i].update(now)) ++running;
+	}
+	if (output_) output_->commitFrame();
+	return running;
+}
+
+uint32_t LedCommandReceiver::getCommandCount() {
+	return commandCount_;
+}
+
+uint32_t LedCommandReceiver::getErrorCount() {
+	return errorCount_;
+}
+
+void LedCommandReceiver::apply_(const uint8_t i, const LedCommand &command, const uint32_t duration, const uint32_t now) {
+	LedEngine &engine = *engines_[i];
+	switch (command.type) {
+	case LedCommandType::Luv:
+		if (transitions_) transitions_[i].start(command.luv, duration, now);
+		else engine.setCie1976Ucs(command.luv);
+		break;
+	case LedCommandType::Kelvin:
+		if (transitions_) transitions_[i].start(command.luv.L, command.T, command.duv, duration, now);
+		else if (command.duv == 0) engine.setColorTemperature(command.luv.L, command.T);
+		else engine.setColorTemperature(command.luv.L, command.T > 0 ? 1000000.0f / command.T : LedLocus::MIRED_MAX, command.duv);
+		break;
+	case LedCommandType::Raw:
+		// Raw levels cannot be faded, a running fade would overwrite them
+		if (transitions_) transitions_[i].stop();
+		engine.setRaw(command.raw);
+		break;
+	case LedCommandType::OnOff:
+		engine.setOnOff(command.onOff);
+		break;
+	case LedCommandType::Transition:
+		break;
+	}
+}
+
+#if defined(LED_ENGINE_COMMAND_BENCHMARK) && !defined(ARDUINO)
+/**
+ * Measures parsing and dispatch of command messages on the host
+ *
+ * Arguments: number of messages, default 100000
+ */
+int main(int argc, char **argv) {
+	uint32_t messages = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+
+	// Eight fixtures and a message which sets each of them once, mixed record types
+	static const uint8_t ENGINES = 8;
+	LedBufferOutput<5 * ENGINES> output;
+	LedEngine *engines[ENGINES];
+	for (uint8_t i = 0; i < ENGINES; ++i) {
+		engines[i] = new LedEngine(output, 5 * i, 5 * i + 1, 5 * i + 2, 5 * i + 3, 5 * i + 4, 4095);
+	}
+	LedCommandReceiver receiver(engines, ENGINES, nullptr, &output);
+	uint8_t message[(ENGINES + 1) * LedCommandReceiver::RECORD_SIZE];
+	LedCommand command = {};
+	command.type = LedCommandType::OnOff;
+	command.target = LedCommandReceiver::ALL;
+	command.onOff = true;
+	LedCommandReceiver::encode(command, message);
+	for (uint8_t i = 0; i < ENGINES; ++i) {
+		command.target = i;
+		command.type = i % 2 ? LedCommandType::Kelvin : LedCommandType::Luv;
+		command.luv = { 50.0f + i, 0.2f + 0.01f * i, 0.48f };
+		command.T = 2700 + 100 * i;
+		command.duv = 0;
+		LedCommandReceiver::encode(command, message + (i + 1) * LedCommandReceiver::RECORD_SIZE);
+	}
+
+	// Vary lightness so that every message solves every engine
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t m = 0; m < messages; ++m) {
+		for (uint8_t i = 0; i < ENGINES; ++i) {
+			message[(i + 1) * LedCommandReceiver::RECORD_SIZE + 2] = static_cast<uint8_t>(m);
+		}
+		receiver.handle(message, sizeof(message), m);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	uint32_t records = messages * (ENGINES + 1);
+
+	// Parsing alone
+	LedCommand parsed;
+	uint32_t known = 0;
+	start = std::chrono::steady_clock::now();
+	for (uint32_t m = 0; m < messages; ++m) {
+		for (uint16_t i = 0; i < sizeof(message); i += LedCommandReceiver::RECORD_SIZE) {
+			known += LedCommandReceiver::parse(message + i, parsed) ? 1 : 0;
+		}
+	}
+	double parseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("records           %u\n", records);
+	printf("ns per record     %.1f\n", seconds * 1e9 / records);
+	printf("ns per parse      %.2f\n", parseSeconds * 1e9 / (known > 0 ? known : 1));
+	printf("errors            %u\n", receiver.getErrorCount());
+	for (uint8_t i = 0; i < ENGINES; ++i) delete engines[i];
+	return receiver.getErrorCount() == 0 ? 0 : 1;
+}
+#endif
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "LedEngine.h"
+#include "LedOutput.h"
+#include "LedTransition.h"
+
+/**
+ * Command record types
+ */
+enum class LedCommandType : uint8_t {
+	/**
+	 * CIE 1976 UCS coordinates and lightness, three unsigned 16-bit values, lightness spans 0..100 and u', v' 0..0.625
+	 */
+	Luv = 1,
+
+	/**
+	 * Color temperature, unsigned 16-bit lightness spanning 0..100, unsigned 16-bit Kelvins and signed 16-bit Duv in
+	 * units of 2^-19
+	 */
+	Kelvin = 2,
+
+	/**
+	 * Red, green and blue levels, three unsigned 16-bit values spanning 0..1, bypasses color conversion
+	 */
+	Raw = 3,
+
+	/**
+	 * Light on if the first payload byte is not zero, off otherwise
+	 */
+	OnOff = 4,
+
+	/**
+	 * Unsigned 32-bit fade duration in milliseconds for the color records that follow in the same message
+	 */
+	Transition = 5
+};
+
+/**
+ * Decoded command record
+ */
+struct LedCommand {
+	/**
+	 * Record type
+	 */
+	LedCommandType type;
+
+	/**
+	 * Engine index, LedCommandReceiver::ALL for every engine
+	 */
+	uint8_t target;
+
+	/**
+	 * CIE 1976 UCS coordinates and lightness of Luv records, lightness of Kelvin records
+	 */
+	Luv luv;
+
+	/**
+	 * Color temperature in Kelvins of Kelvin records
+	 */
+	uint16_t T;
+
+	/**
+	 * Distance from the Planckian locus in CIE 1960 UCS of Kelvin records
+	 */
+	float duv;
+
+	/**
+	 * Levels of Raw records normalized in the range 0..1
+	 */
+	RGB raw;
+
+	/**
+	 * Light on or off of OnOff records
+	 */
+	bool onOff;
+
+	/**
+	 * Fade duration in milliseconds of Transition records
+	 */
+	uint32_t duration;
+};
+
+/**
+ * Receiver for compact binary color commands
+ *
+ * A message is a sequence of fixed size records, each of them a type byte, a target engine byte and six payload bytes
+ * in little endian order. Records are parsed in place from the message, nothing is allocated or copied, and all
+ * engines are updated within a single output frame. Malformed records are skipped. Messages must be delivered whole,
+ * e.g. as UDP datagrams or WebSocket binary messages, or framed by the serial protocol.
+ *
+ *     LedEngine *engines[] = { &light1, &light2 };
+ *     LedCommandReceiver receiver(engines, 2);
+ *     receiver.handle(packet, length, millis());
+ *
+ * Color records are applied immediately unless a Transition record precedes them in the same message and the
+ * receiver has transitions. Transitions are then stepped with update.
+ */
+class LedCommandReceiver {
+public:
+	/**
+	 * Bytes per record
+	 */
+	static const uint8_t RECORD_SIZE = 8;
+
+	/**
+	 * Target which addresses every engine
+	 */
+	static const uint8_t ALL = 0xFF;
+
+	/**
+	 * Parses a single record
+	 *
+	 * \param record Record bytes, RECORD_SIZE of them
+	 * \param command Decoded command
+	 * \return Was the record type known
+	 */
+	static bool parse(const uint8_t *record, LedCommand &command);
+
+	/**
+	 * Encodes a single record, values are rounded and limited to the ranges of the record fields
+	 *
+	 * \param command Command
+	 * \param record Output record bytes, RECORD_SIZE of them
+	 */
+	static void encode(const LedCommand &command, uint8_t *record);
+
+	/**
+	 * Constructor
+	 *
+	 * \param engines Engines addressed by target index, kept by reference and must outlive the receiver
+	 * \param count Number of engines
+	 * \param transitions Transitions of the same engines in the same order, nullptr applies fades immediately
+	 * \param output Output backend shared by the engines, if given all engines are written in a single frame
+	 */
+	LedCommandReceiver(LedEngine *const *engines, const uint8_t count, LedTransition *transitions = nullptr,
+		LedOutput *output = nullptr);
+
+	/**
+	 * Handles a message
+	 *
+	 * \param message Message bytes
+	 * \param length Number of bytes, a trailing partial record is ignored
+	 * \param now Current time in milliseconds for starting transitions
+	 * \return Number of records applied to at least one engine
+	 */
+	uint16_t handle(const uint8_t *message, const uint16_t length, const uint32_t now = 0);
+
+	/**
+	 * Applies a decoded command
+	 *
+	 * \param command Command
+	 * \param duration Fade duration in milliseconds for color commands
+	 * \param now Current time in milliseconds
+	 * \return Was the target a known engine
+	 */
+	bool dispatch(const LedCommand &command, const uint32_t duration, const uint32_t now);
+
+	/**
+	 * Steps running transitions
+	 *
+	 * \param now Current time in milliseconds
+	 * \return Number of transitions still running
+	 */
+	uint8_t update(const uint32_t now);
+
+	/**
+	 * Get number of applied records since construction
+	 *
+	 * \return Number of records applied to at least one engine
+	 */
+	uint32_t getCommandCount();
+
+	/**
+	 * Get number of skipped records since construction
+	 *
+	 * \return Number of records with unknown type or target
+	 */
+	uint32_t getErrorCount();
+
+private:
+	/**
+	 * Engines addressed by target index
+	 */
+	LedEngine *const *engines_;
+
+	/**
+	 * Transitions of the engines, nullptr if fades are applied immediately
+	 */
+	LedTransition *transitions_;
+
+	/**
+	 * Output backend shared by the engines, nullptr if not framed
+	 */
+	LedOutput *output_;
+
+	/**
+	 * Number of engines
+	 */
+	uint8_t count_;
+
+	/**
+	 * Number of applied records
+	 */
+	uint32_t commandCount_ = 0;
+
+	/**
+	 * Number of skipped records
+	 */
+	uint32_t errorCount_ = 0;
+
+	/**
+	 * Applies a command to a single engine
+	 *
+	 * \param i Engine index
+	 * \param command Command
+	 * \param duration Fade duration in milliseconds for color commands
+	 * \param now Current time in milliseconds
+	 */
+	void apply_(const uint8_t i, const LedCommand &command, const uint32_t duration, const uint32_t now);
+};
@@ -0,0 +1,64 @@
+#include "LedDmxOutput.h"
+
+#if defined(LED_ENGINE_DMX_BENCHMARK) && !defined(ARDUINO)
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "LedEngine.h"
+
+/**
+ * Measures frames per second of engines encoding into 64 universes on the host
+ *
+ * Arguments: number of frames, default 1000
+ */
+int main(int argc, char **argv) {
+	uint32_t frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000;
+
+	// RGBWW fixtures with 16-bit channels, 15 slots each, packed into every universe
+	static const uint8_t UNIVERSES = 64;
+	static const uint16_t PER_UNIVERSE = 512 / 15;
+	LedDmxOutput<UNIVERSES> *output = new LedDmxOutput<UNIVERSES>();
+	std::vector<LedEngine *> engines;
+	for (uint8_t u = 0; u < UNIVERSES; ++u) {
+		for (uint16_t f = 0; f < PER_UNIVERSE; ++f) {
+			uint16_t c = LedDmxOutput<UNIVERSES>::channel(u, 1 + 15 * f);
+			engines.push_back(new LedEngine(*output, c, c + 3, c + 6, c + 9, c + 12, 65535));
+			engines.back()->setOnOff(true);
+		}
+	}
+
+	// Raw levels only encode, color temperature adds the color conversion of every fixture
+	for (uint8_t pass = 0; pass < 2; ++pass) {
+		uint32_t sent = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (uint32_t frame = 0; frame < frames; ++frame) {
+			float level = (frame % 100 + 1) * 0.01f;
+			output->beginFrame();
+			for (size_t i = 0; i < engines.size(); ++i) {
+				if (pass == 0) engines[i]->setRaw({ level, 1 - level, level * 0.5f });
+				else engines[i]->setColorTemperature(100 * level, static_cast<uint16_t>(2000 + 40 * (frame % 100) + i % 8));
+			}
+			output->commitFrame();
+
+			// Sender side, every dirty universe is taken
+			for (uint8_t u = 0; u < UNIVERSES; ++u) {
+				if (!output->isDirty(u)) continue;
+				output->clearDirty(u);
+				++sent;
+			}
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() * 1e-6;
+		printf("%s  fixtures %u  universes sent per frame %.1f  frames/s %.0f\n", pass == 0 ? "raw        " : "temperature",
+			static_cast<unsigned>(engines.size()), frames > 0 ? static_cast<double>(sent) / frames : 0,
+			seconds > 0 ? frames / seconds : 0);
+	}
+
+	for (size_t i = 0; i < engines.size(); ++i) delete engines[i];
+	delete output;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "LedOutput.h"
+
+/**
+ * Output backend which encodes channels into DMX512 universe frames
+ *
+ * Channel number is universe index * 512 + DMX address - 1, so a fixture footprint is laid out by choosing the
+ * channel numbers of an engine. Engines with PWM range 255 or less get 8-bit channels, engines with a larger range get
+ * 16-bit channels which take the given address for the coarse byte and the next one for the fine byte. Engines of the
+ * same channel width should use the same PWM range, duties are rescaled with the range of the latest attached engine.
+ *
+ * Each flush copies the staged slots of changed universes to ready-to-send 513-byte frames, start code included, and
+ * marks only those universes dirty. The sender transmits dirty frames and clears them, unchanged frames can be
+ * resent as they are to keep the DMX refresh going.
+ *
+ * \tparam Universes Number of universes
+ */
+template <uint8_t Universes>
+class LedDmxOutput : public LedOutput {
+public:
+	/**
+	 * Number of bytes in a frame, start code and 512 slots
+	 */
+	static const uint16_t FRAME_SIZE = 513;
+
+	/**
+	 * Get channel number for a DMX address
+	 *
+	 * \param universe Universe index
+	 * \param address DMX address in the range 1..512
+	 * \return Channel number
+	 */
+	static constexpr uint16_t channel(const uint8_t universe, const uint16_t address) {
+		return universe * 512 + address - 1;
+	}
+
+	void attach(const uint16_t channel, const uint16_t pwmRange) override {
+		uint8_t universe = channel / 512;
+		if (universe >= Universes) return;
+		uint16_t slot = channel % 512;
+		bool wide = pwmRange > 255;
+		if (wide) {
+			wide_[universe][slot / 8] |= 1 << (slot % 8);
+			scale16_ = (65535UL << 16) / pwmRange;
+		}
+		else {
+			wide_[universe][slot / 8] &= ~(1 << (slot % 8));
+			scale8_ = pwmRange > 0 ? (255UL << 16) / pwmRange : 65536;
+		}
+		set(channel, 0);
+	}
+
+	void set(const uint16_t channel, const uint16_t duty) override {
+		uint8_t universe = channel / 512;
+		if (universe >= Universes) return;
+		uint16_t slot = channel % 512;
+		uint8_t *frame = staged_[universe];
+
+		// Slot 0 is the start code
+		if (wide_[universe][slot / 8] & (1 << (slot % 8))) {
+			if (slot == 511) return;
+			uint16_t value = duty;
+			if (scale16_ != 65536) {
+				value = static_cast<uint16_t>((static_cast<uint64_t>(duty) * scale16_ + 32768) >> 16);
+			}
+			if (frame[slot + 1] == value >> 8 && frame[slot + 2] == (value & 0xFF)) return;
+			frame[slot + 1] = value >> 8;
+			frame[slot + 2] = value & 0xFF;
+		}
+		else {
+			uint32_t value = scale8_ == 65536 ? duty : (duty * scale8_ + 32768) >> 16;
+			if (value > 255) value = 255;
+			if (frame[slot + 1] == value) return;
+			frame[slot + 1] = value;
+		}
+		pending_[universe / 8] |= 1 << (universe % 8);
+	}
+
+	/**
+	 * Get a committed frame
+	 *
+	 * \param universe Universe index
+	 * \return Start code and 512 slots as of the latest flush
+	 */
+	const uint8_t *getFrame(const uint8_t universe) {
+		return frame_[universe < Universes ? universe : 0];
+	}
+
+	/**
+	 * Has a universe changed since it was last cleared?
+	 *
+	 * \param universe Universe index
+	 * \return Is the universe dirty
+	 */
+	bool isDirty(const uint8_t universe) {
+		return universe < Universes && (dirty_[universe / 8] & (1 << (universe % 8)));
+	}
+
+	/**
+	 * Clears dirty flag of a universe, called by the sender after transmitting the frame
+	 *
+	 * \param universe Universe index
+	 */
+	void clearDirty(const uint8_t universe) {
+		if (universe < Universes) dirty_[universe / 8] &= ~(1 << (universe % 8));
+	}
+
+	/**
+	 * Get number of flushes which changed any universe
+	 *
+	 * \return Number of written frames
+	 */
+	uint32_t getFrameCount() {
+		return frameCount_;
+	}
+
+protected:
+	void write_() override {
+		bool changed = false;
+		for (uint8_t i = 0; i < (Universes + 7) / 8; ++i) {
+			if (pending_[i] == 0) continue;
+			for (uint8_t j = 0; j < 8; ++j) {
+				if (pending_[i] & (1 << j)) {
+					memcpy(frame_[i * 8 + j], staged_[i * 8 + j], FRAME_SIZE);
+				}
+			}
+			dirty_[i] |= pending_[i];
+			pending_[i] = 0;
+			changed = true;
+		}
+		if (changed) ++frameCount_;
+	}
+
+private:
+	/**
+	 * Frames staged for the next flush
+	 */
+	uint8_t staged_[Universes][FRAME_SIZE] = {};
+
+	/**
+	 * Frames as of the latest flush
+	 */
+	uint8_t frame_[Universes][FRAME_SIZE] = {};
+
+	/**
+	 * Bit masks of 16-bit channels, one bit per slot
+	 */
+	uint8_t wide_[Universes][64] = {};
+
+	/**
+	 * Bit mask of universes staged since the latest flush
+	 */
+	uint8_t pending_[(Universes + 7) / 8] = {};
+
+	/**
+	 * Bit mask of universes changed since the sender cleared them
+	 */
+	uint8_t dirty_[(Universes + 7) / 8] = {};
+
+	/**
+	 * Fixed point factor from engine PWM range to 8-bit channels, 65536 is one
+	 */
+	uint32_t scale8_ = 65536;
+
+	/**
+	 * Fixed point factor from engine PWM range to 16-bit channels, 65536 is one
+	 */
+	uint32_t scale16_ = 65536;
+
+	/**
+	 * Number of written frames
+	 */
+	uint32_t frameCount_ = 0;
+};
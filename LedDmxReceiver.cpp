@@ -0,0 +1,424 @@
+#include <string.h>
+#include "LedDmxReceiver.h"
+
+/**
+ * Art-Net packet identifier and ArtDmx operation code
+ */
+static const uint8_t ARTNET_ID[8] = { 'A', 'r', 't', '-', 'N', 'e', 't', 0 };
+static const uint16_t ARTNET_OP_DMX = 0x5000;
+
+/**
+ * sACN ACN packet identifier, root and framing layer vectors and options
+ */
+static const uint8_t SACN_ID[12] = { 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0 };
+static const uint32_t SACN_VECTOR_ROOT_DATA = 0x00000004;
+static const uint32_t SACN_VECTOR_FRAMING_DATA = 0x00000002;
+static const uint8_t SACN_VECTOR_DMP_SET_PROPERTY = 0x02;
+static const uint8_t SACN_OPTION_PREVIEW = 0x40;
+static const uint8_t SACN_OPTION_TERMINATED = 0x20;
+
+/**
+ * Scales from channel values to lightness and u', v' coordinates
+ */
+static const float L8 = 100.0f / 255;
+static const float L16 = 100.0f / 65535;
+static const float UV8 = 0.625f / 255;
+static const float UV16 = 0.625f / 65535;
+
+static uint16_t get16(const uint8_t *p) {
+	return static_cast<uint16_t>(p[0] << 8 | p[1]);
+}
+
+static uint32_t get32(const uint8_t *p) {
+	return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 | p[2] << 8 | p[3];
+}
+
+/**
+ * Converts a 16-bit channel value to fixed point level, 65536 is full power
+ */
+static uint32_t fixed16(const uint32_t x) {
+	return x + (x >> 15);
+}
+
+uint8_t LedDmxReceiver::footprint(const LedDmxMode mode) {
+	switch (mode) {
+	case LedDmxMode::Luv8: return 3;
+	case LedDmxMode::Luv16: return 6;
+	case LedDmxMode::Kelvin: return 3;
+	case LedDmxMode::Raw8: return 3;
+	case LedDmxMode::Raw16: return 6;
+	}
+	return 3;
+}
+
+bool LedDmxReceiver::parseArtNet(const uint8_t *packet, const uint16_t length, LedDmxPacket &dmx) {
+	if (length < 18 || memcmp(packet, ARTNET_ID, sizeof(ARTNET_ID)) != 0) return false;
+
+	// Operation code is little endian, everything else big endian
+	if ((packet[8] | packet[9] << 8) != ARTNET_OP_DMX || get16(packet + 10) < 14) return false;
+
+	uint16_t slots = get16(packet + 16);
+	if (slots > 512 || 18 + slots > length) return false;
+
+	// Port address from sub-net and universe byte and net byte
+	dmx.universe = (packet[15] & 0x7F) << 8 | packet[14];
+	dmx.sequence = packet[12];
+	dmx.data = packet + 18;
+	dmx.length = slots;
+	return true;
+}
+
+bool LedDmxReceiver::parseSacn(const uint8_t *packet, const uint16_t length, LedDmxPacket &dmx) {
+	if (length < 126 || get16(packet) != 0x0010 || memcmp(packet + 4, SACN_ID, sizeof(SACN_ID)) != 0) return false;
+	if (get32(packet + 18) != SACN_VECTOR_ROOT_DATA || get32(packet + 40) != SACN_VECTOR_FRAMING_DATA) return false;
+	if (packet[117] != SACN_VECTOR_DMP_SET_PROPERTY) return false;
+
+	// Preview data is meant for visualizers and terminated streams carry no valid levels
+	if (packet[112] & (SACN_OPTION_PREVIEW | SACN_OPTION_TERMINATED)) return false;
+
+	// Property values start with the start code, only null start code is DMX levels
+	uint16_t values = get16(packet + 123);
+	if (values < 1 || values > 513 || 125 + values > length || packet[125] != 0) return false;
+
+	dmx.universe = get16(packet + 113);
+	dmx.sequence = packet[111];
+	dmx.data = packet + 126;
+	dmx.length = values - 1;
+	return true;
+}
+
+LedDmxReceiver::LedDmxReceiver(const LedDmxPatch *patches, const uint8_t count) {
+	patches_ = patches;
+	count_ = count;
+}
+
+bool LedDmxReceiver::handle(const uint8_t *packet, const uint16_t length) {
+	LedDmxPacket dmx;
+	if (parseArtNet(packet, length, dmx) || parseSacn(packet, length, dmx)) {
+		return dispatch(dmx);
+	}
+	return false;
+}
+
+bool LedDmxReceiver::dispatch(const LedDmxPacket &dmx) {
+	bool patched = false;
+	for (uint8_t i = 0; i < count_; ++i) {
+		if (patches_[i].universe == dmx.universe) {
+			apply_(patches_[i], dmx.data, dmx.length);
+			patched = true;
+		}
+	}
+	if (patched) ++frameCount_;
+	return patched;
+}
+
+#ifdef ARDUINO
+uint16_t LedDmxReceiver::poll(UDP &udp) {
+	uint16_t frames = 0;
+	while (udp.parsePacket() > 0) {
+		int length = udp.read(packet_, PACKET_SIZE);
+		if (length > 0 && handle(packet_, length)) ++frames;
+	}
+	return frames;
+}
+#else
+uint16_t LedDmxReceiver::poll(LedUdpSocket &socket) {
+	uint16_t frames = 0;
+	uint16_t length;
+	while ((length = socket.receive(packet_, PACKET_SIZE)) > 0) {
+		if (handle(packet_, length)) ++frames;
+	}
+	return frames;
+}
+#endif
+
+uint32_t LedDmxReceiver::getFrameCount() {
+	return frameCount_;
+}
+
+void LedDmxReceiver::apply_(const LedDmxPatch &patch, const uint8_t *slots, const uint16_t length) {
+	if (patch.address < 1 || patch.address > length) return;
+
+	// Fixtures which are completely within the received slots
+	uint8_t size = footprint(patch.mode);
+	const uint8_t *s = slots + patch.address - 1;
+	uint16_t count = (length - patch.address + 1) / size;
+	if (count > patch.pixels.count) count = patch.pixels.count;
+
+	// Raw levels go straight to the pixels
+	if (patch.mode == LedDmxMode::Raw8 || patch.mode == LedDmxMode::Raw16) {
+		uint32_t level[3];
+		for (uint16_t i = 0; i < count; ++i, s += size) {
+			for (uint8_t c = 0; c < 3; ++c) {
+				level[c] = patch.mode == LedDmxMode::Raw8 ? fixed16(s[c] * 257) : fixed16(get16(s + 2 * c));
+			}
+			patch.pixels.setFixed(i, level);
+		}
+		return;
+	}
+	if (patch.engine == nullptr) return;
+
+	// Decode colors into scratch and convert a batch at a time
+	for (uint16_t first = 0; first < count; first += LED_DMX_SCRATCH) {
+		uint16_t n = count - first < LED_DMX_SCRATCH ? count - first : LED_DMX_SCRATCH;
+		for (uint16_t i = 0; i < n; ++i, s += size) {
+			Luv &luv = scratch_[i];
+			switch (patch.mode) {
+			case LedDmxMode::Luv8:
+				luv.L = s[0] * L8;
+				luv.u = s[1] * UV8;
+				luv.v = s[2] * UV8;
+				break;
+			case LedDmxMode::Luv16:
+				luv.L = get16(s) * L16;
+				luv.u = get16(s + 2) * UV16;
+				luv.v = get16(s + 4) * UV16;
+				break;
+			default: {
+				LedLocusPoint uv = LedLocus::fromKelvin(get16(s + 1));
+				luv.L = s[0] * L8;
+				luv.u = uv.u;
+				luv.v = uv.v;
+			}
+			}
+		}
+		patch.engine->setCie1976Ucs(scratch_, patch.pixels.slice(first, n));
+	}
+}
+
+#if defined(LED_ENGINE_DMX_LOOPBACK) && !defined(ARDUINO)
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+/**
+ * Port the loopback packets are sent to, the Art-Net port, sACN packets are told apart by content
+ */
+static const uint16_t LOOPBACK_PORT = 6454;
+
+static void put16(uint8_t *p, const uint16_t x) {
+	p[0] = x >> 8;
+	p[1] = x & 0xFF;
+}
+
+static void put32(uint8_t *p, const uint32_t x) {
+	put16(p, x >> 16);
+	put16(p + 2, x & 0xFFFF);
+}
+
+/**
+ * Builds an ArtDmx packet
+ */
+static uint16_t buildArtNet(uint8_t *packet, const uint16_t universe, const uint8_t sequence, const uint8_t *slots,
+	const uint16_t length) {
+	memset(packet, 0, 18);
+	memcpy(packet, ARTNET_ID, sizeof(ARTNET_ID));
+	packet[8] = ARTNET_OP_DMX & 0xFF;
+	packet[9] = ARTNET_OP_DMX >> 8;
+	put16(packet + 10, 14);
+	packet[12] = sequence;
+	packet[14] = universe & 0xFF;
+	packet[15] = (universe >> 8) & 0x7F;
+	put16(packet + 16, length);
+	memcpy(packet + 18, slots, length);
+	return 18 + length;
+}
+
+/**
+ * Builds an sACN data packet
+ */
+static uint16_t buildSacn(uint8_t *packet, const uint16_t universe, const uint8_t sequence, const uint8_t *slots,
+	const uint16_t length, const uint8_t options) {
+	memset(packet, 0, 126);
+	put16(packet, 0x0010);
+	memcpy(packet + 4, SACN_ID, sizeof(SACN_ID));
+	put16(packet + 16, 0x7000 | (110 + length));
+	put32(packet + 18, SACN_VECTOR_ROOT_DATA);
+	put16(packet + 38, 0x7000 | (88 + length));
+	put32(packet + 40, SACN_VECTOR_FRAMING_DATA);
+	memcpy(packet + 44, "LedEngine loopback", 18);
+	packet[108] = 100;
+	packet[111] = sequence;
+	packet[112] = options;
+	put16(packet + 113, universe);
+	put16(packet + 115, 0x7000 | (11 + length));
+	packet[117] = SACN_VECTOR_DMP_SET_PROPERTY;
+	packet[118] = 0xA1;
+	put16(packet + 121, 1);
+	put16(packet + 123, length + 1);
+	memcpy(packet + 126, slots, length);
+	return 126 + length;
+}
+
+/**
+ * Sends a packet to the loopback port and polls until the receiver has taken it or a second has passed
+ */
+static uint16_t loop(LedUdpSocket &sender, LedUdpSocket &socket, LedDmxReceiver &receiver, const uint8_t *packet,
+	const uint16_t length) {
+	if (!sender.send("127.0.0.1", LOOPBACK_PORT, packet, length)) return 0;
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+	uint16_t frames;
+	while ((frames = receiver.poll(socket)) == 0 && std::chrono::steady_clock::now() < end) {
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+	return frames;
+}
+
+/**
+ * Sends Art-Net and sACN packets for every channel layout over 127.0.0.1, checks the pixels against a direct
+ * conversion and measures full frames per second of 20 universes of 170 Luv8 fixtures
+ *
+ * Arguments: number of throughput frames, default 1000. Exits non-zero on any mismatch.
+ */
+int main(int argc, char **argv) {
+	uint32_t frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000;
+	LedUdpSocket socket(LOOPBACK_PORT, "127.0.0.1");
+	LedUdpSocket sender(0, "127.0.0.1");
+	if (!socket.isOpen() || !sender.isOpen()) {
+		fprintf(stderr, "cannot bind 127.0.0.1:%u\n", LOOPBACK_PORT);
+		return 2;
+	}
+
+	// One universe per layout, as many fixtures as fit, 16-bit pixels for the 16-bit layouts
+	static const LedDmxMode MODES[] = { LedDmxMode::Luv8, LedDmxMode::Luv16, LedDmxMode::Kelvin, LedDmxMode::Raw8,
+		LedDmxMode::Raw16 };
+	static const char *const NAMES[] = { "Luv8", "Luv16", "Kelvin", "Raw8", "Raw16" };
+	static const uint8_t LAYOUTS = sizeof(MODES) / sizeof(MODES[0]);
+	LedBufferOutput<5> output;
+	LedEngine engine(output, 0, 1, 2, 3, 4, 4095);
+	static uint8_t buffers[LAYOUTS][170 * 6];
+	static uint8_t expected[170 * 6];
+	LedDmxPatch patches[LAYOUTS];
+	for (uint8_t m = 0; m < LAYOUTS; ++m) {
+		uint8_t bytes = MODES[m] == LedDmxMode::Luv16 || MODES[m] == LedDmxMode::Raw16 ? 2 : 1;
+		LedPixels pixels = { buffers[m], 512u / LedDmxReceiver::footprint(MODES[m]), static_cast<uint8_t>(3 * bytes), 0, bytes,
+			static_cast<uint8_t>(2 * bytes), bytes };
+		patches[m] = { static_cast<uint16_t>(m + 1), 1, MODES[m], &engine, pixels };
+	}
+	LedDmxReceiver receiver(patches, LAYOUTS);
+
+	uint8_t slots[512];
+	uint8_t packet[LedDmxReceiver::PACKET_SIZE];
+	Luv targets[170];
+	float L[170];
+	uint16_t T[170];
+	int failures = 0;
+	srand(1);
+	for (uint8_t protocol = 0; protocol < 2; ++protocol) {
+		for (uint8_t m = 0; m < LAYOUTS; ++m) {
+			const LedDmxPatch &patch = patches[m];
+			uint8_t size = LedDmxReceiver::footprint(patch.mode);
+			uint16_t count = static_cast<uint16_t>(patch.pixels.count);
+			for (uint16_t i = 0; i < 512; ++i) slots[i] = static_cast<uint8_t>(rand());
+			memset(patch.pixels.data, 0, count * patch.pixels.stride);
+
+			uint16_t length = protocol == 0 ? buildArtNet(packet, patch.universe, m + 1, slots, 512)
+				: buildSacn(packet, patch.universe, m + 1, slots, 512, 0);
+			if (loop(sender, socket, receiver, packet, length) != 1) {
+				printf("%-5s %-6s not received\n", protocol == 0 ? "ArtDmx" : "E1.31", NAMES[m]);
+				++failures;
+				continue;
+			}
+
+			// Reference from the layout as documented, converted directly by the engine
+			LedPixels reference = patch.pixels;
+			reference.data = expected;
+			const uint8_t *s = slots;
+			for (uint16_t i = 0; i < count; ++i, s += size) {
+				switch (patch.mode) {
+				case LedDmxMode::Luv8:
+					targets[i] = { s[0] * (100.0f / 255), s[1] * (0.625f / 255), s[2] * (0.625f / 255) };
+					break;
+				case LedDmxMode::Luv16:
+					targets[i] = { get16(s) * (100.0f / 65535), get16(s + 2) * (0.625f / 65535),
+						get16(s + 4) * (0.625f / 65535) };
+					break;
+				case LedDmxMode::Kelvin:
+					L[i] = s[0] * (100.0f / 255);
+					T[i] = get16(s + 1);
+					break;
+				case LedDmxMode::Raw8:
+					for (uint8_t c = 0; c < 3; ++c) expected[3 * i + c] = s[c];
+					break;
+				case LedDmxMode::Raw16:
+					memcpy(expected + 6 * i, s, 6);
+					break;
+				}
+			}
+			if (patch.mode == LedDmxMode::Luv8 || patch.mode == LedDmxMode::Luv16) {
+				engine.setCie1976Ucs(targets, reference);
+			}
+			else if (patch.mode == LedDmxMode::Kelvin) {
+				engine.setColorTemperature(L, T, reference);
+			}
+
+			uint16_t mismatches = 0;
+			for (uint16_t i = 0; i < count; ++i) {
+				if (memcmp(patch.pixels.data + i * patch.pixels.stride, expected + i * reference.stride,
+					reference.stride) != 0) ++mismatches;
+			}
+			printf("%-6s %-6s fixtures %3u  mismatches %u\n", protocol == 0 ? "ArtDmx" : "E1.31", NAMES[m], count,
+				mismatches);
+			if (mismatches > 0) ++failures;
+		}
+	}
+
+	// Preview and terminated sACN packets must leave the pixels alone
+	for (uint8_t options = 0x40; options >= 0x20; options >>= 1) {
+		uint16_t length = buildSacn(packet, patches[3].universe, 0, slots, 512, options);
+		sender.send("127.0.0.1", LOOPBACK_PORT, packet, length);
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		uint16_t taken = receiver.poll(socket);
+		printf("E1.31  options 0x%02X  taken %u\n", options, taken);
+		if (taken != 0) ++failures;
+	}
+
+	// Throughput of 20 universes of 170 Luv8 fixtures, in memory and through the socket
+	static const uint8_t UNIVERSES = 20;
+	std::vector<uint8_t> frame(UNIVERSES * 170 * 3);
+	std::vector<LedDmxPatch> wide;
+	for (uint8_t u = 0; u < UNIVERSES; ++u) {
+		LedPixels pixels = { frame.data() + u * 170 * 3, 170, 3, 0, 1, 2, 1 };
+		wide.push_back({ static_cast<uint16_t>(100 + u), 1, LedDmxMode::Luv8, &engine, pixels });
+	}
+	LedDmxReceiver throughput(wide.data(), UNIVERSES);
+	std::vector<uint8_t> packets(UNIVERSES * LedDmxReceiver::PACKET_SIZE);
+	uint16_t lengths[UNIVERSES];
+	for (uint8_t u = 0; u < UNIVERSES; ++u) {
+		for (uint16_t i = 0; i < 510; i += 3) {
+			slots[i] = static_cast<uint8_t>(rand() % 256);
+			slots[i + 1] = static_cast<uint8_t>(0.16f / (0.625f / 255) + rand() % 40);
+			slots[i + 2] = static_cast<uint8_t>(0.42f / (0.625f / 255) + rand() % 40);
+		}
+		lengths[u] = buildArtNet(packets.data() + u * LedDmxReceiver::PACKET_SIZE, 100 + u, 0, slots, 510);
+	}
+	for (uint8_t pass = 0; pass < 2; ++pass) {
+		uint32_t handled = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (uint32_t f = 0; f < frames; ++f) {
+			for (uint8_t u = 0; u < UNIVERSES; ++u) {
+				const uint8_t *p = packets.data() + u * LedDmxReceiver::PACKET_SIZE;
+				if (pass == 0) handled += throughput.handle(p, lengths[u]);
+				else sender.send("127.0.0.1", LOOPBACK_PORT, p, lengths[u]);
+			}
+			if (pass == 1) {
+				std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+				uint32_t target = handled + UNIVERSES;
+				while (handled < target && std::chrono::steady_clock::now() < end) handled += throughput.poll(socket);
+			}
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() * 1e-6;
+		printf("%s  universes %u  fixtures %u  lost %u  full frames/s %.0f\n", pass == 0 ? "in memory" : "loopback ",
+			UNIVERSES, UNIVERSES * 170, frames * UNIVERSES - handled, seconds > 0 ? frames / seconds : 0);
+		if (handled != frames * UNIVERSES) ++failures;
+	}
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
+
+#endif
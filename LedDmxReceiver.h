@@ -0,0 +1,237 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "LedEngine.h"
+#include "LedOutput.h"
+
+#ifdef ARDUINO
+#include <Udp.h>
+#else
+#include "LedUdp.h"
+#endif
+
+#ifndef LED_DMX_SCRATCH
+/**
+ * Number of fixtures converted in a single batch, larger patches are converted in several batches
+ */
+#define LED_DMX_SCRATCH 170
+#endif
+
+/**
+ * DMX channel layout of a fixture
+ *
+ * u' and v' channels span 0..0.625 and lightness channels 0..100. 16-bit channels are most significant byte first.
+ */
+enum class LedDmxMode : uint8_t {
+	/**
+	 * Lightness, u' and v', one channel each
+	 */
+	Luv8,
+
+	/**
+	 * Lightness, u' and v', two channels each
+	 */
+	Luv16,
+
+	/**
+	 * Lightness in one channel and color temperature in Kelvins in two channels
+	 */
+	Kelvin,
+
+	/**
+	 * Red, green and blue levels, one channel each, bypasses color conversion
+	 */
+	Raw8,
+
+	/**
+	 * Red, green and blue levels, two channels each, bypasses color conversion
+	 */
+	Raw16
+};
+
+/**
+ * Mapping of consecutive fixtures in a DMX universe to pixels
+ */
+struct LedDmxPatch {
+	/**
+	 * Universe number as sent by the desk, Art-Net port address or sACN universe
+	 */
+	uint16_t universe;
+
+	/**
+	 * DMX start address of the first fixture in the range 1..512
+	 */
+	uint16_t address;
+
+	/**
+	 * Channel layout of the fixtures
+	 */
+	LedDmxMode mode;
+
+	/**
+	 * Engine whose calibration converts colors of the fixtures, not used in raw modes
+	 */
+	LedEngine *engine;
+
+	/**
+	 * Destination pixels, one per fixture
+	 */
+	LedPixels pixels;
+};
+
+/**
+ * DMX data of a single universe, points into the packet it was parsed from
+ */
+struct LedDmxPacket {
+	/**
+	 * Universe number
+	 */
+	uint16_t universe;
+
+	/**
+	 * Sequence number, zero if the sender does not use sequencing
+	 */
+	uint8_t sequence;
+
+	/**
+	 * First slot after the start code
+	 */
+	const uint8_t *data;
+
+	/**
+	 * Number of slots after the start code
+	 */
+	uint16_t length;
+};
+
+/**
+ * Art-Net and sACN (E1.31) receiver
+ *
+ * Packets are parsed in place from the receive buffer and every patch of the received universe is converted with one
+ * batch call straight into its pixels, so nothing is allocated or copied per packet or per fixture. After a poll
+ * which received frames the pixels are ready to be shown.
+ *
+ * Building with LED_ENGINE_DMX_LOOPBACK defined adds a main function which sends Art-Net and sACN packets of every
+ * channel layout over 127.0.0.1, checks the pixels and measures the throughput of 20 full universes.
+ */
+class LedDmxReceiver {
+public:
+	/**
+	 * Largest packet handled, a full sACN data packet
+	 */
+	static const uint16_t PACKET_SIZE = 638;
+
+	/**
+	 * Get number of DMX channels per fixture
+	 *
+	 * \param mode Channel layout
+	 * \return Number of channels
+	 */
+	static uint8_t footprint(const LedDmxMode mode);
+
+	/**
+	 * Parses an Art-Net ArtDmx packet
+	 *
+	 * \param packet Packet bytes
+	 * \param length Number of bytes
+	 * \param dmx Parsed universe data pointing into the packet
+	 * \return Was the packet a valid ArtDmx packet
+	 */
+	static bool parseArtNet(const uint8_t *packet, const uint16_t length, LedDmxPacket &dmx);
+
+	/**
+	 * Parses an sACN (E1.31) data packet, preview and stream terminated packets are rejected
+	 *
+	 * \param packet Packet bytes
+	 * \param length Number of bytes
+	 * \param dmx Parsed universe data pointing into the packet
+	 * \return Was the packet a valid sACN data packet with DMX start code
+	 */
+	static bool parseSacn(const uint8_t *packet, const uint16_t length, LedDmxPacket &dmx);
+
+	/**
+	 * Constructor
+	 *
+	 * \param patches Fixture patches, kept by reference and must outlive the receiver
+	 * \param count Number of patches
+	 */
+	LedDmxReceiver(const LedDmxPatch *patches, const uint8_t count);
+
+	/**
+	 * Handles an Art-Net or sACN packet
+	 *
+	 * \param packet Packet bytes
+	 * \param length Number of bytes
+	 * \return Was the packet DMX data for a patched universe
+	 */
+	bool handle(const uint8_t *packet, const uint16_t length);
+
+	/**
+	 * Converts universe data for all patches of the universe
+	 *
+	 * \param dmx Universe data
+	 * \return Was the universe patched
+	 */
+	bool dispatch(const LedDmxPacket &dmx);
+
+#ifdef ARDUINO
+	/**
+	 * Handles all packets waiting in a UDP instance
+	 *
+	 * \param udp UDP instance listening on the Art-Net or sACN port
+	 * \return Number of packets which were DMX data for a patched universe
+	 */
+	uint16_t poll(UDP &udp);
+#else
+	/**
+	 * Handles all packets waiting in a socket
+	 *
+	 * \param socket Socket bound to the Art-Net or sACN port
+	 * \return Number of packets which were DMX data for a patched universe
+	 */
+	uint16_t poll(LedUdpSocket &socket);
+#endif
+
+	/**
+	 * Get number of handled universe frames since construction
+	 *
+	 * \return Number of universe frames which were patched
+	 */
+	uint32_t getFrameCount();
+
+private:
+	/**
+	 * Fixture patches
+	 */
+	const LedDmxPatch *patches_;
+
+	/**
+	 * Number of patches
+	 */
+	uint8_t count_;
+
+	/**
+	 * Number of handled universe frames
+	 */
+	uint32_t frameCount_ = 0;
+
+	/**
+	 * Receive buffer
+	 */
+	uint8_t packet_[PACKET_SIZE];
+
+	/**
+	 * Decoded fixture colors of a batch
+	 */
+	Luv scratch_[LED_DMX_SCRATCH];
+
+	/**
+	 * Converts the fixtures of a patch
+	 *
+	 * \param patch Patch
+	 * \param slots Universe slots after the start code
+	 * \param length Number of slots
+	 */
+	void apply_(const LedDmxPatch &patch, const uint8_t *slots, const uint16_t length);
+};
@@ -1,253 +1,681 @@
-#include "Arduino.h"
+#include <math.h>
 #include "LedEngine.h"
+#include "LedTrace.h"
 
-LedEngine::LedEngine(const uint8_t redPin, const uint8_t greenPin, const uint8_t bluePin, const uint8_t warmPin, const uint8_t coldPin, uint16_t pwmRange) {
+LedEngine::LedEngine(LedOutput &output, const uint16_t redChannel, const uint16_t greenChannel, const uint16_t blueChannel,
+	const uint16_t warmChannel, const uint16_t coldChannel, uint16_t pwmRange) {
 
 	// Copy parameters
-	redPin_ = redPin;
-	greenPin_ = greenPin;
-	bluePin_ = bluePin;
-	warmPin_ = warmPin;
-	coldPin_ = coldPin;
+	output_ = &output;
+	redChannel_ = redChannel;
+	greenChannel_ = greenChannel;
+	blueChannel_ = blueChannel;
+	warmChannel_ = warmChannel;
+	coldChannel_ = coldChannel;
 	pwmRange_ = pwmRange;
 
-	// Set LED pins as output and set them off
-	analogWriteRange(pwmRange_);
-	pinMode(redPin_, OUTPUT); analogWrite(redPin_, 0);
-	pinMode(greenPin_, OUTPUT); analogWrite(greenPin_, 0);
-	pinMode(bluePin_, OUTPUT); analogWrite(bluePin_, 0);
-	pinMode(warmPin_, OUTPUT); analogWrite(warmPin_, 0);
-	pinMode(coldPin_, OUTPUT); analogWrite(coldPin_, 0);
+	// Prepare LED channels for output
+	output_->attach(redChannel_, pwmRange_);
+	output_->attach(greenChannel_, pwmRange_);
+	output_->attach(blueChannel_, pwmRange_);
+	output_->attach(warmChannel_, pwmRange_);
+	output_->attach(coldChannel_, pwmRange_);
 
 	// Set default color and set light off
 	setOnOff(false);
 	setColorTemperature(50, 1900);
 }
 
+#ifdef ARDUINO
+LedEngine::LedEngine(const uint8_t redPin, const uint8_t greenPin, const uint8_t bluePin, const uint8_t warmPin, const uint8_t coldPin, uint16_t pwmRange)
+	: LedEngine(LedAnalogOutput::instance(), redPin, greenPin, bluePin, warmPin, coldPin, pwmRange) {
+}
+#endif
+
 bool LedEngine::getOnOff() {
-	return onOff_;
+	return published_.load().state.onOff;
 }
 
 void LedEngine::setOnOff(const bool onOff) {
-	onOff_ = onOff;
-	if (onOff_) {
-		setRaw(getRaw());
-	}
-	else {
-		analogWrite(redPin_, 0);
-		analogWrite(greenPin_, 0);
-		analogWrite(bluePin_, 0);
+	if (trace_) {
+		LedCommand command = {};
+		command.type = LedCommandType::OnOff;
+		command.onOff = onOff;
+		trace_->record(traceId_, command);
 	}
+	state_.onOff = onOff;
+	writeDuty_();
+	publish_();
 }
 
 RGB LedEngine::getRaw() {
-	return raw_;
+	LedState state = published_.load().state;
+	RGB raw;
+	switch (pwmRange_) {
+	case 255:
+		raw.R = LedPwm<255>::toRaw(state.duty[0]); raw.G = LedPwm<255>::toRaw(state.duty[1]); raw.B = LedPwm<255>::toRaw(state.duty[2]);
+		break;
+	case 1023:
+		raw.R = LedPwm<1023>::toRaw(state.duty[0]); raw.G = LedPwm<1023>::toRaw(state.duty[1]); raw.B = LedPwm<1023>::toRaw(state.duty[2]);
+		break;
+	case 4095:
+		raw.R = LedPwm<4095>::toRaw(state.duty[0]); raw.G = LedPwm<4095>::toRaw(state.duty[1]); raw.B = LedPwm<4095>::toRaw(state.duty[2]);
+		break;
+	case 65535:
+		raw.R = LedPwm<65535>::toRaw(state.duty[0]); raw.G = LedPwm<65535>::toRaw(state.duty[1]); raw.B = LedPwm<65535>::toRaw(state.duty[2]);
+		break;
+	default:
+		raw.R = static_cast<float>(state.duty[0]) / pwmRange_;
+		raw.G = static_cast<float>(state.duty[1]) / pwmRange_;
+		raw.B = static_cast<float>(state.duty[2]) / pwmRange_;
+	}
+	return raw;
 }
 
 void LedEngine::setRaw(const RGB raw) {
-	// Copy
-	raw_.R = raw.R;
-	raw_.G = raw.G;
-	raw_.B = raw.B;
-
-	// Limit values in the range 0..1
-	if (raw_.R < 0) raw_.R = 0.0;
-	if (raw_.R > 1) raw_.R = 1.0;
-	if (raw_.G < 0) raw_.G = 0.0;
-	if (raw_.G > 1) raw_.G = 1.0;
-	if (raw_.B < 0) raw_.B = 0.0;
-	if (raw_.B > 1) raw_.B = 1.0;
-
-	// Convert input floats to integers in the pwm range
-	int pwmR = static_cast<int>(raw_.R * pwmRange_ + 0.5);
-	int pwmG = static_cast<int>(raw_.G * pwmRange_ + 0.5);
-	int pwmB = static_cast<int>(raw_.B * pwmRange_ + 0.5);
+	if (trace_) {
+		LedCommand command = {};
+		command.type = LedCommandType::Raw;
+		command.raw = raw;
+		trace_->record(traceId_, command);
+	}
 
-	// Write PWMs
-	if (onOff_) {
-		analogWrite(redPin_, pwmR);
-		analogWrite(greenPin_, pwmG);
-		analogWrite(bluePin_, pwmB);
+	// Limit values in the range 0..1 and convert to integers in the pwm range, common 8, 10, 12 and 16-bit ranges are
+	// compile time constants so that quantization needs no divisions
+	switch (pwmRange_) {
+	case 255: LedPwm<255>::toDuty(raw, state_.duty); break;
+	case 1023: LedPwm<1023>::toDuty(raw, state_.duty); break;
+	case 4095: LedPwm<4095>::toDuty(raw, state_.duty); break;
+	case 65535: LedPwm<65535>::toDuty(raw, state_.duty); break;
+	default: {
+		float c[3] = { raw.R, raw.G, raw.B };
+		for (uint8_t i = 0; i < 3; ++i) {
+			if (!(c[i] > 0)) c[i] = 0.0;
+			if (c[i] > 1) c[i] = 1.0;
+			state_.duty[i] = static_cast<uint16_t>(c[i] * pwmRange_ + 0.5f);
+		}
+	}
 	}
 
-	// Save values
-	raw_.R = static_cast<float>(pwmR) / pwmRange_;
-	raw_.G = static_cast<float>(pwmG) / pwmRange_;
-	raw_.B = static_cast<float>(pwmB) / pwmRange_;
+	// Write PWMs
+	writeDuty_();
 
 	// Cannot be sure that current color is result of higher level color setter
-	// unset luv_ and T_, respective setters will save the values afterwards
-	luv_.L = -1.0;
-	luv_.u = -1.0;
-	luv_.v = -1.0;
-	T_ = -1;
+	// unset luv and T, respective setters will save the values afterwards
+	state_.luv.L = -1.0;
+	state_.luv.u = -1.0;
+	state_.luv.v = -1.0;
+	state_.T = -1;
+
+	// Publish for readers
+	publish_();
 }
 
 Luv LedEngine::getCie1976Ucs() {
-	return luv_;
+	return published_.load().state.luv;
 }
 
 void LedEngine::setCie1976Ucs(const Luv target) {
+	if (trace_) {
+		LedCommand command = {};
+		command.type = LedCommandType::Luv;
+		command.luv = target;
+		trace_->record(traceId_, command);
+	}
 
-	// Save values
-	luv_.L = target.L;
-	luv_.u = target.u;
-	luv_.v = target.v;
+	// Skip the solve if the change would not be visible
+	if (state_.luv.L >= 0 && belowThreshold_(state_.luv, target)) {
+		skippedCount_.increment();
+		if (state_.T != 0xFFFF) {
+			state_.T = -1;
+			publish_();
+		}
+		return;
+	}
 
-	// Limit lightness to zero from below
-	if (luv_.L < 0) luv_.L = 0;
+	applyCie1976Ucs_(target);
 
-	// Convert to raw PWM values
-	RGB raw;
+	// Not set by color temperature
+	state_.T = -1;
 
-	// Coefficients
-	raw.R = findCoefficient_(target, redUv_, greenUv_, blueUv_, redToGreenFit_, greenToBlueFit_);
-	raw.G = findCoefficient_(target, greenUv_, blueUv_, redUv_, greenToBlueFit_, blueToRedFit_);
-	raw.B = findCoefficient_(target, blueUv_, redUv_, greenUv_, blueToRedFit_, redToGreenFit_);
+	// Publish for readers
+	publish_();
+}
 
-	// Luma produced by the current raw values
-	float Y = (raw.R * redLum_ + raw.G * greenLum_ + raw.B * blueLum_) / maxLum_;
+float LedEngine::getLightness() {
+	Snapshot_ snapshot = published_.load();
+	const LedState &state = snapshot.state;
 
-	// Luma level needed for requested lightness
-	float Y_target = (target.L + 16) / 116;
-	Y_target = Y_target * Y_target * Y_target; // Y_target^3
+	// Luma is linear in LED levels, weights are of the model the duties were solved with
+	float Y = (snapshot.luma[0] * state.duty[0] + snapshot.luma[1] * state.duty[1] + snapshot.luma[2] * state.duty[2])
+		/ pwmRange_;
+	return LedLightness::fromLuma(Y < 1 ? static_cast<uint16_t>(Y * 65535 + 0.5f) : 65535);
+}
 
-	// Luma factor
-	float C = Y_target / Y;
+float LedEngine::getMaxLightness(const float u, const float v) {
+	return model_->getLightnessGrid().sample(u, v);
+}
 
-	// Scale raw values to produce target luma
-	raw.R = raw.R * C;
-	raw.G = raw.G * C;
-	raw.B = raw.B * C;
+float LedEngine::getLightnessKnee() {
+	return lightnessKnee_;
+}
 
-	// Find max scaled raw value
-	float maxRaw = raw.R;
-	if (raw.G > maxRaw) maxRaw = raw.G;
-	if (raw.B > maxRaw) maxRaw = raw.B;
+void LedEngine::setLightnessKnee(const float knee) {
+	lightnessKnee_ = knee < 0 ? 0.0f : (knee > 1 ? 1.0f : knee);
+}
 
-	// Nothing can be more than at max power, limit coefficients to 1
-	if (maxRaw > 1) {
-		raw.R = raw.R * (1.0 / maxRaw);
-		raw.G = raw.G * (1.0 / maxRaw);
-		raw.B = raw.B * (1.0 / maxRaw);
-	}
+uint16_t LedEngine::getColorTemperature() {
+	LedState state = published_.load().state;
+	if (state.T != 0xFFFF) return state.T;
 
-	// Write PWMs
-	setRaw(raw);
+	// Not set by color temperature, estimate the correlated color temperature
+	LedTemperature temperature;
+	if (!estimateTemperature_(state, temperature)) return -1;
+	return static_cast<uint16_t>(1000000 / temperature.mired + 0.5f);
 }
 
-uint16_t LedEngine::getColorTemperature() {
-	return T_;
+float LedEngine::getDuv() {
+	LedState state = published_.load().state;
+	if (state.T != 0xFFFF) return state.duv;
+	LedTemperature temperature;
+	if (!estimateTemperature_(state, temperature)) return 0;
+	return temperature.duv;
 }
 
 void LedEngine::setColorTemperature(const float L, const uint16_t T) {
+	if (trace_) {
+		LedCommand command = {};
+		command.type = LedCommandType::Kelvin;
+		command.luv.L = L;
+		command.T = T;
+		trace_->record(traceId_, command);
+	}
+	setColorTemperature_(L, mired_(T), 0, T);
+}
+
+void LedEngine::setColorTemperature(const float L, const float mired, const float duv) {
+
+	// Color temperature to report, clamped to the tabulated locus like the rendered color, tint does not change it
+	float m = mired > LedLocus::MIRED_MIN ? mired : LedLocus::MIRED_MIN;
+	if (m > LedLocus::MIRED_MAX) m = LedLocus::MIRED_MAX;
+	uint16_t T = static_cast<uint16_t>(1000000 / m + 0.5f);
+
+	// Traced with the reported color temperature, so fractional Kelvins are rounded
+	if (trace_) {
+		LedCommand command = {};
+		command.type = LedCommandType::Kelvin;
+		command.luv.L = L;
+		command.T = T;
+		command.duv = duv;
+		trace_->record(traceId_, command);
+	}
+	setColorTemperature_(L, mired, duv, T);
+}
+
+void LedEngine::setColorTemperature_(const float L, const float mired, const float duv, const uint16_t T) {
+
+	// Skip the solve if neither temperature, tint nor lightness changes visibly
+	if (state_.T != 0xFFFF && threshold_.deltaMired > 0) {
+		float deltaMired = mired - mired_(state_.T);
+		float deltaDuv = duv - state_.duv;
+		float deltaL = L > 0 ? L - state_.luv.L : 0;
+		if (deltaMired < 0) deltaMired = -deltaMired;
+		if (deltaDuv < 0) deltaDuv = -deltaDuv;
+		if (deltaL < 0) deltaL = -deltaL;
+		if (deltaMired < threshold_.deltaMired && (deltaDuv == 0 || deltaDuv < threshold_.deltaUv)
+			&& (deltaL == 0 || deltaL < threshold_.deltaE)) {
+			skippedCount_.increment();
+			return;
+		}
+	}
+
+	applyColorTemperature_(L, mired, duv, T);
+}
+
+LedSolverMode LedEngine::getSolverMode() {
+	return solverMode_;
+}
+
+void LedEngine::setSolverMode(const LedSolverMode mode) {
+	solverMode_ = mode;
+	resetWarmStart_();
+}
+
+LedThreshold LedEngine::getThreshold() {
+	return threshold_;
+}
+
+void LedEngine::setThreshold(const LedThreshold &threshold) {
+	threshold_ = threshold;
+}
 
-	// These cryptic looking formulas are a result of polynomial least squares fit of
-	// CIE1976UCS coordinates vs color temperature
+uint32_t LedEngine::getSolvedCount() {
+	return solvedCount_.get();
+}
+
+uint32_t LedEngine::getSkippedCount() {
+	return skippedCount_.get();
+}
 
-	// Fit variable has been transformed to z-score in order to avoid floating point precision problems
-	double x = (T - 5500.0) / 2599.0;
-	double x2 = x*x;
-	double x3 = x*x*x;
-	double x4 = x*x*x*x;
-	double u = (-0.0001747*x3 + 0.1833*x2 + 0.872*x + 1.227) / (x2 + 4.813*x + 5.933);
-	double v = (0.000311*x4 + 0.0009124*x3 + 0.3856*x2 + 1.873*x + 2.619) / (x2 + 4.323*x + 5.485);
+void LedEngine::applyColorTemperature_(const float L, const float mired, const float duv, const uint16_t T) {
+
+	// Look up u', v' coordinates from the Planckian locus table and offset them by the tint
+	LedLocusPoint uv = LedLocus::fromMired(mired, duv);
 
 	// Construct CIE 1976 UCS values from internal lightness and newly calculated u', v' coordinates
-	Luv luv = { luv_.L, u, v };
+	Luv luv = { state_.luv.L, uv.u, uv.v };
 
 	// Lightness is given and valid
 	if (L > 0) luv.L = L;
 
-	setCie1976Ucs(luv);
+	applyCie1976Ucs_(luv);
+
+	// Save color temperature and tint
+	state_.T = T;
+	state_.duv = duv;
 
-	// Save color temperature
-	T_ = T;
+	// Publish for readers, color and temperature become visible together
+	publish_();
+}
+
+void LedEngine::applyCie1976Ucs_(const Luv target) {
+
+	// Fixed point levels
+	uint32_t level[3];
+	solve_(target, level, solverMode_ == LedSolverMode::Newton ? warm_ : nullptr);
+	solvedCount_.increment();
+
+	// Convert to integers in the pwm range
+	switch (pwmRange_) {
+	case 255: for (uint8_t i = 0; i < 3; ++i) state_.duty[i] = LedPwm<255>::fromFixed(level[i]); break;
+	case 1023: for (uint8_t i = 0; i < 3; ++i) state_.duty[i] = LedPwm<1023>::fromFixed(level[i]); break;
+	case 4095: for (uint8_t i = 0; i < 3; ++i) state_.duty[i] = LedPwm<4095>::fromFixed(level[i]); break;
+	case 65535: for (uint8_t i = 0; i < 3; ++i) state_.duty[i] = LedPwm<65535>::fromFixed(level[i]); break;
+	default: for (uint8_t i = 0; i < 3; ++i) state_.duty[i] = static_cast<uint16_t>((level[i] * pwmRange_ + 32768) >> 16);
+	}
+
+	// Write PWMs
+	writeDuty_();
+
+	// Save values
+	state_.luv.L = target.L;
+	state_.luv.u = target.u;
+	state_.luv.v = target.v;
+
+	// Limit lightness to zero from below
+	if (state_.luv.L < 0) state_.luv.L = 0;
+}
+
+void LedEngine::setCie1976Ucs(const Luv targets[], const LedPixels &pixels) {
+	uint32_t level[3];
+	for (uint32_t i = 0; i < pixels.count; ++i) {
+		solve_(targets[i], level);
+		pixels.setFixed(i, level);
+	}
+}
+
+void LedEngine::setColorTemperature(const float L[], const uint16_t T[], const LedPixels &pixels) {
+	uint32_t level[3];
+	for (uint32_t i = 0; i < pixels.count; ++i) {
+		LedLocusPoint uv = LedLocus::fromKelvin(T[i]);
+		Luv luv = { L[i], uv.u, uv.v };
+		solve_(luv, level);
+		pixels.setFixed(i, level);
+	}
+}
+
+#ifndef ARDUINO
+/**
+ * Number of pixels claimed at a time by a thread, enough to make claiming overhead negligible
+ */
+static const uint16_t BATCH_GRAIN = 64;
+
+void LedEngine::setCie1976Ucs(const Luv targets[], const LedPixels &pixels, LedThreadPool &pool) {
+	pool.run(pixels.count, pixels.alignedCount(BATCH_GRAIN), [&](uint32_t first, uint32_t last) {
+		setCie1976Ucs(targets + first, pixels.slice(first, last - first));
+	});
+}
+
+void LedEngine::setColorTemperature(const float L[], const uint16_t T[], const LedPixels &pixels, LedThreadPool &pool) {
+	pool.run(pixels.count, pixels.alignedCount(BATCH_GRAIN), [&](uint32_t first, uint32_t last) {
+		setColorTemperature(L + first, T + first, pixels.slice(first, last - first));
+	});
+}
+#endif
+
+LedState LedEngine::getState() {
+	return published_.load().state;
+}
+
+void LedEngine::setState(const LedState &state) {
+	state_ = state;
+
+	// Write PWMs
+	writeDuty_();
+
+	// Publish for readers
+	publish_();
 }
 
 void LedEngine::calibrate(const Luv redUv, const Luv greenUv, const Luv blueUv, const float redLum,
 	const float greenLum, const float blueLum, const float redToGreenFit[3], const float greenToBlueFit[3],
 	const float blueToRedFit[3]) {
 
+	LedCalibration calibration = model_->getCalibration();
+
 	// CIE 1976 UCS coordinates
-	redUv_.u = redUv.u;
-	redUv_.v = redUv.v;
-	greenUv_.u = greenUv.u;
-	greenUv_.v = greenUv.v;
-	blueUv_.u = blueUv.u;
-	blueUv_.v = blueUv.v;
+	calibration.redUv.u = redUv.u;
+	calibration.redUv.v = redUv.v;
+	calibration.greenUv.u = greenUv.u;
+	calibration.greenUv.v = greenUv.v;
+	calibration.blueUv.u = blueUv.u;
+	calibration.blueUv.v = blueUv.v;
 
 	// Luminous fluxes
-	redLum_ = redLum;
-	greenLum_ = greenLum;
-	blueLum_ = blueLum;
+	calibration.redLum = redLum;
+	calibration.greenLum = greenLum;
+	calibration.blueLum = blueLum;
 
 	// Fit functions
 	for (uint8_t i = 0; i < 3; ++i) {
-		redToGreenFit_[i] = redToGreenFit[i];
-		greenToBlueFit_[i] = greenToBlueFit[i];
-		blueToRedFit_[i] = blueToRedFit[i];
+		calibration.redToGreenFit[i] = redToGreenFit[i];
+		calibration.greenToBlueFit[i] = greenToBlueFit[i];
+		calibration.blueToRedFit[i] = blueToRedFit[i];
 	}
 
-	// Update current color
-	if (T_ >= 1000) {
-		setColorTemperature(luv_.L, T_);
+	calibrate(calibration);
+}
+
+void LedEngine::calibrate(const LedCalibration &calibration) {
+	calibrate(calibration, LedSolver::fromCalibration(calibration));
+}
+
+void LedEngine::calibrate(const LedCalibration &calibration, const LedSolver &solver) {
+
+	// Own model, engines sharing the current model keep it
+	calibrate_(LedModelRef::make(calibration, solver));
+}
+
+void LedEngine::calibrate(const LedModel &model) {
+	calibrate_(LedModelRef(model));
+}
+
+const LedModel &LedEngine::getModel() {
+	return *model_;
+}
+
+void LedEngine::setTrace(LedTrace *trace, const uint8_t id) {
+	trace_ = trace;
+	traceId_ = id;
+}
+
+void LedEngine::calibrate_(const LedModelRef &model) {
+	model_ = model;
+	resetWarmStart_();
+
+	// Update current color, thresholds do not apply because the color changes even if the target does not
+	if (state_.T != 0xFFFF) {
+		applyColorTemperature_(state_.luv.L, mired_(state_.T), state_.duv, state_.T);
 	}
-	else if (luv_.L >= 0) {
-		setCie1976Ucs(luv_);
+	else {
+		if (state_.luv.L >= 0) applyCie1976Ucs_(state_.luv);
+
+		// Raw duties stay but their lightness is of the new model
+		publish_();
 	}
 }
 
-Luv LedEngine::getRedUv() { return redUv_; }
+void LedEngine::publish_() {
+	const LedSolver &solver = model_->getSolver();
+	Snapshot_ snapshot = { state_, { solver.redY, solver.greenY, solver.blueY } };
+	published_.store(snapshot);
+}
 
-Luv LedEngine::getGreenUv() { return greenUv_; }
+Luv LedEngine::getRedUv() { return model_->getCalibration().redUv; }
 
-Luv LedEngine::getBlueUv() { return blueUv_; }
+Luv LedEngine::getGreenUv() { return model_->getCalibration().greenUv; }
 
-float LedEngine::getRedLum() { return redLum_; }
+Luv LedEngine::getBlueUv() { return model_->getCalibration().blueUv; }
 
-float LedEngine::getGreenLum() { return greenLum_; }
+float LedEngine::getRedLum() { return model_->getCalibration().redLum; }
 
-float LedEngine::getBlueLum() { return blueLum_; }
+float LedEngine::getGreenLum() { return model_->getCalibration().greenLum; }
 
-float * LedEngine::getRedToGreenFit() { return redToGreenFit_; }
+float LedEngine::getBlueLum() { return model_->getCalibration().blueLum; }
 
-float * LedEngine::getGreenToBlueFit() { return greenToBlueFit_; }
+const float * LedEngine::getRedToGreenFit() { return model_->getCalibration().redToGreenFit; }
 
-float * LedEngine::getBlueToRedFit() { return blueToRedFit_; }
+const float * LedEngine::getGreenToBlueFit() { return model_->getCalibration().greenToBlueFit; }
 
-float LedEngine::findCoefficient_(const Luv PT, const Luv P0, const Luv P1, const Luv P2, const float rightHandFit[3], const float leftHandFit[3]) {
+const float * LedEngine::getBlueToRedFit() { return model_->getCalibration().blueToRedFit; }
 
-	double PTu = PT.u;
-	double PTv = PT.v;
-	double P0u = P0.u;
-	double P0v = P0.v;
-	double P1u = P1.u;
-	double P1v = P1.v;
-	double P2u = P2.u;
-	double P2v = P2.v;
-	double Rp1 = rightHandFit[0];
-	double Rp2 = rightHandFit[1];
-	double Rq1 = rightHandFit[2];
-	double Lp1 = leftHandFit[0];
-	double Lp2 = leftHandFit[1];
-	double Lq1 = leftHandFit[2];
+void LedEngine::solve_(const Luv target, uint32_t level[3], float *warm) {
+	const LedSolver &solver = model_->getSolver();
 
-	double dR;
-	if (Lp1 < 0) {
-		dR = (sqrt((P0u*P0u)*(P1v*P1v) + (P1u*P1u)*(P0v*P0v) + (P0u*P0u)*(PTv*PTv) + (P0v*P0v)*(PTu*PTu) + (P1u*P1u)*(PTv*PTv) + (P1v*P1v)*(PTu*PTu) - Lp1*(P0u*P0u)*(P1v*P1v)*2.0 - Lp1*(P1u*P1u)*(P0v*P0v)*2.0 - Lp2*(P0u*P0u)*(P1v*P1v)*2.0 - Lp2*(P1u*P1u)*(P0v*P0v)*2.0 + Lq1*(P0u*P0u)*(P1v*P1v)*2.0 + Lq1*(P1u*P1u)*(P0v*P0v)*2.0 - Lp1*(P0u*P0u)*(PTv*PTv)*2.0 - Lp1*(P0v*P0v)*(PTu*PTu)*2.0 - Lp2*(P0u*P0u)*(PTv*PTv)*4.0 - Lp2*(P0v*P0v)*(PTu*PTu)*4.0 + Lq1*(P0u*P0u)*(PTv*PTv)*2.0 + Lq1*(P0v*P0v)*(PTu*PTu)*2.0 + Lq1*(P1u*P1u)*(PTv*PTv)*2.0 + Lq1*(P1v*P1v)*(PTu*PTu)*2.0 + (Lp1*Lp1)*(P0u*P0u)*(P1v*P1v) + (Lp1*Lp1)*(P1u*P1u)*(P0v*P0v) + (Lp2*Lp2)*(P0u*P0u)*(P1v*P1v) + (Lp2*Lp2)*(P1u*P1u)*(P0v*P0v) + (Lp1*Lp1)*(P1u*P1u)*(P2v*P2v) + (Lp1*Lp1)*(P2u*P2u)*(P1v*P1v) + (Lp2*Lp2)*(P0u*P0u)*(P2v*P2v) + (Lp2*Lp2)*(P2u*P2u)*(P0v*P0v) + (Lp2*Lp2)*(P1u*P1u)*(P2v*P2v) + (Lp2*Lp2)*(P2u*P2u)*(P1v*P1v) + (Lq1*Lq1)*(P0u*P0u)*(P1v*P1v) + (Lq1*Lq1)*(P1u*P1u)*(P0v*P0v) + (Lp1*Lp1)*(P0u*P0u)*(PTv*PTv) + (Lp1*Lp1)*(P0v*P0v)*(PTu*PTu) + (Lp1*Lp1)*(P2u*P2u)*(PTv*PTv) + (Lp1*Lp1)*(P2v*P2v)*(PTu*PTu) + (Lq1*Lq1)*(P0u*P0u)*(PTv*PTv) + (Lq1*Lq1)*(P0v*P0v)*(PTu*PTu) + (Lq1*Lq1)*(P1u*P1u)*(PTv*PTv) + (Lq1*Lq1)*(P1v*P1v)*(PTu*PTu) - P0u*P1u*(PTv*PTv)*2.0 - P0u*(P1v*P1v)*PTu*2.0 - P1u*(P0v*P0v)*PTu*2.0 - P0v*P1v*(PTu*PTu)*2.0 - (P0u*P0u)*P1v*PTv*2.0 - (P1u*P1u)*P0v*PTv*2.0 + Lp1*Lp2*(P0u*P0u)*(P1v*P1v)*2.0 + Lp1*Lp2*(P1u*P1u)*(P0v*P0v)*2.0 + Lp1*Lp2*(P1u*P1u)*(P2v*P2v)*2.0 + Lp1*Lp2*(P2u*P2u)*(P1v*P1v)*2.0 - Lp1*Lq1*(P0u*P0u)*(P1v*P1v)*2.0 - Lp1*Lq1*(P1u*P1u)*(P0v*P0v)*2.0 - Lp2*Lq1*(P0u*P0u)*(P1v*P1v)*2.0 - Lp2*Lq1*(P1u*P1u)*(P0v*P0v)*2.0 + Lp1*Lq1*(P0u*P0u)*(PTv*PTv)*2.0 + Lp1*Lq1*(P0v*P0v)*(PTu*PTu)*2.0 - (Lp1*Lp1)*P0u*P2u*(P1v*P1v)*2.0 - (Lp2*Lp2)*P0u*P1u*(P2v*P2v)*2.0 - (Lp2*Lp2)*P0u*P2u*(P1v*P1v)*2.0 - (Lp2*Lp2)*P1u*P2u*(P0v*P0v)*2.0 - (Lp1*Lp1)*(P1u*P1u)*P0v*P2v*2.0 - (Lp2*Lp2)*(P0u*P0u)*P1v*P2v*2.0 - (Lp2*Lp2)*(P1u*P1u)*P0v*P2v*2.0 - (Lp2*Lp2)*(P2u*P2u)*P0v*P1v*2.0 - (Lp1*Lp1)*P1u*(P0v*P0v)*PTu*2.0 - (Lp1*Lp1)*P0u*P2u*(PTv*PTv)*2.0 - (Lp1*Lp1)*P1u*(P2v*P2v)*PTu*2.0 - (Lp1*Lp1)*(P0u*P0u)*P1v*PTv*2.0 - (Lp1*Lp1)*P0v*P2v*(PTu*PTu)*2.0 - (Lp1*Lp1)*(P2u*P2u)*P1v*PTv*2.0 - (Lq1*Lq1)*P0u*P1u*(PTv*PTv)*2.0 - (Lq1*Lq1)*P0u*(P1v*P1v)*PTu*2.0 - (Lq1*Lq1)*P1u*(P0v*P0v)*PTu*2.0 - (Lq1*Lq1)*P0v*P1v*(PTu*PTu)*2.0 - (Lq1*Lq1)*(P0u*P0u)*P1v*PTv*2.0 - (Lq1*Lq1)*(P1u*P1u)*P0v*PTv*2.0 - P0u*P1u*P0v*P1v*2.0 + P0u*P1u*P0v*PTv*2.0 + P0u*P0v*P1v*PTu*2.0 + P0u*P1u*P1v*PTv*2.0 + P1u*P0v*P1v*PTu*2.0 - P0u*P0v*PTu*PTv*2.0 + P0u*P1v*PTu*PTv*2.0 + P1u*P0v*PTu*PTv*2.0 - P1u*P1v*PTu*PTv*2.0 + Lp1*P0u*P2u*(P1v*P1v)*2.0 + Lp2*P0u*P2u*(P1v*P1v)*2.0 - Lp2*P1u*P2u*(P0v*P0v)*2.0 + Lp1*(P1u*P1u)*P0v*P2v*2.0 - Lp2*(P0u*P0u)*P1v*P2v*2.0 + Lp2*(P1u*P1u)*P0v*P2v*2.0 + Lp1*P0u*P1u*(PTv*PTv)*2.0 + Lp1*P0u*(P1v*P1v)*PTu*2.0 + Lp1*P1u*(P0v*P0v)*PTu*4.0 + Lp1*P0u*P2u*(PTv*PTv)*2.0 + Lp2*P0u*P1u*(PTv*PTv)*4.0 + Lp2*P0u*(P1v*P1v)*PTu*2.0 + Lp2*P1u*(P0v*P0v)*PTu*6.0 - Lp1*P1u*P2u*(PTv*PTv)*2.0 - Lp1*P2u*(P1v*P1v)*PTu*2.0 + Lp2*P0u*P2u*(PTv*PTv)*4.0 + Lp2*P2u*(P0v*P0v)*PTu*2.0 - Lp2*P1u*P2u*(PTv*PTv)*4.0 - Lp2*P2u*(P1v*P1v)*PTu*2.0 + Lp1*P0v*P1v*(PTu*PTu)*2.0 + Lp1*(P0u*P0u)*P1v*PTv*4.0 + Lp1*(P1u*P1u)*P0v*PTv*2.0 + Lp1*P0v*P2v*(PTu*PTu)*2.0 + Lp2*P0v*P1v*(PTu*PTu)*4.0 + Lp2*(P0u*P0u)*P1v*PTv*6.0 + Lp2*(P1u*P1u)*P0v*PTv*2.0 - Lp1*P1v*P2v*(PTu*PTu)*2.0 - Lp1*(P1u*P1u)*P2v*PTv*2.0 + Lp2*P0v*P2v*(PTu*PTu)*4.0 + Lp2*(P0u*P0u)*P2v*PTv*2.0 - Lp2*P1v*P2v*(PTu*PTu)*4.0 - Lp2*(P1u*P1u)*P2v*PTv*2.0 - Lq1*P0u*P1u*(PTv*PTv)*4.0 - Lq1*P0u*(P1v*P1v)*PTu*4.0 - Lq1*P1u*(P0v*P0v)*PTu*4.0 - Lq1*P0v*P1v*(PTu*PTu)*4.0 - Lq1*(P0u*P0u)*P1v*PTv*4.0 - Lq1*(P1u*P1u)*P0v*PTv*4.0 - Lp1*Lp2*P0u*P1u*(P2v*P2v)*2.0 - Lp1*Lp2*P0u*P2u*(P1v*P1v)*4.0 - Lp1*Lp2*P1u*P2u*(P0v*P0v)*2.0 - Lp1*Lp2*(P0u*P0u)*P1v*P2v*2.0 - Lp1*Lp2*(P1u*P1u)*P0v*P2v*4.0 - Lp1*Lp2*(P2u*P2u)*P0v*P1v*2.0 + Lp1*Lq1*P0u*P2u*(P1v*P1v)*2.0 + Lp1*Lq1*P1u*P2u*(P0v*P0v)*4.0 + Lp2*Lq1*P0u*P2u*(P1v*P1v)*2.0 + Lp2*Lq1*P1u*P2u*(P0v*P0v)*2.0 + Lp1*Lq1*(P0u*P0u)*P1v*P2v*4.0 + Lp1*Lq1*(P1u*P1u)*P0v*P2v*2.0 + Lp2*Lq1*(P0u*P0u)*P1v*P2v*2.0 + Lp2*Lq1*(P1u*P1u)*P0v*P2v*2.0 - Lp1*Lp2*P1u*(P0v*P0v)*PTu*2.0 + Lp1*Lp2*P0u*(P2v*P2v)*PTu*2.0 + Lp1*Lp2*P2u*(P0v*P0v)*PTu*2.0 - Lp1*Lp2*P1u*(P2v*P2v)*PTu*2.0 - Lp1*Lp2*(P0u*P0u)*P1v*PTv*2.0 + Lp1*Lp2*(P0u*P0u)*P2v*PTv*2.0 + Lp1*Lp2*(P2u*P2u)*P0v*PTv*2.0 - Lp1*Lp2*(P2u*P2u)*P1v*PTv*2.0 - Lp1*Lq1*P0u*P1u*(PTv*PTv)*2.0 + Lp1*Lq1*P0u*(P1v*P1v)*PTu*2.0 - Lp1*Lq1*P0u*P2u*(PTv*PTv)*2.0 - Lp1*Lq1*P2u*(P0v*P0v)*PTu*4.0 + Lp2*Lq1*P0u*(P1v*P1v)*PTu*2.0 + Lp2*Lq1*P1u*(P0v*P0v)*PTu*2.0 + Lp1*Lq1*P1u*P2u*(PTv*PTv)*2.0 - Lp1*Lq1*P2u*(P1v*P1v)*PTu*2.0 - Lp2*Lq1*P2u*(P0v*P0v)*PTu*2.0 - Lp2*Lq1*P2u*(P1v*P1v)*PTu*2.0 - Lp1*Lq1*P0v*P1v*(PTu*PTu)*2.0 + Lp1*Lq1*(P1u*P1u)*P0v*PTv*2.0 - Lp1*Lq1*P0v*P2v*(PTu*PTu)*2.0 - Lp1*Lq1*(P0u*P0u)*P2v*PTv*4.0 + Lp2*Lq1*(P0u*P0u)*P1v*PTv*2.0 + Lp2*Lq1*(P1u*P1u)*P0v*PTv*2.0 + Lp1*Lq1*P1v*P2v*(PTu*PTu)*2.0 - Lp1*Lq1*(P1u*P1u)*P2v*PTv*2.0 - Lp2*Lq1*(P0u*P0u)*P2v*PTv*2.0 - Lp2*Lq1*(P1u*P1u)*P2v*PTv*2.0 - (Lp1*Lp1)*P0u*P1u*P0v*P1v*2.0 - (Lp2*Lp2)*P0u*P1u*P0v*P1v*2.0 + (Lp1*Lp1)*P0u*P1u*P1v*P2v*2.0 + (Lp1*Lp1)*P1u*P2u*P0v*P1v*2.0 + (Lp2*Lp2)*P0u*P1u*P0v*P2v*2.0 + (Lp2*Lp2)*P0u*P2u*P0v*P1v*2.0 + (Lp2*Lp2)*P0u*P1u*P1v*P2v*2.0 - (Lp2*Lp2)*P0u*P2u*P0v*P2v*2.0 + (Lp2*Lp2)*P1u*P2u*P0v*P1v*2.0 - (Lp1*Lp1)*P1u*P2u*P1v*P2v*2.0 + (Lp2*Lp2)*P0u*P2u*P1v*P2v*2.0 + (Lp2*Lp2)*P1u*P2u*P0v*P2v*2.0 - (Lp2*Lp2)*P1u*P2u*P1v*P2v*2.0 - (Lq1*Lq1)*P0u*P1u*P0v*P1v*2.0 + (Lp1*Lp1)*P0u*P1u*P0v*PTv*2.0 + (Lp1*Lp1)*P0u*P0v*P1v*PTu*2.0 - (Lp1*Lp1)*P0u*P1u*P2v*PTv*2.0 + (Lp1*Lp1)*P0u*P2u*P1v*PTv*4.0 - (Lp1*Lp1)*P0u*P1v*P2v*PTu*2.0 - (Lp1*Lp1)*P1u*P2u*P0v*PTv*2.0 + (Lp1*Lp1)*P1u*P0v*P2v*PTu*4.0 - (Lp1*Lp1)*P2u*P0v*P1v*PTu*2.0 + (Lp1*Lp1)*P1u*P2u*P2v*PTv*2.0 + (Lp1*Lp1)*P2u*P1v*P2v*PTu*2.0 + (Lq1*Lq1)*P0u*P1u*P0v*PTv*2.0 + (Lq1*Lq1)*P0u*P0v*P1v*PTu*2.0 + (Lq1*Lq1)*P0u*P1u*P1v*PTv*2.0 + (Lq1*Lq1)*P1u*P0v*P1v*PTu*2.0 - (Lp1*Lp1)*P0u*P0v*PTu*PTv*2.0 + (Lp1*Lp1)*P0u*P2v*PTu*PTv*2.0 + (Lp1*Lp1)*P2u*P0v*PTu*PTv*2.0 - (Lp1*Lp1)*P2u*P2v*PTu*PTv*2.0 - (Lq1*Lq1)*P0u*P0v*PTu*PTv*2.0 + (Lq1*Lq1)*P0u*P1v*PTu*PTv*2.0 + (Lq1*Lq1)*P1u*P0v*PTu*PTv*2.0 - (Lq1*Lq1)*P1u*P1v*PTu*PTv*2.0 + Lp1*P0u*P1u*P0v*P1v*4.0 + Lp2*P0u*P1u*P0v*P1v*4.0 - Lp1*P0u*P1u*P1v*P2v*2.0 - Lp1*P1u*P2u*P0v*P1v*2.0 + Lp2*P0u*P1u*P0v*P2v*2.0 + Lp2*P0u*P2u*P0v*P1v*2.0 - Lp2*P0u*P1u*P1v*P2v*2.0 - Lp2*P1u*P2u*P0v*P1v*2.0 - Lq1*P0u*P1u*P0v*P1v*4.0 - Lp1*P0u*P1u*P0v*PTv*4.0 - Lp1*P0u*P0v*P1v*PTu*4.0 - Lp1*P0u*P1u*P1v*PTv*2.0 - Lp1*P1u*P0v*P1v*PTu*2.0 - Lp2*P0u*P1u*P0v*PTv*6.0 - Lp2*P0u*P0v*P1v*PTu*6.0 + Lp1*P0u*P1u*P2v*PTv*2.0 - Lp1*P0u*P2u*P1v*PTv*4.0 + Lp1*P0u*P1v*P2v*PTu*2.0 + Lp1*P1u*P2u*P0v*PTv*2.0 - Lp1*P1u*P0v*P2v*PTu*4.0 + Lp1*P2u*P0v*P1v*PTu*2.0 - Lp2*P0u*P1u*P1v*PTv*2.0 - Lp2*P0u*P2u*P0v*PTv*2.0 - Lp2*P0u*P0v*P2v*PTu*2.0 - Lp2*P1u*P0v*P1v*PTu*2.0 + Lp1*P1u*P2u*P1v*PTv*2.0 + Lp1*P1u*P1v*P2v*PTu*2.0 - Lp2*P0u*P2u*P1v*PTv*6.0 + Lp2*P0u*P1v*P2v*PTu*6.0 + Lp2*P1u*P2u*P0v*PTv*6.0 - Lp2*P1u*P0v*P2v*PTu*6.0 + Lp2*P1u*P2u*P1v*PTv*2.0 + Lp2*P1u*P1v*P2v*PTu*2.0 + Lq1*P0u*P1u*P0v*PTv*4.0 + Lq1*P0u*P0v*P1v*PTu*4.0 + Lq1*P0u*P1u*P1v*PTv*4.0 + Lq1*P1u*P0v*P1v*PTu*4.0 + Lp1*P0u*P0v*PTu*PTv*4.0 - Lp1*P0u*P1v*PTu*PTv*2.0 - Lp1*P1u*P0v*PTu*PTv*2.0 + Lp2*P0u*P0v*PTu*PTv*8.0 - Lp1*P0u*P2v*PTu*PTv*2.0 - Lp1*P2u*P0v*PTu*PTv*2.0 - Lp2*P0u*P1v*PTu*PTv*4.0 - Lp2*P1u*P0v*PTu*PTv*4.0 + Lp1*P1u*P2v*PTu*PTv*2.0 + Lp1*P2u*P1v*PTu*PTv*2.0 - Lp2*P0u*P2v*PTu*PTv*4.0 - Lp2*P2u*P0v*PTu*PTv*4.0 + Lp2*P1u*P2v*PTu*PTv*4.0 + Lp2*P2u*P1v*PTu*PTv*4.0 - Lq1*P0u*P0v*PTu*PTv*4.0 + Lq1*P0u*P1v*PTu*PTv*4.0 + Lq1*P1u*P0v*PTu*PTv*4.0 - Lq1*P1u*P1v*PTu*PTv*4.0 - Lp1*Lp2*P0u*P1u*P0v*P1v*4.0 + Lp1*Lp2*P0u*P1u*P0v*P2v*2.0 + Lp1*Lp2*P0u*P2u*P0v*P1v*2.0 + Lp1*Lp2*P0u*P1u*P1v*P2v*4.0 + Lp1*Lp2*P1u*P2u*P0v*P1v*4.0 + Lp1*Lp2*P0u*P2u*P1v*P2v*2.0 + Lp1*Lp2*P1u*P2u*P0v*P2v*2.0 - Lp1*Lp2*P1u*P2u*P1v*P2v*4.0 + Lp1*Lq1*P0u*P1u*P0v*P1v*4.0 - Lp1*Lq1*P0u*P1u*P0v*P2v*4.0 - Lp1*Lq1*P0u*P2u*P0v*P1v*4.0 + Lp2*Lq1*P0u*P1u*P0v*P1v*4.0 - Lp1*Lq1*P0u*P1u*P1v*P2v*2.0 - Lp1*Lq1*P1u*P2u*P0v*P1v*2.0 - Lp2*Lq1*P0u*P1u*P0v*P2v*2.0 - Lp2*Lq1*P0u*P2u*P0v*P1v*2.0 - Lp2*Lq1*P0u*P1u*P1v*P2v*2.0 - Lp2*Lq1*P1u*P2u*P0v*P1v*2.0 + Lp1*Lp2*P0u*P1u*P0v*PTv*2.0 + Lp1*Lp2*P0u*P0v*P1v*PTu*2.0 - Lp1*Lp2*P0u*P2u*P0v*PTv*2.0 - Lp1*Lp2*P0u*P0v*P2v*PTu*2.0 - Lp1*Lp2*P0u*P1u*P2v*PTv*2.0 + Lp1*Lp2*P0u*P2u*P1v*PTv*4.0 - Lp1*Lp2*P0u*P1v*P2v*PTu*2.0 - Lp1*Lp2*P1u*P2u*P0v*PTv*2.0 + Lp1*Lp2*P1u*P0v*P2v*PTu*4.0 - Lp1*Lp2*P2u*P0v*P1v*PTu*2.0 - Lp1*Lp2*P0u*P2u*P2v*PTv*2.0 - Lp1*Lp2*P2u*P0v*P2v*PTu*2.0 + Lp1*Lp2*P1u*P2u*P2v*PTv*2.0 + Lp1*Lp2*P2u*P1v*P2v*PTu*2.0 - Lp1*Lq1*P0u*P1u*P1v*PTv*2.0 + Lp1*Lq1*P0u*P2u*P0v*PTv*4.0 + Lp1*Lq1*P0u*P0v*P2v*PTu*4.0 - Lp1*Lq1*P1u*P0v*P1v*PTu*2.0 - Lp2*Lq1*P0u*P1u*P0v*PTv*2.0 - Lp2*Lq1*P0u*P0v*P1v*PTu*2.0 + Lp1*Lq1*P0u*P1u*P2v*PTv*6.0 - Lp1*Lq1*P0u*P1v*P2v*PTu*6.0 - Lp1*Lq1*P1u*P2u*P0v*PTv*6.0 + Lp1*Lq1*P2u*P0v*P1v*PTu*6.0 - Lp2*Lq1*P0u*P1u*P1v*PTv*2.0 + Lp2*Lq1*P0u*P2u*P0v*PTv*2.0 + Lp2*Lq1*P0u*P0v*P2v*PTu*2.0 - Lp2*Lq1*P1u*P0v*P1v*PTu*2.0 + Lp1*Lq1*P1u*P2u*P1v*PTv*2.0 + Lp1*Lq1*P1u*P1v*P2v*PTu*2.0 + Lp2*Lq1*P0u*P1u*P2v*PTv*4.0 - Lp2*Lq1*P0u*P2u*P1v*PTv*2.0 - Lp2*Lq1*P0u*P1v*P2v*PTu*2.0 - Lp2*Lq1*P1u*P2u*P0v*PTv*2.0 - Lp2*Lq1*P1u*P0v*P2v*PTu*2.0 + Lp2*Lq1*P2u*P0v*P1v*PTu*4.0 + Lp2*Lq1*P1u*P2u*P1v*PTv*2.0 + Lp2*Lq1*P1u*P1v*P2v*PTu*2.0 - Lp1*Lq1*P0u*P0v*PTu*PTv*4.0 + Lp1*Lq1*P0u*P1v*PTu*PTv*2.0 + Lp1*Lq1*P1u*P0v*PTu*PTv*2.0 + Lp1*Lq1*P0u*P2v*PTu*PTv*2.0 + Lp1*Lq1*P2u*P0v*PTu*PTv*2.0 - Lp1*Lq1*P1u*P2v*PTu*PTv*2.0 - Lp1*Lq1*P2u*P1v*PTu*PTv*2.0)*(1.0 / 2.0) + P0u*P1v*(1.0 / 2.0) - P1u*P0v*(1.0 / 2.0) - P0u*PTv*(1.0 / 2.0) + P0v*PTu*(1.0 / 2.0) + P1u*PTv*(1.0 / 2.0) - P1v*PTu*(1.0 / 2.0) - Lp1*P0u*P1v*(1.0 / 2.0) + Lp1*P1u*P0v*(1.0 / 2.0) + Lp1*P0u*P2v - Lp1*P2u*P0v - Lp2*P0u*P1v*(1.0 / 2.0) + Lp2*P1u*P0v*(1.0 / 2.0) - Lp1*P1u*P2v*(1.0 / 2.0) + Lp1*P2u*P1v*(1.0 / 2.0) + Lp2*P0u*P2v*(1.0 / 2.0) - Lp2*P2u*P0v*(1.0 / 2.0) - Lp2*P1u*P2v*(1.0 / 2.0) + Lp2*P2u*P1v*(1.0 / 2.0) + Lq1*P0u*P1v*(1.0 / 2.0) - Lq1*P1u*P0v*(1.0 / 2.0) - Lp1*P0u*PTv*(1.0 / 2.0) + Lp1*P0v*PTu*(1.0 / 2.0) + Lp1*P2u*PTv*(1.0 / 2.0) - Lp1*P2v*PTu*(1.0 / 2.0) - Lq1*P0u*PTv*(1.0 / 2.0) + Lq1*P0v*PTu*(1.0 / 2.0) + Lq1*P1u*PTv*(1.0 / 2.0) - Lq1*P1v*PTu*(1.0 / 2.0)) / (P0u*P1v - P1u*P0v - P0u*PTv + P0v*PTu + P1u*PTv - P1v*PTu - Lp1*P0u*P1v + Lp1*P1u*P0v + Lp1*P0u*P2v - Lp1*P2u*P0v - Lp1*P1u*P2v + Lp1*P2u*P1v);
+	// Coefficients
+	float R = findCoefficient_(target, solver.red, warm);
+	float G = findCoefficient_(target, solver.green, warm ? warm + 1 : nullptr);
+	float B = findCoefficient_(target, solver.blue, warm ? warm + 2 : nullptr);
+	if (R < 0) R = 0.0;
+	if (G < 0) G = 0.0;
+	if (B < 0) B = 0.0;
+
+	// Find max raw value
+	float maxRaw = R;
+	if (G > maxRaw) maxRaw = G;
+	if (B > maxRaw) maxRaw = B;
+
+	// Scale coefficients so that the brightest LED is at full power and convert to fixed point, 65536 is full power
+	level[0] = 0;
+	level[1] = 0;
+	level[2] = 0;
+	uint32_t maxY = 0;
+	if (maxRaw > 0) {
+		float scale = static_cast<float>(divide_(65536, maxRaw));
+		level[0] = fixed_(R * scale);
+		level[1] = fixed_(G * scale);
+		level[2] = fixed_(B * scale);
+
+		// Luma produced at full power, this is the maximum possible at the target chromaticity
+		maxY = fixed_((R * solver.redY + G * solver.greenY + B * solver.blueY) * scale);
 	}
-	else {
-		dR = 1.0 - (sqrt(Lp1*Lp1*P0u*P0u*P2v*P2v - 2 * Lp1*Lp1*P0u*P0u*P2v*PTv + Lp1*Lp1*P0u*P0u*PTv*PTv - 2 * Lp1*Lp1*P0u*P2u*P0v*P2v + 2 * Lp1*Lp1*P0u*P2u*P0v*PTv + 2 * Lp1*Lp1*P0u*P2u*P2v*PTv - 2 * Lp1*Lp1*P0u*P2u*PTv*PTv + 2 * Lp1*Lp1*P0u*P0v*P2v*PTu - 2 * Lp1*Lp1*P0u*P0v*PTu*PTv - 2 * Lp1*Lp1*P0u*P2v*P2v*PTu + 2 * Lp1*Lp1*P0u*P2v*PTu*PTv + Lp1*Lp1*P2u*P2u*P0v*P0v - 2 * Lp1*Lp1*P2u*P2u*P0v*PTv + Lp1*Lp1*P2u*P2u*PTv*PTv - 2 * Lp1*Lp1*P2u*P0v*P0v*PTu + 2 * Lp1*Lp1*P2u*P0v*P2v*PTu + 2 * Lp1*Lp1*P2u*P0v*PTu*PTv - 2 * Lp1*Lp1*P2u*P2v*PTu*PTv + Lp1*Lp1*P0v*P0v*PTu*PTu - 2 * Lp1*Lp1*P0v*P2v*PTu*PTu + Lp1*Lp1*P2v*P2v*PTu*PTu - 2 * Lp1*Lp2*P0u*P0u*P1v*P2v + 2 * Lp1*Lp2*P0u*P0u*P1v*PTv + 2 * Lp1*Lp2*P0u*P0u*P2v*P2v - 2 * Lp1*Lp2*P0u*P0u*P2v*PTv + 2 * Lp1*Lp2*P0u*P1u*P0v*P2v - 2 * Lp1*Lp2*P0u*P1u*P0v*PTv - 2 * Lp1*Lp2*P0u*P1u*P2v*P2v + 2 * Lp1*Lp2*P0u*P1u*P2v*PTv + 2 * Lp1*Lp2*P0u*P2u*P0v*P1v - 4 * Lp1*Lp2*P0u*P2u*P0v*P2v + 2 * Lp1*Lp2*P0u*P2u*P0v*PTv + 2 * Lp1*Lp2*P0u*P2u*P1v*P2v - 4 * Lp1*Lp2*P0u*P2u*P1v*PTv + 2 * Lp1*Lp2*P0u*P2u*P2v*PTv - 2 * Lp1*Lp2*P0u*P0v*P1v*PTu + 2 * Lp1*Lp2*P0u*P0v*P2v*PTu + 2 * Lp1*Lp2*P0u*P1v*P2v*PTu - 2 * Lp1*Lp2*P0u*P2v*P2v*PTu - 2 * Lp1*Lp2*P1u*P2u*P0v*P0v + 2 * Lp1*Lp2*P1u*P2u*P0v*P2v + 2 * Lp1*Lp2*P1u*P2u*P0v*PTv - 2 * Lp1*Lp2*P1u*P2u*P2v*PTv + 2 * Lp1*Lp2*P1u*P0v*P0v*PTu - 4 * Lp1*Lp2*P1u*P0v*P2v*PTu + 2 * Lp1*Lp2*P1u*P2v*P2v*PTu + 2 * Lp1*Lp2*P2u*P2u*P0v*P0v - 2 * Lp1*Lp2*P2u*P2u*P0v*P1v - 2 * Lp1*Lp2*P2u*P2u*P0v*PTv + 2 * Lp1*Lp2*P2u*P2u*P1v*PTv - 2 * Lp1*Lp2*P2u*P0v*P0v*PTu + 2 * Lp1*Lp2*P2u*P0v*P1v*PTu + 2 * Lp1*Lp2*P2u*P0v*P2v*PTu - 2 * Lp1*Lp2*P2u*P1v*P2v*PTu - 2 * Lp1*Lq1*P0u*P0u*P1v*P2v + 2 * Lp1*Lq1*P0u*P0u*P1v*PTv + 2 * Lp1*Lq1*P0u*P0u*P2v*PTv - 2 * Lp1*Lq1*P0u*P0u*PTv*PTv + 2 * Lp1*Lq1*P0u*P1u*P0v*P2v - 2 * Lp1*Lq1*P0u*P1u*P0v*PTv - 2 * Lp1*Lq1*P0u*P1u*P2v*PTv + 2 * Lp1*Lq1*P0u*P1u*PTv*PTv + 2 * Lp1*Lq1*P0u*P2u*P0v*P1v - 2 * Lp1*Lq1*P0u*P2u*P0v*PTv - 2 * Lp1*Lq1*P0u*P2u*P1v*PTv + 2 * Lp1*Lq1*P0u*P2u*PTv*PTv - 2 * Lp1*Lq1*P0u*P0v*P1v*PTu - 2 * Lp1*Lq1*P0u*P0v*P2v*PTu + 4 * Lp1*Lq1*P0u*P0v*PTu*PTv + 4 * Lp1*Lq1*P0u*P1v*P2v*PTu - 2 * Lp1*Lq1*P0u*P1v*PTu*PTv - 2 * Lp1*Lq1*P0u*P2v*PTu*PTv - 2 * Lp1*Lq1*P1u*P2u*P0v*P0v + 4 * Lp1*Lq1*P1u*P2u*P0v*PTv - 2 * Lp1*Lq1*P1u*P2u*PTv*PTv + 2 * Lp1*Lq1*P1u*P0v*P0v*PTu - 2 * Lp1*Lq1*P1u*P0v*P2v*PTu - 2 * Lp1*Lq1*P1u*P0v*PTu*PTv + 2 * Lp1*Lq1*P1u*P2v*PTu*PTv + 2 * Lp1*Lq1*P2u*P0v*P0v*PTu - 2 * Lp1*Lq1*P2u*P0v*P1v*PTu - 2 * Lp1*Lq1*P2u*P0v*PTu*PTv + 2 * Lp1*Lq1*P2u*P1v*PTu*PTv - 2 * Lp1*Lq1*P0v*P0v*PTu*PTu + 2 * Lp1*Lq1*P0v*P1v*PTu*PTu + 2 * Lp1*Lq1*P0v*P2v*PTu*PTu - 2 * Lp1*Lq1*P1v*P2v*PTu*PTu + Lp2*Lp2*P0u*P0u*P1v*P1v - 2 * Lp2*Lp2*P0u*P0u*P1v*P2v + Lp2*Lp2*P0u*P0u*P2v*P2v - 2 * Lp2*Lp2*P0u*P1u*P0v*P1v + 2 * Lp2*Lp2*P0u*P1u*P0v*P2v + 2 * Lp2*Lp2*P0u*P1u*P1v*P2v - 2 * Lp2*Lp2*P0u*P1u*P2v*P2v + 2 * Lp2*Lp2*P0u*P2u*P0v*P1v - 2 * Lp2*Lp2*P0u*P2u*P0v*P2v - 2 * Lp2*Lp2*P0u*P2u*P1v*P1v + 2 * Lp2*Lp2*P0u*P2u*P1v*P2v + Lp2*Lp2*P1u*P1u*P0v*P0v - 2 * Lp2*Lp2*P1u*P1u*P0v*P2v + Lp2*Lp2*P1u*P1u*P2v*P2v - 2 * Lp2*Lp2*P1u*P2u*P0v*P0v + 2 * Lp2*Lp2*P1u*P2u*P0v*P1v + 2 * Lp2*Lp2*P1u*P2u*P0v*P2v - 2 * Lp2*Lp2*P1u*P2u*P1v*P2v + Lp2*Lp2*P2u*P2u*P0v*P0v - 2 * Lp2*Lp2*P2u*P2u*P0v*P1v + Lp2*Lp2*P2u*P2u*P1v*P1v - 2 * Lp2*Lq1*P0u*P0u*P1v*P1v + 2 * Lp2*Lq1*P0u*P0u*P1v*P2v + 2 * Lp2*Lq1*P0u*P0u*P1v*PTv - 2 * Lp2*Lq1*P0u*P0u*P2v*PTv + 4 * Lp2*Lq1*P0u*P1u*P0v*P1v - 2 * Lp2*Lq1*P0u*P1u*P0v*P2v - 2 * Lp2*Lq1*P0u*P1u*P0v*PTv - 2 * Lp2*Lq1*P0u*P1u*P1v*P2v - 2 * Lp2*Lq1*P0u*P1u*P1v*PTv + 4 * Lp2*Lq1*P0u*P1u*P2v*PTv - 2 * Lp2*Lq1*P0u*P2u*P0v*P1v + 2 * Lp2*Lq1*P0u*P2u*P0v*PTv + 2 * Lp2*Lq1*P0u*P2u*P1v*P1v - 2 * Lp2*Lq1*P0u*P2u*P1v*PTv - 2 * Lp2*Lq1*P0u*P0v*P1v*PTu + 2 * Lp2*Lq1*P0u*P0v*P2v*PTu + 2 * Lp2*Lq1*P0u*P1v*P1v*PTu - 2 * Lp2*Lq1*P0u*P1v*P2v*PTu - 2 * Lp2*Lq1*P1u*P1u*P0v*P0v + 2 * Lp2*Lq1*P1u*P1u*P0v*P2v + 2 * Lp2*Lq1*P1u*P1u*P0v*PTv - 2 * Lp2*Lq1*P1u*P1u*P2v*PTv + 2 * Lp2*Lq1*P1u*P2u*P0v*P0v - 2 * Lp2*Lq1*P1u*P2u*P0v*P1v - 2 * Lp2*Lq1*P1u*P2u*P0v*PTv + 2 * Lp2*Lq1*P1u*P2u*P1v*PTv + 2 * Lp2*Lq1*P1u*P0v*P0v*PTu - 2 * Lp2*Lq1*P1u*P0v*P1v*PTu - 2 * Lp2*Lq1*P1u*P0v*P2v*PTu + 2 * Lp2*Lq1*P1u*P1v*P2v*PTu - 2 * Lp2*Lq1*P2u*P0v*P0v*PTu + 4 * Lp2*Lq1*P2u*P0v*P1v*PTu - 2 * Lp2*Lq1*P2u*P1v*P1v*PTu + 4 * Lp2*P0u*P0u*P1v*P2v - 4 * Lp2*P0u*P0u*P1v*PTv - 4 * Lp2*P0u*P0u*P2v*PTv + 4 * Lp2*P0u*P0u*PTv*PTv - 4 * Lp2*P0u*P1u*P0v*P2v + 4 * Lp2*P0u*P1u*P0v*PTv + 4 * Lp2*P0u*P1u*P2v*PTv - 4 * Lp2*P0u*P1u*PTv*PTv - 4 * Lp2*P0u*P2u*P0v*P1v + 4 * Lp2*P0u*P2u*P0v*PTv + 4 * Lp2*P0u*P2u*P1v*PTv - 4 * Lp2*P0u*P2u*PTv*PTv + 4 * Lp2*P0u*P0v*P1v*PTu + 4 * Lp2*P0u*P0v*P2v*PTu - 8 * Lp2*P0u*P0v*PTu*PTv - 8 * Lp2*P0u*P1v*P2v*PTu + 4 * Lp2*P0u*P1v*PTu*PTv + 4 * Lp2*P0u*P2v*PTu*PTv + 4 * Lp2*P1u*P2u*P0v*P0v - 8 * Lp2*P1u*P2u*P0v*PTv + 4 * Lp2*P1u*P2u*PTv*PTv - 4 * Lp2*P1u*P0v*P0v*PTu + 4 * Lp2*P1u*P0v*P2v*PTu + 4 * Lp2*P1u*P0v*PTu*PTv - 4 * Lp2*P1u*P2v*PTu*PTv - 4 * Lp2*P2u*P0v*P0v*PTu + 4 * Lp2*P2u*P0v*P1v*PTu + 4 * Lp2*P2u*P0v*PTu*PTv - 4 * Lp2*P2u*P1v*PTu*PTv + 4 * Lp2*P0v*P0v*PTu*PTu - 4 * Lp2*P0v*P1v*PTu*PTu - 4 * Lp2*P0v*P2v*PTu*PTu + 4 * Lp2*P1v*P2v*PTu*PTu + Lq1*Lq1*P0u*P0u*P1v*P1v - 2 * Lq1*Lq1*P0u*P0u*P1v*PTv + Lq1*Lq1*P0u*P0u*PTv*PTv - 2 * Lq1*Lq1*P0u*P1u*P0v*P1v + 2 * Lq1*Lq1*P0u*P1u*P0v*PTv + 2 * Lq1*Lq1*P0u*P1u*P1v*PTv - 2 * Lq1*Lq1*P0u*P1u*PTv*PTv + 2 * Lq1*Lq1*P0u*P0v*P1v*PTu - 2 * Lq1*Lq1*P0u*P0v*PTu*PTv - 2 * Lq1*Lq1*P0u*P1v*P1v*PTu + 2 * Lq1*Lq1*P0u*P1v*PTu*PTv + Lq1*Lq1*P1u*P1u*P0v*P0v - 2 * Lq1*Lq1*P1u*P1u*P0v*PTv + Lq1*Lq1*P1u*P1u*PTv*PTv - 2 * Lq1*Lq1*P1u*P0v*P0v*PTu + 2 * Lq1*Lq1*P1u*P0v*P1v*PTu + 2 * Lq1*Lq1*P1u*P0v*PTu*PTv - 2 * Lq1*Lq1*P1u*P1v*PTu*PTv + Lq1*Lq1*P0v*P0v*PTu*PTu - 2 * Lq1*Lq1*P0v*P1v*PTu*PTu + Lq1*Lq1*P1v*P1v*PTu*PTu) + 2 * P0u*P1v - 2 * P1u*P0v - 2 * P0u*PTv + 2 * P0v*PTu + 2 * P1u*PTv - 2 * P1v*PTu - 2 * Lp1*P0u*P1v + 2 * Lp1*P1u*P0v + Lp1*P0u*P2v - Lp1*P2u*P0v - Lp2*P0u*P1v + Lp2*P1u*P0v - 2 * Lp1*P1u*P2v + 2 * Lp1*P2u*P1v + Lp2*P0u*P2v - Lp2*P2u*P0v - Lp2*P1u*P2v + Lp2*P2u*P1v + Lq1*P0u*P1v - Lq1*P1u*P0v + Lp1*P0u*PTv - Lp1*P0v*PTu - Lp1*P2u*PTv + Lp1*P2v*PTu - Lq1*P0u*PTv + Lq1*P0v*PTu + Lq1*P1u*PTv - Lq1*P1v*PTu) / (2 * (P0u*P1v - P1u*P0v - P0u*PTv + P0v*PTu + P1u*PTv - P1v*PTu - Lp1*P0u*P1v + Lp1*P1u*P0v + Lp1*P0u*P2v - Lp1*P2u*P0v - Lp1*P1u*P2v + Lp1*P2u*P1v));
+
+	// Luma level needed for requested lightness
+	uint32_t targetY = LedLightness::toLuma(mapLightness_(target));
+
+	// Luma factor, nothing can be more than at max power
+	uint32_t C = 65536;
+	if (targetY < maxY) {
+		C = (targetY << 16) / maxY;
 	}
 
-	double level;
-	if (Rp1 < 0) {
-		level = (Rp1*dR + Rp2) / (dR + Rq1);
+	// Scale levels to produce target luma
+	if (C < 65536) {
+		for (uint8_t i = 0; i < 3; ++i) {
+			level[i] = (level[i] * C) >> 16;
+		}
 	}
-	else {
-		level = (Rp1*(1 - dR) + Rp2) / ((1 - dR) + Rq1);
+}
+
+void LedEngine::resetWarmStart_() {
+	warm_[0] = -1;
+	warm_[1] = -1;
+	warm_[2] = -1;
+}
+
+float LedEngine::mapLightness_(const Luv target) {
+	if (lightnessKnee_ >= 1) return target.L;
+	float maxL = model_->getLightnessGrid().sample(target.u, target.v);
+	float kneeL = lightnessKnee_ * maxL;
+	if (target.L <= kneeL) return target.L;
+
+	// Compress the excess so that the slope is continuous at the knee and approaches the maximum asymptotically
+	float excess = target.L - kneeL;
+	float headroom = maxL - kneeL;
+	if (headroom <= 0) return maxL;
+	return kneeL + headroom * excess / (excess + headroom);
+}
+
+bool LedEngine::estimateTemperature_(const LedState &state, LedTemperature &temperature) {
+	float u = state.luv.u;
+	float v = state.luv.v;
+
+	// Raw color, mix LED chromaticities additively. With luminances Y the mixture in u', v' is the average of the
+	// LED coordinates weighted by Y / v'.
+	if (state.luv.L < 0) {
+		const LedCalibration &calibration = model_->getCalibration();
+		float w[3] = {
+			calibration.redLum * state.duty[0] / calibration.redUv.v,
+			calibration.greenLum * state.duty[1] / calibration.greenUv.v,
+			calibration.blueLum * state.duty[2] / calibration.blueUv.v
+		};
+		float sum = w[0] + w[1] + w[2];
+		if (sum <= 0) return false;
+		u = (w[0] * calibration.redUv.u + w[1] * calibration.greenUv.u + w[2] * calibration.blueUv.u) / sum;
+		v = (w[0] * calibration.redUv.v + w[1] * calibration.greenUv.v + w[2] * calibration.blueUv.v) / sum;
+
+		// Level fits make the LEDs mix non-linearly, refine with Newton's method on the solver so that solving the
+		// estimate gives back the raw color
+		float total = static_cast<float>(state.duty[0]) + state.duty[1] + state.duty[2];
+		float target[2] = { state.duty[0] / total, state.duty[1] / total };
+		const float h = 0.0001f;
+		for (uint8_t i = 0; i < 4; ++i) {
+			float f[2];
+			float fu[2];
+			float fv[2];
+			if (!shares_(u, v, f) || !shares_(u + h, v, fu) || !shares_(u, v + h, fv)) break;
+
+			// Jacobian by forward differences
+			float a = (fu[0] - f[0]) / h;
+			float b = (fv[0] - f[0]) / h;
+			float c = (fu[1] - f[1]) / h;
+			float d = (fv[1] - f[1]) / h;
+			float det = a * d - b * c;
+			if (det == 0) break;
+			float e0 = f[0] - target[0];
+			float e1 = f[1] - target[1];
+			u -= (d * e0 - b * e1) / det;
+			v -= (a * e1 - c * e0) / det;
+		}
+	}
+
+	temperature = LedLocus::toTemperature(u, v);
+	return true;
+}
+
+bool LedEngine::shares_(const float u, const float v, float share[2]) {
+	const LedSolver &solver = model_->getSolver();
+	Luv target = { 0, u, v };
+	float R = findCoefficient_(target, solver.red);
+	float G = findCoefficient_(target, solver.green);
+	float B = findCoefficient_(target, solver.blue);
+	if (R < 0) R = 0.0;
+	if (G < 0) G = 0.0;
+	if (B < 0) B = 0.0;
+	float total = R + G + B;
+	if (!(total > 0)) return false;
+	share[0] = R / total;
+	share[1] = G / total;
+	return true;
+}
+
+bool LedEngine::belowThreshold_(const Luv current, const Luv target) {
+	if (threshold_.deltaE <= 0 && threshold_.deltaUv <= 0) return false;
+
+	// Chromaticity distance
+	float du = target.u - current.u;
+	float dv = target.v - current.v;
+	if (threshold_.deltaUv > 0 && du * du + dv * dv >= threshold_.deltaUv * threshold_.deltaUv) return false;
+
+	// CIE 1976 color difference, u* and v* are relative to D65 white point
+	if (threshold_.deltaE > 0) {
+		float L = target.L > 0 ? target.L : 0;
+		float dL = L - current.L;
+		float dus = 13 * (L * (target.u - 0.19784f) - current.L * (current.u - 0.19784f));
+		float dvs = 13 * (L * (target.v - 0.46832f) - current.L * (current.v - 0.46832f));
+		if (dL * dL + dus * dus + dvs * dvs >= threshold_.deltaE * threshold_.deltaE) return false;
+	}
+	return true;
+}
+
+float LedEngine::findCoefficient_(const Luv PT, const LedSolverChannel &channel, float *warm) {
+
+	double u = PT.u;
+	double v = PT.v;
+	const double *q = channel.radicand;
+	const double *l = channel.linear;
+	const double *d = channel.denominator;
+	const double *c = channel.conjugate;
+
+	// Polynomials of target coordinates, calibration dependent terms have been folded into the coefficients
+	double linear = l[0]*u + l[1]*v + l[2];
+	double denominator = d[0]*u + d[1]*v + d[2];
+	double conjugate = c[0]*u + c[1]*v + c[2];
+
+	// Previous solution of a nearby target converges in a couple of Newton steps
+	double x = warm ? *warm : -1.0;
+	if (!warm || !channel.refine(linear, denominator, conjugate, x)) {
+		double radicand = (q[0]*u + q[2]*v + q[3])*u + (q[1]*v + q[4])*v + q[5];
+
+		// Radicand is slightly negative at the primaries due to rounding and negative outside of the gamut, the
+		// closest real solution is at zero. Negated comparison also catches NaN targets.
+		if (!(radicand > 0)) radicand = 0.0;
+
+		// Normalized distance, limited to the gamut
+		x = channel.distance(linear, channel.root * squareRoot_(radicand), denominator, conjugate);
 	}
+	if (warm) *warm = static_cast<float>(x);
+
+	double level = divide_(channel.fit[0]*x + channel.fit[1], x + channel.fit[2]);
 
 	return level;
 }
+
+void LedEngine::writeDuty_() {
+
+	// Stage all channels, white LEDs are not driven yet but are kept in the same update
+	if (state_.onOff) {
+		output_->set(redChannel_, state_.duty[0]);
+		output_->set(greenChannel_, state_.duty[1]);
+		output_->set(blueChannel_, state_.duty[2]);
+	}
+	else {
+		output_->set(redChannel_, 0);
+		output_->set(greenChannel_, 0);
+		output_->set(blueChannel_, 0);
+	}
+	output_->set(warmChannel_, 0);
+	output_->set(coldChannel_, 0);
+
+	// Write PWMs, deferred to commitFrame if a frame is open
+	output_->flush();
+}
+
+float LedEngine::mired_(const uint16_t T) {
+	return T > 0 ? 1000000.0f / T : LedLocus::MIRED_MAX;
+}
+
+double LedEngine::squareRoot_(const double x) {
+#ifdef LED_ENGINE_FAST_MATH
+	if (!(x < 1e38)) return x > 0 ? sqrt(x) : 0.0;
+	return LedMath::sqrt(static_cast<float>(x));
+#else
+	return sqrt(x);
+#endif
+}
+
+double LedEngine::divide_(const double numerator, const double denominator) {
+#ifdef LED_ENGINE_FAST_MATH
+	// Reciprocal kernel needs normal floats for both the denominator and its reciprocal
+	double magnitude = denominator < 0 ? -denominator : denominator;
+	if (magnitude > 1.2e-38 && magnitude < 1e38) {
+		return numerator * LedMath::reciprocal(static_cast<float>(denominator));
+	}
+#endif
+	return numerator / denominator;
+}
+
+uint32_t LedEngine::fixed_(const float x) {
+	if (x >= 65536) return 65536;
+	return static_cast<uint32_t>(x + 0.5f);
+}
@@ -1,21 +1,27 @@
 #pragma once
 
-/**
- * Data structure for CIE 1976 Luv coordinates
- */
-struct Luv {
-	float L;
-	float u;
-	float v;
-};
+#include "LedMath.h"
+#include "LedModel.h"
+#include "LedOutput.h"
+#include "LedPwm.h"
+#include "LedState.h"
+#include "LedThreadPool.h"
+
+class LedTrace;
 
 /**
- * Data structure for RGB color
+ * How an engine solves LED levels for colors set one at a time
  */
-struct RGB {
-	float R;
-	float G;
-	float B;
+enum class LedSolverMode : uint8_t {
+	/**
+	 * Closed form solution of every target from scratch
+	 */
+	ClosedForm,
+
+	/**
+	 * Newton iterations starting from the previous solution, falls back to the closed form when they do not converge
+	 */
+	Newton
 };
 
 /**
@@ -26,14 +32,30 @@ public:
 	/**
 	 * Constructor
 	 *
+	 * \param output Output backend for the LED channels
+	 * \param redChannel Output channel for red LED
+	 * \param greenChannel Output channel for green LED
+	 * \param blueChannel Output channel for blue LED
+	 * \param warmChannel Output channel for warm white LED
+	 * \param coldChannel Output channel for cold white LED
+	 * \param pwmRange PWM bit width as a maximum possible value e.g. 255, 1023, 4095 or 65535
+	 */
+	LedEngine(LedOutput &output, const uint16_t redChannel, const uint16_t greenChannel, const uint16_t blueChannel,
+		const uint16_t warmChannel, const uint16_t coldChannel, uint16_t pwmRange);
+
+#ifdef ARDUINO
+	/**
+	 * Constructor for LEDs connected to the MCU's own PWM pins
+	 *
 	 * \param redPin GPIO pin number for red LED
 	 * \param greenPin GPIO pin number for green LED
 	 * \param bluePin GPIO pin number for blue LED
 	 * \param warmPin GPIO pin number for warm white LED
 	 * \param coldPin GPIO pin number for cold white LED
-	 * \param pwmRange PWM bit width as a maximum possible value e.g. 255 or 1023
+	 * \param pwmRange PWM bit width as a maximum possible value e.g. 255, 1023, 4095 or 65535
 	 */
 	LedEngine(const uint8_t redPin, const uint8_t greenPin, const uint8_t bluePin, const uint8_t warmPint, const uint8_t coldPin, uint16_t pwmRange);
+#endif
 
 	/**
 	 * Is the light on?
@@ -77,13 +99,69 @@ public:
 	 */
 	void setCie1976Ucs(const Luv luv);
 
+	/**
+	 * Get lightness produced by the current PWM duties
+	 *
+	 * Differs from the requested lightness when it is not achievable at the requested chromaticity or when it was
+	 * compressed by the lightness knee. Raw colors report their lightness too.
+	 *
+	 * This is the lightness of the color the light shows when on, also while it is off, so that e.g. transitions and
+	 * partial updates keep the lightness of a raw color. Check getOnOff for what is actually emitted.
+	 *
+	 * \return CIE 1976 lightness of the current duties when the light is on
+	 */
+	float getLightness();
+
+	/**
+	 * Get maximum achievable lightness at a chromaticity
+	 *
+	 * Interpolated from a grid which is built when the engine is calibrated, so this is cheap enough for clients to
+	 * call before every request.
+	 *
+	 * \param u u' coordinate
+	 * \param v v' coordinate
+	 * \return Maximum CIE 1976 lightness
+	 */
+	float getMaxLightness(const float u, const float v);
+
+	/**
+	 * Get lightness knee
+	 *
+	 * \return Fraction of maximum lightness above which requested lightness is compressed
+	 */
+	float getLightnessKnee();
+
+	/**
+	 * Sets how requested lightness is mapped into the achievable range
+	 *
+	 * Requested lightness up to knee times the maximum lightness at the target chromaticity is produced as such.
+	 * Lightness above it is compressed smoothly towards the maximum, so that lightness keeps increasing with the
+	 * request instead of clipping at the maximum. Knee of 1 clips, which is the default.
+	 *
+	 * \param knee Fraction of maximum lightness in the range 0..1
+	 */
+	void setLightnessKnee(const float knee);
+
 	/**
 	 * Get color temperature in Kelvins
 	 *
-	 * \return Color temperature in Kelvins
+	 * Color set by color temperature reports the set value. Otherwise the correlated color temperature is estimated
+	 * from the u', v' coordinates, or for raw colors from the u', v' coordinates which the solver maps to the same
+	 * LED proportions.
+	 *
+	 * \return Color temperature in Kelvins, 0xFFFF if the light is black raw color
 	 */
 	uint16_t getColorTemperature();
 
+	/**
+	 * Get distance from the Planckian locus
+	 *
+	 * Estimated like the color temperature when the color was not set by color temperature.
+	 *
+	 * \return Distance from the Planckian locus in CIE 1960 UCS, positive towards green
+	 */
+	float getDuv();
+
 	/**
 	 * Sets ligth by color temperature
 	 *
@@ -92,6 +170,135 @@ public:
 	 */
 	void setColorTemperature(const float L, const uint16_t T);
 
+	/**
+	 * Sets light by reciprocal color temperature and tint
+	 *
+	 * Tint is applied as an offset along the normal of the Planckian locus, so it costs no more than a plain color
+	 * temperature update. Color temperature reports the rounded equivalent in Kelvins.
+	 *
+	 * \param L CIE 1976 lightness
+	 * \param mired Reciprocal color temperature in mireds, 1000000 / Kelvins, limited to the tabulated locus
+	 * \param duv Distance from the Planckian locus in CIE 1960 UCS, positive towards green and negative towards
+	 *            magenta, typically within -0.02..0.02
+	 */
+	void setColorTemperature(const float L, const float mired, const float duv);
+
+	/**
+	 * Converts CIE 1976 UCS colors of many pixels straight into a pixel buffer
+	 *
+	 * Uses the calibration of this engine, engine state and its output channels are not changed.
+	 *
+	 * \param targets CIE 1976 UCS coordinates and lightness for each pixel
+	 * \param pixels Destination pixels, pixels.count targets are converted
+	 */
+	void setCie1976Ucs(const Luv targets[], const LedPixels &pixels);
+
+	/**
+	 * Converts color temperatures of many pixels straight into a pixel buffer
+	 *
+	 * Uses the calibration of this engine, engine state and its output channels are not changed.
+	 *
+	 * \param L CIE 1976 lightness for each pixel
+	 * \param T Color temperature in Kelvins for each pixel
+	 * \param pixels Destination pixels, pixels.count colors are converted
+	 */
+	void setColorTemperature(const float L[], const uint16_t T[], const LedPixels &pixels);
+
+#ifndef ARDUINO
+	/**
+	 * Converts CIE 1976 UCS colors of many pixels straight into a pixel buffer using all threads of a pool
+	 *
+	 * Pixels are split into chunks which fill whole cache lines, so that threads never write to the same cache line
+	 * when the buffer is 64-byte aligned.
+	 *
+	 * \param targets CIE 1976 UCS coordinates and lightness for each pixel
+	 * \param pixels Destination pixels, pixels.count targets are converted
+	 * \param pool Thread pool
+	 */
+	void setCie1976Ucs(const Luv targets[], const LedPixels &pixels, LedThreadPool &pool);
+
+	/**
+	 * Converts color temperatures of many pixels straight into a pixel buffer using all threads of a pool
+	 *
+	 * \param L CIE 1976 lightness for each pixel
+	 * \param T Color temperature in Kelvins for each pixel
+	 * \param pixels Destination pixels, pixels.count colors are converted
+	 * \param pool Thread pool
+	 */
+	void setColorTemperature(const float L[], const uint16_t T[], const LedPixels &pixels, LedThreadPool &pool);
+#endif
+
+	/**
+	 * Get a consistent snapshot of the light state
+	 *
+	 * Setters publish the complete state at once when they finish, so on host builds any number of threads can read
+	 * the state without locking while one thread sets the color. The getters for individual values, getLightness
+	 * included, read the same snapshot.
+	 *
+	 * Calibrating replaces the fixture model and may free the previous one. Getters which read the model, i.e.
+	 * getMaxLightness, getModel, the calibration parameter getters and getColorTemperature and getDuv of colors not
+	 * set by color temperature, must not run while calibrate does, so calibrate must be serialized against them.
+	 *
+	 * \return Light state as of the latest completed setter
+	 */
+	LedState getState();
+
+	/**
+	 * Restores a light state, e.g. one kept packed by a container of fixtures sharing this engine
+	 *
+	 * Duties are written as such without solving, so the state must come from an engine with the same fixture model
+	 * and PWM range.
+	 *
+	 * \param state Light state
+	 */
+	void setState(const LedState &state);
+
+	/**
+	 * Get solver mode
+	 *
+	 * \return Solver mode for colors set one at a time
+	 */
+	LedSolverMode getSolverMode();
+
+	/**
+	 * Sets how levels of colors set one at a time are solved
+	 *
+	 * Newton mode suits fades and other smooth transitions where consecutive targets are close to each other, the
+	 * result is within 0.000001 in normalized distance of the closed form solution. Batch conversions always use the
+	 * closed form because consecutive pixels need not be close.
+	 *
+	 * \param mode Solver mode
+	 */
+	void setSolverMode(const LedSolverMode mode);
+
+	/**
+	 * Get change thresholds
+	 *
+	 * \return Change thresholds
+	 */
+	LedThreshold getThreshold();
+
+	/**
+	 * Sets change thresholds below which color updates are skipped without solving or writing
+	 *
+	 * \param threshold Change thresholds, zeros disable skipping
+	 */
+	void setThreshold(const LedThreshold &threshold);
+
+	/**
+	 * Get number of color updates which were solved and written
+	 *
+	 * \return Number of solves
+	 */
+	uint32_t getSolvedCount();
+
+	/**
+	 * Get number of color updates which were skipped because the change was below the thresholds
+	 *
+	 * \return Number of skipped updates
+	 */
+	uint32_t getSkippedCount();
+
 	/**
 	 * Get red LED CIE 1976 UCS coordinates
 	 *
@@ -139,21 +346,21 @@ public:
 	 *
 	 * \return Pointer to rational function coefficients for red LED level vs normalized red-to-green distance
 	 */
-	float * getRedToGreenFit();
+	const float * getRedToGreenFit();
 
 	/**
 	 * Get rational function coefficients for green level vs normalized green-to-blue distance
 	 *
 	 * \return Pointer to rational function coefficients for green LED level vs normalized green-to-blue distance
 	 */
-	float * getGreenToBlueFit();
+	const float * getGreenToBlueFit();
 
 	/**
 	 * Get rational function coefficients for blue level vs normalized blue-to-red distance
 	 *
 	 * \return Pointer to rational function coefficients for blue LED level vs normalized blue-to-red distance
 	 */
-	float * getBlueToRedFit();
+	const float * getBlueToRedFit();
 
 	/**
 	 * Save calibration parameters
@@ -172,116 +379,292 @@ public:
 		const float greenLum, const float blueLum, const float redToGreenFit[3], const float greenToBlueFit[3],
 		const float blueToRedFit[3]);
 
-private:
 	/**
-	 * GPIO pin number for red LED
+	 * Save calibration parameters
+	 *
+	 * Solver coefficients are computed from the calibration parameters.
+	 *
+	 * \param calibration Calibration parameters
+	 */
+	void calibrate(const LedCalibration &calibration);
+
+	/**
+	 * Save calibration parameters with precomputed solver coefficients
+	 *
+	 * Intended for fixture models whose calibration is a constexpr constant, solver coefficients are then generated
+	 * at compile time with LedSolver::fromCalibration. The engine allocates a model of its own, fixtures of the same
+	 * model should rather share an LedModel constructed from the same parameters.
+	 *
+	 * \param calibration Calibration parameters
+	 * \param solver Solver coefficients computed from the same calibration parameters
 	 */
-	uint8_t redPin_;
+	void calibrate(const LedCalibration &calibration, const LedSolver &solver);
 
 	/**
-	 * GPIO pin number for green LED
+	 * Shares a fixture model with other engines
+	 *
+	 * Nothing is copied, the engine only keeps a pointer to the model. Calibrating with parameters instead gives the
+	 * engine a model of its own and leaves other engines sharing the previous model untouched.
+	 *
+	 * \param model Fixture model which outlives the engine
 	 */
-	uint8_t greenPin_;
+	void calibrate(const LedModel &model);
 
 	/**
-	 * GPIO pin number for blue LED
+	 * Get fixture model
+	 *
+	 * \return Fixture model in use
 	 */
-	uint8_t bluePin_;
+	const LedModel &getModel();
 
 	/**
-	 * GPIO pin number for warm white LED
+	 * Records setter calls into a trace
+	 *
+	 * \param trace Trace which outlives the engine, nullptr stops recording
+	 * \param id Engine identifier stored with the calls, e.g. the engine index of a command receiver
 	 */
-	uint8_t warmPin_;
+	void setTrace(LedTrace *trace, const uint8_t id = 0);
 
+private:
 	/**
-	 * GPIO pin number for cold white LED
+	 * Output backend for the LED channels
 	 */
-	uint8_t coldPin_;
+	LedOutput *output_;
 
 	/**
-	 * PWM bit width as a maximum number, e.g. 255 or 1023
+	 * Output channel for red LED
 	 */
-	uint16_t pwmRange_;
+	uint16_t redChannel_;
 
 	/**
-	 * Is the light on?
+	 * Output channel for green LED
 	 */
-	bool onOff_;
+	uint16_t greenChannel_;
 
 	/**
-	 * Raw PWM values for the RGB LED normalized in the range 0..1
+	 * Output channel for blue LED
 	 */
-	RGB raw_;
+	uint16_t blueChannel_;
 
 	/**
-	 * CIE 1976 UCS coordinates and lightness
+	 * Output channel for warm white LED
 	 */
-	Luv luv_;
+	uint16_t warmChannel_;
 
 	/**
-	 * Color temperature
+	 * Output channel for cold white LED
 	 */
-	uint16_t T_;
+	uint16_t coldChannel_;
 
 	/**
-	 * CIE 1976 UCS coordinates for red LED
+	 * PWM bit width as a maximum number, e.g. 255, 1023, 4095 or 65535
 	 */
-	Luv redUv_ = { 100, 0.5535, 0.5170 };
+	uint16_t pwmRange_;
 
 	/**
-	 * CIE 1976 UCS coordinates for green LED
+	 * Light state, only accessed by the thread setting the color
 	 */
-	Luv greenUv_ = { 100, 0.0373, 0.5856 };
+	LedState state_ = {};
 
 	/**
-	 * CIE 1976 UCS coordinates for blue LED
+	 * Light state and the luma of its model published together
 	 */
-	Luv blueUv_{ 100, 0.1679, 0.1153 };
+	struct Snapshot_ {
+		/**
+		 * Light state
+		 */
+		LedState state;
+
+		/**
+		 * Relative luma of red, green and blue LEDs at full power in the model the duties were solved with
+		 */
+		float luma[3];
+	};
 
 	/**
-	 * Luminous flux for red LED
+	 * Light state as of the latest completed setter, read by getters from any thread
 	 */
-	float redLum_ = 0.5;
+	LedSeqlock<Snapshot_> published_;
 
 	/**
-	 * Luminous flux for green LED
+	 * Fixture model, shared with other engines of the same model
 	 */
-	float greenLum_ = 1.0;
+	LedModelRef model_ = LedModel::defaults();
 
 	/**
-	 * Luminous flux for blue LED
+	 * Fraction of maximum lightness above which requested lightness is compressed
 	 */
-	float blueLum_ = 0.75;
+	float lightnessKnee_ = 1.0;
 
 	/**
-	 * Luminous flux which yields CIE 1976 lightness of 100
+	 * Solver mode for colors set one at a time
 	 */
-	float maxLum_ = 2.25;
+	LedSolverMode solverMode_ = LedSolverMode::ClosedForm;
 
 	/**
-	 * Rational function coefficients for red LED level vs normalized red-to-green distance
+	 * Normalized distances of red, green and blue LEDs solved last in Newton mode, negative if there is none
 	 */
-	float redToGreenFit_[3] = { 2.9658, 0.0, 1.9658 };
+	float warm_[3] = { -1, -1, -1 };
 
 	/**
-	 * Rational function coefficients for green LED level vs normalized green-to-blue distance
+	 * Trace recording setter calls, nullptr if not recording
 	 */
-	float greenToBlueFit_[3] = { 1.3587, 0.0, 0.3587 };
+	LedTrace *trace_ = nullptr;
 
 	/**
-	 * Rational function coefficients for blue LED level vs normalized blue-to-red distance
+	 * Engine identifier stored with traced calls
 	 */
-	float blueToRedFit_[3] = { -0.2121, 0.2121, 0.2121 };
+	uint8_t traceId_ = 0;
 
 	/**
 	 * Finds coefficient for LED needed to produce target CIE 1976 UCS coordinates
 	 *
 	 * \param PT CIE 1976 UCS coordinates for target point
-	 * \param P0 CIE 1976 UCS coordinates for the source LED whose level is to be searched, e.g. redUv
-	 * \param P1 CIE 1976 UCS coordinates for the next LED counter-clockwise, e.g. greenUv
-	 * \param P2 CIE 1976 UCS coordinates for the last RGB LED, e.g. blueUv
-	 * \param rightHandFit Rational function coefficients for source LED level vs normalized right hand side distance
-	 * \param leftHandFit Rational function coefficients for normalized left hand side distance vs normalized right hand side distance
+	 * \param channel Precomputed solver coefficients for the LED whose level is to be searched
+	 * \param warm Normalized distance to start Newton iterations from and to update, nullptr solves in closed form
+	 */
+	float findCoefficient_(const Luv PT, const LedSolverChannel &channel, float *warm = nullptr);
+
+	/**
+	 * Change thresholds
+	 */
+	LedThreshold threshold_ = {};
+
+	/**
+	 * Number of solved color updates, read by getters from any thread
+	 */
+	LedCounter solvedCount_;
+
+	/**
+	 * Number of skipped color updates, read by getters from any thread
+	 */
+	LedCounter skippedCount_;
+
+	/**
+	 * Estimates correlated color temperature and tint of a state
+	 *
+	 * \param state Light state
+	 * \param temperature Estimated correlated color temperature and tint
+	 * \return Does the state have a chromaticity, false for black raw color
+	 */
+	bool estimateTemperature_(const LedState &state, LedTemperature &temperature);
+
+	/**
+	 * Solves red and green shares of the total LED level for a chromaticity
+	 *
+	 * \param u u' coordinate
+	 * \param v v' coordinate
+	 * \param share Red and green levels divided by the sum of all three levels
+	 * \return Was the solution valid
+	 */
+	bool shares_(const float u, const float v, float share[2]);
+
+	/**
+	 * Is the difference between current and target color below the thresholds?
+	 *
+	 * \param current CIE 1976 UCS coordinates and lightness of the current color
+	 * \param target CIE 1976 UCS coordinates and lightness of the target color
+	 * \return Can the update be skipped
+	 */
+	bool belowThreshold_(const Luv current, const Luv target);
+
+	/**
+	 * Sets color by color temperature and tint unless the change is below the thresholds
+	 *
+	 * \param L CIE 1976 lightness, the current lightness is kept if not positive
+	 * \param mired Reciprocal color temperature
+	 * \param duv Distance from the Planckian locus in CIE 1960 UCS
+	 * \param T Color temperature in Kelvins to report
+	 */
+	void setColorTemperature_(const float L, const float mired, const float duv, const uint16_t T);
+
+	/**
+	 * Sets color by color temperature and tint without change thresholds
+	 *
+	 * \param L CIE 1976 lightness, the current lightness is kept if not positive
+	 * \param mired Reciprocal color temperature
+	 * \param duv Distance from the Planckian locus in CIE 1960 UCS
+	 * \param T Color temperature in Kelvins to report
+	 */
+	void applyColorTemperature_(const float L, const float mired, const float duv, const uint16_t T);
+
+	/**
+	 * Sets color by CIE 1976 UCS coordinates without publishing the state
+	 *
+	 * \param target CIE 1976 UCS coordinates and lightness
+	 */
+	void applyCie1976Ucs_(const Luv target);
+
+	/**
+	 * Switches to a fixture model and updates the current color
+	 *
+	 * \param model Fixture model
+	 */
+	void calibrate_(const LedModelRef &model);
+
+	/**
+	 * Maps requested lightness into the achievable range with the lightness knee
+	 *
+	 * \param target CIE 1976 UCS coordinates and requested lightness
+	 * \return Lightness to produce
+	 */
+	float mapLightness_(const Luv target);
+
+	/**
+	 * Solves fixed point LED levels for a target color
+	 *
+	 * \param target CIE 1976 UCS coordinates and lightness
+	 * \param level Red, green and blue levels, 65536 is full power
+	 * \param warm Normalized distances of red, green and blue LEDs for Newton mode, nullptr solves in closed form
+	 */
+	void solve_(const Luv target, uint32_t level[3], float *warm = nullptr);
+
+	/**
+	 * Forgets previous solutions, so that the next solve is in closed form
+	 */
+	void resetWarmStart_();
+
+	/**
+	 * Converts color temperature to reciprocal color temperature
+	 *
+	 * \param T Color temperature in Kelvins
+	 * \return Reciprocal color temperature, the warmest tabulated one for zero
+	 */
+	static float mired_(const uint16_t T);
+
+	/**
+	 * Computes square root for the solver, with the fast kernel if LED_ENGINE_FAST_MATH is defined
+	 *
+	 * \param x Value, negative values and NaN give zero with the fast kernel, falls back to libm outside of the fast
+	 *          kernel's range
+	 * \return Square root
+	 */
+	static double squareRoot_(const double x);
+
+	/**
+	 * Divides for the solver, with the fast reciprocal kernel if LED_ENGINE_FAST_MATH is defined
+	 *
+	 * \param numerator Numerator
+	 * \param denominator Denominator, falls back to division outside of the fast kernel's range
+	 * \return Quotient
+	 */
+	static double divide_(const double numerator, const double denominator);
+
+	/**
+	 * Converts a value to fixed point level
+	 *
+	 * \param x Value already multiplied by 65536
+	 * \return Rounded value limited to 65536
+	 */
+	static uint32_t fixed_(const float x);
+
+	/**
+	 * Stages current PWM duties, or zeros if the light is off, for all channels and flushes the output
+	 */
+	void writeDuty_();
+
+	/**
+	 * Publishes the light state for readers together with the luma of the current model
 	 */
-	float findCoefficient_(const Luv PT, const Luv P0, const Luv P1, const Luv P2, const float rightHandFit[3], const float leftHandFit[3]);
+	void publish_();
 };
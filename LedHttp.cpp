@@ -0,0 +1,339 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LedHttp.h"
+
+/**
+ * Names of recognized body members, in the order of the field indices
+ */
+static const char *const FIELD_NAMES[LedHttpHandler::FIELD_COUNT] = { "on", "L", "u", "v", "T", "mired", "duv", "R", "G", "B" };
+
+/**
+ * Field indices
+ */
+static const uint8_t FIELD_ON = 0;
+static const uint8_t FIELD_L = 1;
+static const uint8_t FIELD_U = 2;
+static const uint8_t FIELD_V = 3;
+static const uint8_t FIELD_T = 4;
+static const uint8_t FIELD_MIRED = 5;
+static const uint8_t FIELD_DUV = 6;
+static const uint8_t FIELD_R = 7;
+static const uint8_t FIELD_G = 8;
+static const uint8_t FIELD_B = 9;
+
+#ifdef ARDUINO
+/**
+ * Writer which forwards to an Arduino client connection
+ */
+class LedClientWriter : public LedWriter {
+public:
+	LedClientWriter(Client &client) : client_(&client) {}
+
+	void write(const uint8_t *data, const uint16_t length) override {
+		client_->write(data, length);
+	}
+
+private:
+	Client *client_;
+};
+#endif
+
+LedHttpHandler::LedHttpHandler(LedEngine &engine) {
+	engine_ = &engine;
+	reset();
+}
+
+void LedHttpHandler::reset() {
+	phase_ = Phase::RequestLine;
+	route_ = Route::None;
+	method_ = 0;
+	lineLength_ = 0;
+	contentLength_ = 0;
+	received_ = 0;
+	present_ = 0;
+	json_.reset();
+}
+
+bool LedHttpHandler::feed(const uint8_t *data, const uint16_t length, LedWriter &writer) {
+	for (uint16_t i = 0; i < length; ++i) {
+		char c = static_cast<char>(data[i]);
+		switch (phase_) {
+		case Phase::RequestLine:
+		case Phase::Headers:
+			if (c == '\n') {
+				// Lines end with CR LF, a bare LF is tolerated
+				if (lineLength_ > 0 && line_[lineLength_ - 1] == '\r') --lineLength_;
+				line_[lineLength_] = 0;
+				lineLength_ = 0;
+				if (handleLine_(writer)) return true;
+			}
+			else if (lineLength_ < LINE_SIZE) {
+				line_[lineLength_++] = c;
+			}
+			break;
+		case Phase::Body:
+			// Members of nested objects are ignored
+			if (json_.feed(c) && json_.hasValue() && json_.getDepth() == 1) field_(json_.getKey(), json_.getValue());
+			if (++received_ == contentLength_) return respond_(writer);
+			break;
+		case Phase::Done:
+			// Pipelined requests are not served, the connection closes after the response
+			return false;
+		}
+	}
+	return false;
+}
+
+#ifdef ARDUINO
+bool LedHttpHandler::poll(Client &client) {
+	LedClientWriter writer(client);
+	uint8_t buffer[64];
+	while (client.available() > 0) {
+		int n = client.read(buffer, sizeof(buffer));
+		if (n <= 0) break;
+		if (feed(buffer, static_cast<uint16_t>(n), writer)) {
+			client.stop();
+			reset();
+			return true;
+		}
+	}
+	return false;
+}
+#else
+bool LedHttpHandler::poll(LedTcpServer &server) {
+	if (!server.connected()) {
+		if (!server.accept()) return false;
+		reset();
+	}
+	uint8_t buffer[128];
+	bool responded = false;
+	uint16_t n;
+	while (!responded && (n = server.receive(buffer, sizeof(buffer))) > 0) responded = feed(buffer, n, server);
+	if (responded) server.close();
+	return responded;
+}
+#endif
+
+uint32_t LedHttpHandler::getRequestCount() {
+	return requestCount_;
+}
+
+bool LedHttpHandler::handleLine_(LedWriter &writer) {
+	if (phase_ == Phase::RequestLine) {
+		// Empty lines before the request line are allowed
+		if (line_[0] == 0) return false;
+		phase_ = Phase::Headers;
+
+		// Method, path and protocol separated by single spaces
+		char *path = strchr(line_, ' ');
+		if (!path) return false;
+		*path++ = 0;
+		char *end = strchr(path, ' ');
+		if (end) *end = 0;
+		end = strchr(path, '?');
+		if (end) *end = 0;
+		method_ = strcmp(line_, "GET") == 0 ? 'G' : (strcmp(line_, "POST") == 0 ? 'P' : 0);
+		if (strcmp(path, "/state") == 0) route_ = Route::State;
+		else if (strcmp(path, "/calibration") == 0) route_ = Route::Calibration;
+		return false;
+	}
+
+	if (line_[0] == 0) {
+		// End of headers, only state updates have a body worth reading
+		if (method_ != 'P' || route_ != Route::State || contentLength_ == 0 || contentLength_ > MAX_BODY) {
+			return respond_(writer);
+		}
+		phase_ = Phase::Body;
+		json_.reset();
+		return false;
+	}
+
+	static const char NAME[] = "content-length:";
+	uint8_t n = sizeof(NAME) - 1;
+	for (uint8_t i = 0; i < n; ++i) {
+		if (tolower(static_cast<unsigned char>(line_[i])) != NAME[i]) return false;
+	}
+
+	// Larger than any accepted body when the value does not fit
+	unsigned long length = strtoul(line_ + n, nullptr, 10);
+	contentLength_ = length > MAX_BODY ? MAX_BODY + 1 : static_cast<uint32_t>(length);
+	return false;
+}
+
+void LedHttpHandler::field_(const char *key, const float value) {
+	// Null and non-finite values count as absent
+	if (!(value - value == 0)) return;
+	for (uint8_t i = 0; i < FIELD_COUNT; ++i) {
+		if (strcmp(key, FIELD_NAMES[i]) == 0) {
+			fields_[i] = value;
+			present_ |= 1 << i;
+			return;
+		}
+	}
+}
+
+bool LedHttpHandler::has_(const uint8_t field) {
+	return (present_ >> field) & 1;
+}
+
+void LedHttpHandler::apply_() {
+	LedEngine &engine = *engine_;
+	if (has_(FIELD_ON)) engine.setOnOff(fields_[FIELD_ON] != 0);
+
+	// Missing lightness keeps the current one, raw colors have no lightness of their own
+	LedState state = engine.getState();
+	float L = has_(FIELD_L) ? fields_[FIELD_L] : (state.luv.L >= 0 ? state.luv.L : engine.getLightness());
+
+	if (has_(FIELD_R) || has_(FIELD_G) || has_(FIELD_B)) {
+		RGB raw = engine.getRaw();
+		if (has_(FIELD_R)) raw.R = fields_[FIELD_R];
+		if (has_(FIELD_G)) raw.G = fields_[FIELD_G];
+		if (has_(FIELD_B)) raw.B = fields_[FIELD_B];
+		engine.setRaw(raw);
+	}
+	else if (has_(FIELD_T) || has_(FIELD_MIRED)) {
+		float duv = has_(FIELD_DUV) ? fields_[FIELD_DUV] : 0;
+		if (has_(FIELD_MIRED)) {
+			engine.setColorTemperature(L, fields_[FIELD_MIRED], duv);
+		}
+		else {
+			float T = fields_[FIELD_T];
+			uint16_t kelvins = T < 1 ? 1 : (T > 65534 ? 65534 : static_cast<uint16_t>(T + 0.5f));
+			if (duv == 0) engine.setColorTemperature(L, kelvins);
+			else engine.setColorTemperature(L, 1000000.0f / kelvins, duv);
+		}
+	}
+	else if (has_(FIELD_U) && has_(FIELD_V)) {
+		engine.setCie1976Ucs({ L, fields_[FIELD_U], fields_[FIELD_V] });
+	}
+	else if (has_(FIELD_L)) {
+		// Lightness alone keeps the color temperature or coordinates, raw colors keep their levels
+		if (state.T != 0xFFFF) engine.setColorTemperature(L, 1000000.0f / state.T, state.duv);
+		else if (state.luv.L >= 0) engine.setCie1976Ucs({ L, state.luv.u, state.luv.v });
+	}
+}
+
+bool LedHttpHandler::respond_(LedWriter &writer) {
+	const char *status = "200 OK";
+	const char *error = nullptr;
+	if (route_ == Route::None) {
+		status = "404 Not Found";
+		error = "not found";
+	}
+	else if (method_ == 0 || (method_ == 'P' && route_ == Route::Calibration)) {
+		status = "405 Method Not Allowed";
+		error = "method not allowed";
+	}
+	else if (contentLength_ > MAX_BODY) {
+		status = "413 Payload Too Large";
+		error = "body too large";
+	}
+	else if (method_ == 'P' && contentLength_ == 0) {
+		// Chunked bodies are not supported
+		status = "411 Length Required";
+		error = "length required";
+	}
+	else if (method_ == 'P' && !json_.isComplete()) {
+		status = "400 Bad Request";
+		error = "invalid json";
+	}
+	else if (method_ == 'P') {
+		apply_();
+	}
+
+	LedJsonWriter json(writer);
+	json.raw("HTTP/1.1 ");
+	json.raw(status);
+	json.raw("\r\nContent-Type: application/json\r\nConnection: close\r\nAccess-Control-Allow-Origin: *\r\n\r\n");
+	if (error) {
+		json.beginObject();
+		json.key("error");
+		json.string(error);
+		json.endObject();
+	}
+	else if (route_ == Route::State) {
+		writeState_(json);
+	}
+	else {
+		writeCalibration_(json);
+	}
+	json.flush();
+
+	phase_ = Phase::Done;
+	++requestCount_;
+	return true;
+}
+
+void LedHttpHandler::writeState_(LedJsonWriter &json) {
+	LedEngine &engine = *engine_;
+	LedState state = engine.getState();
+	uint16_t T = engine.getColorTemperature();
+	RGB raw = engine.getRaw();
+
+	json.beginObject();
+	json.key("on");
+	json.boolean(state.onOff);
+
+	// Raw colors have no coordinates
+	bool coordinates = state.luv.L >= 0;
+	json.key("L");
+	if (coordinates) json.number(state.luv.L, 2);
+	else json.null();
+	json.key("u");
+	if (coordinates) json.number(state.luv.u, 5);
+	else json.null();
+	json.key("v");
+	if (coordinates) json.number(state.luv.v, 5);
+	else json.null();
+	json.key("T");
+	if (T != 0xFFFF) json.integer(T);
+	else json.null();
+	json.key("duv");
+	json.number(engine.getDuv(), 5);
+	json.key("lightness");
+	json.number(engine.getLightness(), 2);
+
+	json.key("raw");
+	json.beginObject();
+	json.key("R");
+	json.number(raw.R, 4);
+	json.key("G");
+	json.number(raw.G, 4);
+	json.key("B");
+	json.number(raw.B, 4);
+	json.endObject();
+	json.endObject();
+}
+
+void LedHttpHandler::writeCalibration_(LedJsonWriter &json) {
+	LedEngine &engine = *engine_;
+	static const char *const UV_NAMES[3] = { "redUv", "greenUv", "blueUv" };
+	static const char *const LUM_NAMES[3] = { "redLum", "greenLum", "blueLum" };
+	static const char *const FIT_NAMES[3] = { "redToGreenFit", "greenToBlueFit", "blueToRedFit" };
+	Luv uv[3] = { engine.getRedUv(), engine.getGreenUv(), engine.getBlueUv() };
+	float lum[3] = { engine.getRedLum(), engine.getGreenLum(), engine.getBlueLum() };
+	const float *fit[3] = { engine.getRedToGreenFit(), engine.getGreenToBlueFit(), engine.getBlueToRedFit() };
+
+	json.beginObject();
+	for (uint8_t i = 0; i < 3; ++i) {
+		json.key(UV_NAMES[i]);
+		json.beginObject();
+		json.key("u");
+		json.number(uv[i].u, 5);
+		json.key("v");
+		json.number(uv[i].v, 5);
+		json.endObject();
+	}
+	for (uint8_t i = 0; i < 3; ++i) {
+		json.key(LUM_NAMES[i]);
+		json.number(lum[i], 3);
+	}
+	for (uint8_t i = 0; i < 3; ++i) {
+		json.key(FIT_NAMES[i]);
+		json.beginArray();
+		for (uint8_t j = 0; j < 3; ++j) json.number(fit[i][j], 6);
+		json.endArray();
+	}
+	json.endObject();
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "LedEngine.h"
+#include "LedJson.h"
+
+#ifdef ARDUINO
+#include <Client.h>
+#else
+#include "LedTcp.h"
+#endif
+
+/**
+ * HTTP request handler serving the state and calibration of an engine as JSON, e.g. for a WebUI
+ *
+ * Requests are parsed as the bytes arrive with fixed buffers, JSON bodies are parsed member by member and responses
+ * are formatted straight into the connection, so nothing is allocated per request. Every response closes the
+ * connection.
+ *
+ *     GET /state            {"on":true,"L":50.00,"u":0.25000,"v":0.50000,"T":2700,"duv":0.00000,...}
+ *     POST /state           {"on":true,"L":60,"T":3000} or {"u":0.2,"v":0.45} or {"R":1,"G":0.5,"B":0}
+ *     GET /calibration      {"redUv":{"u":...,"v":...},...,"redToGreenFit":[...],...}
+ *
+ * POST /state sets raw levels if any of R, G and B is given, otherwise color temperature if T or mired is given,
+ * otherwise u', v' coordinates if both are given, otherwise only lightness. Missing lightness keeps the current one.
+ * The response is the new state.
+ */
+class LedHttpHandler {
+public:
+	/**
+	 * Longest request line or header line, longer lines are truncated
+	 */
+	static const uint8_t LINE_SIZE = 96;
+
+	/**
+	 * Largest accepted request body in bytes
+	 */
+	static const uint16_t MAX_BODY = 1024;
+
+	/**
+	 * Number of recognized body members
+	 */
+	static const uint8_t FIELD_COUNT = 10;
+
+	/**
+	 * Constructor
+	 *
+	 * \param engine Engine which is controlled
+	 */
+	LedHttpHandler(LedEngine &engine);
+
+	/**
+	 * Prepares for a new request, e.g. when a new client connects
+	 */
+	void reset();
+
+	/**
+	 * Parses request bytes and writes the response once the request is complete
+	 *
+	 * \param data Request bytes as they arrive
+	 * \param length Number of bytes
+	 * \param writer Destination of the response
+	 * \return Was the response written, the connection should then be closed
+	 */
+	bool feed(const uint8_t *data, const uint16_t length, LedWriter &writer);
+
+#ifdef ARDUINO
+	/**
+	 * Handles the bytes waiting in a client connection and stops the client after responding
+	 *
+	 * Keep calling with the same client until this returns true and call reset before serving a new client.
+	 *
+	 * \param client Client connection, e.g. from WiFiServer::available
+	 * \return Was the response written
+	 */
+	bool poll(Client &client);
+#else
+	/**
+	 * Accepts a connection if none is open, handles the bytes waiting in it and closes it after responding
+	 *
+	 * \param server TCP server
+	 * \return Was the response written
+	 */
+	bool poll(LedTcpServer &server);
+#endif
+
+	/**
+	 * Get number of responses written since construction
+	 *
+	 * \return Number of handled requests
+	 */
+	uint32_t getRequestCount();
+
+private:
+	/**
+	 * Request parsing phases
+	 */
+	enum class Phase : uint8_t {
+		/**
+		 * Within the request line
+		 */
+		RequestLine,
+
+		/**
+		 * Within the headers
+		 */
+		Headers,
+
+		/**
+		 * Within the body
+		 */
+		Body,
+
+		/**
+		 * Response has been written
+		 */
+		Done
+	};
+
+	/**
+	 * Resources
+	 */
+	enum class Route : uint8_t {
+		/**
+		 * Unknown path
+		 */
+		None,
+
+		/**
+		 * Light state
+		 */
+		State,
+
+		/**
+		 * Calibration parameters
+		 */
+		Calibration
+	};
+
+	/**
+	 * Engine which is controlled
+	 */
+	LedEngine *engine_;
+
+	/**
+	 * Body parser
+	 */
+	LedJsonParser json_;
+
+	/**
+	 * Current parsing phase
+	 */
+	Phase phase_ = Phase::RequestLine;
+
+	/**
+	 * Requested resource
+	 */
+	Route route_ = Route::None;
+
+	/**
+	 * Request method, 'G' for GET, 'P' for POST and zero for anything else
+	 */
+	char method_ = 0;
+
+	/**
+	 * Current request or header line
+	 */
+	char line_[LINE_SIZE + 1];
+
+	/**
+	 * Length of the current line
+	 */
+	uint8_t lineLength_ = 0;
+
+	/**
+	 * Body length from the Content-Length header
+	 */
+	uint32_t contentLength_ = 0;
+
+	/**
+	 * Number of body bytes received
+	 */
+	uint32_t received_ = 0;
+
+	/**
+	 * Values of recognized body members
+	 */
+	float fields_[FIELD_COUNT];
+
+	/**
+	 * Bit mask of body members present
+	 */
+	uint16_t present_ = 0;
+
+	/**
+	 * Number of written responses
+	 */
+	uint32_t requestCount_ = 0;
+
+	/**
+	 * Handles a complete request or header line
+	 *
+	 * \param writer Destination of the response
+	 * \return Was the response written
+	 */
+	bool handleLine_(LedWriter &writer);
+
+	/**
+	 * Stores a body member if it is recognized
+	 *
+	 * \param key Member name
+	 * \param value Member value
+	 */
+	void field_(const char *key, const float value);
+
+	/**
+	 * Is a body member present?
+	 *
+	 * \param field Field index
+	 * \return Is the member present
+	 */
+	bool has_(const uint8_t field);
+
+	/**
+	 * Applies the body members to the engine
+	 */
+	void apply_();
+
+	/**
+	 * Writes the response for the request
+	 *
+	 * \param writer Destination of the response
+	 * \return Always true
+	 */
+	bool respond_(LedWriter &writer);
+
+	/**
+	 * Writes the light state
+	 *
+	 * \param json JSON formatter
+	 */
+	void writeState_(LedJsonWriter &json);
+
+	/**
+	 * Writes the calibration parameters
+	 *
+	 * \param json JSON formatter
+	 */
+	void writeCalibration_(LedJsonWriter &json);
+};
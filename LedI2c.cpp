@@ -0,0 +1,87 @@
+#include "LedI2c.h"
+
+#ifdef ARDUINO
+
+LedWireBus::LedWireBus(TwoWire &wire) {
+	wire_ = &wire;
+}
+
+bool LedWireBus::write(const uint8_t address, const uint8_t *data, const uint16_t length) {
+	wire_->beginTransmission(address);
+	wire_->write(data, length);
+	return wire_->endTransmission() == 0;
+}
+
+uint16_t LedWireBus::getMaxLength() {
+#ifdef BUFFER_LENGTH
+	return BUFFER_LENGTH;
+#else
+	return 32;
+#endif
+}
+
+#else
+
+#include <string.h>
+
+LedMockI2cBus::LedMockI2cBus(const uint16_t maxLength) {
+	maxLength_ = maxLength;
+}
+
+bool LedMockI2cBus::write(const uint8_t address, const uint8_t *data, const uint16_t length) {
+	if (length == 0 || length > maxLength_) return false;
+	Device *device = device_(address);
+	if (device == nullptr) return false;
+
+	// Address byte and data bytes
+	++transactionCount_;
+	byteCount_ += 1 + length;
+
+	// First byte selects the register, the rest are written with auto-increment
+	uint8_t reg = data[0];
+	for (uint16_t i = 1; i < length; ++i) {
+		device->registers[reg++] = data[i];
+	}
+	return true;
+}
+
+uint16_t LedMockI2cBus::getMaxLength() {
+	return maxLength_;
+}
+
+uint8_t LedMockI2cBus::getRegister(const uint8_t address, const uint8_t reg) {
+	for (uint8_t i = 0; i < deviceCount_; ++i) {
+		if (devices_[i].address == address) {
+			return devices_[i].registers[reg];
+		}
+	}
+	return 0;
+}
+
+uint32_t LedMockI2cBus::getTransactionCount() {
+	return transactionCount_;
+}
+
+uint32_t LedMockI2cBus::getByteCount() {
+	return byteCount_;
+}
+
+void LedMockI2cBus::resetCounters() {
+	transactionCount_ = 0;
+	byteCount_ = 0;
+}
+
+LedMockI2cBus::Device *LedMockI2cBus::device_(const uint8_t address) {
+	for (uint8_t i = 0; i < deviceCount_; ++i) {
+		if (devices_[i].address == address) {
+			return &devices_[i];
+		}
+	}
+	if (deviceCount_ == MAX_DEVICES) return nullptr;
+	Device *device = &devices_[deviceCount_++];
+	device->address = address;
+	memset(device->registers, 0, sizeof(device->registers));
+	return device;
+}
+
+#endif
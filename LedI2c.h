@@ -0,0 +1,154 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * I2C bus used by external PWM controller backends
+ */
+class LedI2cBus {
+public:
+	virtual ~LedI2cBus() {}
+
+	/**
+	 * Writes bytes to a device in a single transaction
+	 *
+	 * \param address 7-bit device address
+	 * \param data Bytes to write, the first one is usually the register address
+	 * \param length Number of bytes, at most getMaxLength()
+	 * \return Was the transaction acknowledged
+	 */
+	virtual bool write(const uint8_t address, const uint8_t *data, const uint16_t length) = 0;
+
+	/**
+	 * Get maximum number of bytes in a single transaction
+	 *
+	 * \return Maximum transaction length
+	 */
+	virtual uint16_t getMaxLength() = 0;
+};
+
+#ifdef ARDUINO
+
+#include <Wire.h>
+
+/**
+ * I2C bus using the Arduino Wire library
+ */
+class LedWireBus : public LedI2cBus {
+public:
+	/**
+	 * Constructor
+	 *
+	 * \param wire Wire instance, must be initialized with begin() by the caller
+	 */
+	LedWireBus(TwoWire &wire = Wire);
+
+	bool write(const uint8_t address, const uint8_t *data, const uint16_t length) override;
+
+	uint16_t getMaxLength() override;
+
+private:
+	/**
+	 * Wire instance
+	 */
+	TwoWire *wire_;
+};
+
+#else
+
+/**
+ * In-memory I2C bus for host builds
+ *
+ * Emulates devices with 256 auto-incrementing 8-bit registers and counts transactions and bytes, so that output
+ * backends can be verified and benchmarked without hardware.
+ */
+class LedMockI2cBus : public LedI2cBus {
+public:
+	/**
+	 * Maximum number of emulated devices
+	 */
+	static const uint8_t MAX_DEVICES = 16;
+
+	/**
+	 * Constructor
+	 *
+	 * \param maxLength Maximum number of bytes in a single transaction, e.g. 32 to mimic AVR Wire buffer
+	 */
+	LedMockI2cBus(const uint16_t maxLength = 1024);
+
+	bool write(const uint8_t address, const uint8_t *data, const uint16_t length) override;
+
+	uint16_t getMaxLength() override;
+
+	/**
+	 * Get register value of an emulated device
+	 *
+	 * \param address 7-bit device address
+	 * \param reg Register address
+	 * \return Last value written to the register, zero if never written
+	 */
+	uint8_t getRegister(const uint8_t address, const uint8_t reg);
+
+	/**
+	 * Get number of transactions since construction or reset
+	 *
+	 * \return Number of transactions
+	 */
+	uint32_t getTransactionCount();
+
+	/**
+	 * Get number of bytes written since construction or reset, including address bytes
+	 *
+	 * \return Number of bytes on the bus
+	 */
+	uint32_t getByteCount();
+
+	/**
+	 * Resets counters, register contents are kept
+	 */
+	void resetCounters();
+
+private:
+	/**
+	 * Emulated device
+	 */
+	struct Device {
+		uint8_t address;
+		uint8_t registers[256];
+	};
+
+	/**
+	 * Emulated devices
+	 */
+	Device devices_[MAX_DEVICES];
+
+	/**
+	 * Number of emulated devices
+	 */
+	uint8_t deviceCount_ = 0;
+
+	/**
+	 * Maximum number of bytes in a single transaction
+	 */
+	uint16_t maxLength_;
+
+	/**
+	 * Number of transactions
+	 */
+	uint32_t transactionCount_ = 0;
+
+	/**
+	 * Number of bytes including address bytes
+	 */
+	uint32_t byteCount_ = 0;
+
+	/**
+	 * Finds emulated device, adds it if not found
+	 *
+	 * \param address 7-bit device address
+	 * \return Device or null if there is no room for more devices
+	 */
+	Device *device_(const uint8_t address);
+};
+
+#endif
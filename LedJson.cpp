@@ -0,0 +1,305 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LedJson.h"
+
+/**
+ * Powers of ten for fixed decimals
+ */
+static const uint32_t POW10[10] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+LedJsonWriter::LedJsonWriter(LedWriter &writer) {
+	writer_ = &writer;
+}
+
+void LedJsonWriter::raw(const char *text) {
+	while (*text) put_(*text++);
+}
+
+void LedJsonWriter::beginObject() {
+	separate_();
+	put_('{');
+	comma_ = false;
+}
+
+void LedJsonWriter::endObject() {
+	put_('}');
+	comma_ = true;
+}
+
+void LedJsonWriter::beginArray() {
+	separate_();
+	put_('[');
+	comma_ = false;
+}
+
+void LedJsonWriter::endArray() {
+	put_(']');
+	comma_ = true;
+}
+
+void LedJsonWriter::key(const char *name) {
+	separate_();
+	put_('"');
+	raw(name);
+	put_('"');
+	put_(':');
+	comma_ = false;
+}
+
+void LedJsonWriter::number(const float x, const uint8_t decimals) {
+	// Infinity minus infinity is NaN too
+	double y = x;
+	if (!(y - y == 0) || y >= 4294967295.0 || y <= -4294967295.0) {
+		null();
+		return;
+	}
+	separate_();
+	uint8_t n = decimals < 9 ? decimals : 9;
+	bool negative = y < 0;
+	if (negative) y = -y;
+
+	// Integer and rounded fraction, rounding may carry over to the integer
+	uint32_t integer = static_cast<uint32_t>(y);
+	uint32_t fraction = static_cast<uint32_t>((y - integer) * POW10[n] + 0.5);
+	if (fraction >= POW10[n]) {
+		++integer;
+		fraction -= POW10[n];
+	}
+
+	// Values which round to zero are written without sign
+	if (negative && (integer > 0 || fraction > 0)) put_('-');
+	digits_(integer, 1);
+	if (n > 0) {
+		put_('.');
+		digits_(fraction, n);
+	}
+	comma_ = true;
+}
+
+void LedJsonWriter::integer(const int32_t x) {
+	separate_();
+	if (x < 0) put_('-');
+	digits_(x < 0 ? 0u - static_cast<uint32_t>(x) : static_cast<uint32_t>(x), 1);
+	comma_ = true;
+}
+
+void LedJsonWriter::boolean(const bool x) {
+	separate_();
+	raw(x ? "true" : "false");
+	comma_ = true;
+}
+
+void LedJsonWriter::null() {
+	separate_();
+	raw("null");
+	comma_ = true;
+}
+
+void LedJsonWriter::string(const char *text) {
+	separate_();
+	put_('"');
+	raw(text);
+	put_('"');
+	comma_ = true;
+}
+
+void LedJsonWriter::flush() {
+	if (length_ == 0) return;
+	writer_->write(buffer_, length_);
+	length_ = 0;
+}
+
+void LedJsonWriter::put_(const char c) {
+	buffer_[length_++] = static_cast<uint8_t>(c);
+	if (length_ == BUFFER_SIZE) flush();
+}
+
+void LedJsonWriter::separate_() {
+	if (comma_) put_(',');
+}
+
+void LedJsonWriter::digits_(uint32_t x, const uint8_t digits) {
+	char reversed[10];
+	uint8_t n = 0;
+	do {
+		reversed[n++] = static_cast<char>('0' + x % 10);
+		x /= 10;
+	} while (x > 0 || n < digits);
+	while (n > 0) put_(reversed[--n]);
+}
+
+void LedJsonParser::reset() {
+	state_ = State::Value;
+	escape_ = false;
+	hasValue_ = false;
+	depth_ = 0;
+	arrays_ = 0;
+	key_[0] = 0;
+	keyLength_ = 0;
+	scalarLength_ = 0;
+}
+
+bool LedJsonParser::feed(const char c) {
+	hasValue_ = false;
+	bool space = c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	switch (state_) {
+	case State::Value:
+		return space || startValue_(c);
+	case State::Member:
+		if (space) return true;
+		if (c == '"') {
+			keyLength_ = 0;
+			state_ = State::Key;
+			return true;
+		}
+		if (c == '}') return close_(c);
+		break;
+	case State::Key:
+		if (escape_ || c == '\\') {
+			escape_ = !escape_;
+			if (escape_) return true;
+		}
+		else if (c == '"') {
+			// Too long names match nothing
+			key_[keyLength_ <= KEY_SIZE ? keyLength_ : 0] = 0;
+			state_ = State::Colon;
+			return true;
+		}
+		if (keyLength_ < KEY_SIZE) key_[keyLength_] = c;
+		if (keyLength_ <= KEY_SIZE) ++keyLength_;
+		return true;
+	case State::Colon:
+		if (space) return true;
+		if (c == ':') {
+			state_ = State::Value;
+			return true;
+		}
+		break;
+	case State::String:
+		if (escape_) escape_ = false;
+		else if (c == '\\') escape_ = true;
+		else if (c == '"') finishValue_();
+		return true;
+	case State::Scalar:
+		if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '.' || c == '+' || c == '-') {
+			if (scalarLength_ >= sizeof(scalar_) - 1) break;
+			scalar_[scalarLength_++] = c;
+			return true;
+		}
+		if (!finishScalar_()) break;
+		{
+			// Delimiter after the scalar belongs to the enclosing container
+			bool completed = hasValue_;
+			bool valid = feed(c);
+			hasValue_ = completed;
+			return valid;
+		}
+	case State::Next:
+		if (space) return true;
+		if (c == ',') {
+			state_ = inArray_() ? State::Value : State::Member;
+			return true;
+		}
+		if (c == '}' || c == ']') return close_(c);
+		break;
+	case State::Done:
+		if (space) return true;
+		break;
+	case State::Error:
+		return false;
+	}
+	state_ = State::Error;
+	return false;
+}
+
+bool LedJsonParser::hasValue() {
+	return hasValue_;
+}
+
+const char *LedJsonParser::getKey() {
+	return key_;
+}
+
+float LedJsonParser::getValue() {
+	return value_;
+}
+
+uint8_t LedJsonParser::getDepth() {
+	return valueDepth_;
+}
+
+bool LedJsonParser::isComplete() {
+	return state_ == State::Done;
+}
+
+bool LedJsonParser::startValue_(const char c) {
+	if (c == '{' || c == '[') {
+		if (depth_ >= MAX_DEPTH) {
+			state_ = State::Error;
+			return false;
+		}
+		if (c == '[') arrays_ |= 1 << depth_;
+		++depth_;
+		state_ = c == '{' ? State::Member : State::Value;
+		return true;
+	}
+	if (c == '"') {
+		escape_ = false;
+		state_ = State::String;
+		return true;
+	}
+	if ((c >= '0' && c <= '9') || c == '-' || c == 't' || c == 'f' || c == 'n') {
+		scalar_[0] = c;
+		scalarLength_ = 1;
+		state_ = State::Scalar;
+		return true;
+	}
+
+	// Empty array
+	if (c == ']' && inArray_()) return close_(c);
+	state_ = State::Error;
+	return false;
+}
+
+bool LedJsonParser::finishScalar_() {
+	scalar_[scalarLength_] = 0;
+	float value;
+	if (strcmp(scalar_, "true") == 0) value = 1;
+	else if (strcmp(scalar_, "false") == 0) value = 0;
+	else if (strcmp(scalar_, "null") == 0) value = NAN;
+	else {
+		char *end;
+		double number = strtod(scalar_, &end);
+		if (end != scalar_ + scalarLength_) return false;
+		value = number > 3.4e38 ? INFINITY : (number < -3.4e38 ? -INFINITY : static_cast<float>(number));
+	}
+
+	// Only members of objects have names
+	if (depth_ > 0 && !inArray_()) {
+		value_ = value;
+		valueDepth_ = depth_;
+		hasValue_ = true;
+	}
+	finishValue_();
+	return true;
+}
+
+void LedJsonParser::finishValue_() {
+	state_ = depth_ > 0 ? State::Next : State::Done;
+}
+
+bool LedJsonParser::close_(const char c) {
+	if (depth_ == 0 || (c == ']') != inArray_()) {
+		state_ = State::Error;
+		return false;
+	}
+	--depth_;
+	arrays_ &= ~(1 << depth_);
+	finishValue_();
+	return true;
+}
+
+bool LedJsonParser::inArray_() {
+	return depth_ > 0 && (arrays_ >> (depth_ - 1)) & 1;
+}
@@ -0,0 +1,376 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Destination of response bytes, e.g. a socket or an HTTP response stream of a web server library
+ */
+class LedWriter {
+public:
+	virtual ~LedWriter() {}
+
+	/**
+	 * Writes bytes
+	 *
+	 * \param data Bytes to write
+	 * \param length Number of bytes
+	 */
+	virtual void write(const uint8_t *data, const uint16_t length) = 0;
+};
+
+/**
+ * Formats JSON into a fixed buffer which is handed to a writer whenever it fills up
+ *
+ * Numbers are formatted with a fixed number of decimals without printf, non-finite numbers are written as null.
+ * Commas between members and elements are inserted automatically.
+ *
+ *     LedJsonWriter json(writer);
+ *     json.beginObject();
+ *     json.key("L");
+ *     json.number(50.0f, 2);
+ *     json.endObject();
+ *     json.flush();
+ */
+class LedJsonWriter {
+public:
+	/**
+	 * Buffer size in bytes
+	 */
+	static const uint8_t BUFFER_SIZE = 128;
+
+	/**
+	 * Constructor
+	 *
+	 * \param writer Destination of the formatted bytes
+	 */
+	LedJsonWriter(LedWriter &writer);
+
+	/**
+	 * Writes text as such, e.g. HTTP headers before the JSON
+	 *
+	 * \param text Null terminated text
+	 */
+	void raw(const char *text);
+
+	/**
+	 * Starts an object
+	 */
+	void beginObject();
+
+	/**
+	 * Ends an object
+	 */
+	void endObject();
+
+	/**
+	 * Starts an array
+	 */
+	void beginArray();
+
+	/**
+	 * Ends an array
+	 */
+	void endArray();
+
+	/**
+	 * Writes a member name, the value follows
+	 *
+	 * \param name Member name, must not need escaping
+	 */
+	void key(const char *name);
+
+	/**
+	 * Writes a number
+	 *
+	 * \param x Value
+	 * \param decimals Number of decimals, at most 9
+	 */
+	void number(const float x, const uint8_t decimals);
+
+	/**
+	 * Writes an integer
+	 *
+	 * \param x Value
+	 */
+	void integer(const int32_t x);
+
+	/**
+	 * Writes a boolean
+	 *
+	 * \param x Value
+	 */
+	void boolean(const bool x);
+
+	/**
+	 * Writes null
+	 */
+	void null();
+
+	/**
+	 * Writes a string
+	 *
+	 * \param text Null terminated text, must not need escaping
+	 */
+	void string(const char *text);
+
+	/**
+	 * Hands buffered bytes to the writer
+	 */
+	void flush();
+
+private:
+	/**
+	 * Destination of the formatted bytes
+	 */
+	LedWriter *writer_;
+
+	/**
+	 * Formatted bytes not yet handed to the writer
+	 */
+	uint8_t buffer_[BUFFER_SIZE];
+
+	/**
+	 * Number of buffered bytes
+	 */
+	uint8_t length_ = 0;
+
+	/**
+	 * Does the next value or member need a comma before it?
+	 */
+	bool comma_ = false;
+
+	/**
+	 * Buffers a byte
+	 *
+	 * \param c Byte
+	 */
+	void put_(const char c);
+
+	/**
+	 * Writes a comma if a value or member precedes
+	 */
+	void separate_();
+
+	/**
+	 * Writes digits of an unsigned integer
+	 *
+	 * \param x Value
+	 * \param digits Minimum number of digits, padded with leading zeros
+	 */
+	void digits_(uint32_t x, const uint8_t digits);
+};
+
+/**
+ * Streaming JSON parser with fixed buffers
+ *
+ * Bytes are fed one at a time as they arrive, so a document never needs to be held in memory. After each byte the
+ * caller checks whether a scalar member of an object was completed and reads its name and value. Members of nested
+ * objects are reported with their own names, values in arrays and string values are skipped.
+ *
+ *     parser.reset();
+ *     for (uint16_t i = 0; i < length; ++i) {
+ *         if (!parser.feed(body[i])) break;
+ *         if (parser.hasValue()) apply(parser.getKey(), parser.getValue());
+ *     }
+ */
+class LedJsonParser {
+public:
+	/**
+	 * Longest member name, longer names are reported as empty
+	 */
+	static const uint8_t KEY_SIZE = 16;
+
+	/**
+	 * Deepest nesting of objects and arrays
+	 */
+	static const uint8_t MAX_DEPTH = 8;
+
+	/**
+	 * Prepares for a new document
+	 */
+	void reset();
+
+	/**
+	 * Parses a byte
+	 *
+	 * \param c Byte
+	 * \return Is the document valid so far
+	 */
+	bool feed(const char c);
+
+	/**
+	 * Did the latest byte complete a scalar member of an object?
+	 *
+	 * \return Is a member value available
+	 */
+	bool hasValue();
+
+	/**
+	 * Get name of the completed member
+	 *
+	 * \return Null terminated member name
+	 */
+	const char *getKey();
+
+	/**
+	 * Get value of the completed member
+	 *
+	 * \return Number, 1 for true and 0 for false, NaN for null
+	 */
+	float getValue();
+
+	/**
+	 * Get nesting depth of the completed member
+	 *
+	 * \return 1 for members of the top level object, more for members of nested objects
+	 */
+	uint8_t getDepth();
+
+	/**
+	 * Has the whole document been parsed?
+	 *
+	 * \return Is the top level value complete
+	 */
+	bool isComplete();
+
+private:
+	/**
+	 * Parser states
+	 */
+	enum class State : uint8_t {
+		/**
+		 * Expecting a value
+		 */
+		Value,
+
+		/**
+		 * Expecting a member name or the end of an object
+		 */
+		Member,
+
+		/**
+		 * Within a member name
+		 */
+		Key,
+
+		/**
+		 * Expecting the colon after a member name
+		 */
+		Colon,
+
+		/**
+		 * Within a string value
+		 */
+		String,
+
+		/**
+		 * Within a number or literal
+		 */
+		Scalar,
+
+		/**
+		 * Expecting a comma or the end of a container
+		 */
+		Next,
+
+		/**
+		 * Top level value is complete
+		 */
+		Done,
+
+		/**
+		 * Syntax error
+		 */
+		Error
+	};
+
+	/**
+	 * Current state
+	 */
+	State state_ = State::Value;
+
+	/**
+	 * Was the previous byte a backslash within a string?
+	 */
+	bool escape_ = false;
+
+	/**
+	 * Did the latest byte complete a member value?
+	 */
+	bool hasValue_ = false;
+
+	/**
+	 * Number of open objects and arrays
+	 */
+	uint8_t depth_ = 0;
+
+	/**
+	 * Bit mask of open containers which are arrays, bit i for depth i + 1
+	 */
+	uint8_t arrays_ = 0;
+
+	/**
+	 * Member name
+	 */
+	char key_[KEY_SIZE + 1] = {};
+
+	/**
+	 * Length of the member name, more than KEY_SIZE if it was too long
+	 */
+	uint8_t keyLength_ = 0;
+
+	/**
+	 * Characters of a number or literal
+	 */
+	char scalar_[24];
+
+	/**
+	 * Number of characters in the scalar buffer
+	 */
+	uint8_t scalarLength_ = 0;
+
+	/**
+	 * Value of the completed member
+	 */
+	float value_ = 0;
+
+	/**
+	 * Nesting depth of the completed member
+	 */
+	uint8_t valueDepth_ = 0;
+
+	/**
+	 * Starts a value
+	 *
+	 * \param c First byte of the value
+	 * \return Is the byte valid
+	 */
+	bool startValue_(const char c);
+
+	/**
+	 * Finishes a number or literal
+	 *
+	 * \return Was the scalar valid
+	 */
+	bool finishScalar_();
+
+	/**
+	 * Handles the end of a value
+	 */
+	void finishValue_();
+
+	/**
+	 * Closes an object or array
+	 *
+	 * \param c Closing byte
+	 * \return Did it match the open container
+	 */
+	bool close_(const char c);
+
+	/**
+	 * Is the innermost open container an array?
+	 *
+	 * \return Is within an array
+	 */
+	bool inArray_();
+};
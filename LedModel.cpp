@@ -0,0 +1,253 @@
+#include <math.h>
+#include "LedModel.h"
+
+/**
+ * Solver coefficients for the default calibration, generated at compile time
+ */
+static constexpr LedSolver DEFAULT_SOLVER = LedSolver::fromCalibration(LedCalibration::defaults());
+
+/**
+ * Planckian locus table, generated at compile time
+ */
+static constexpr LedLocus::Table LOCUS_TABLE = LedLocus::generate();
+
+/**
+ * Lightness to luma table, generated at compile time
+ */
+static constexpr LedLightness::Table LIGHTNESS_TABLE = LedLightness::generate();
+
+/**
+ * Maximum lightness grid for the default calibration, generated at compile time
+ */
+static constexpr LedLightnessGrid<LED_LIGHTNESS_GRID> DEFAULT_LIGHTNESS_GRID =
+	LedLightnessGrid<LED_LIGHTNESS_GRID>::generate(LedCalibration::defaults(), DEFAULT_SOLVER);
+
+/**
+ * Model for the default calibration, generated at compile time, the only copy of its solver and grid at runtime
+ */
+static constexpr LedModel DEFAULT_MODEL(LedCalibration::defaults(), DEFAULT_SOLVER, DEFAULT_LIGHTNESS_GRID);
+
+double LedSolverChannel::level(const double u, const double v) const {
+	double q = (radicand[0] * u + radicand[2] * v + radicand[3]) * u + (radicand[1] * v + radicand[4]) * v + radicand[5];
+	return level_(distance(linear[0] * u + linear[1] * v + linear[2], root * (q > 0 ? sqrt(q) : 0.0),
+		denominator[0] * u + denominator[1] * v + denominator[2],
+		conjugate[0] * u + conjugate[1] * v + conjugate[2]));
+}
+
+LedUvNode LedSolver::node(const double u, const double v) const {
+	return node_(positive_(red.level(u, v)), positive_(green.level(u, v)), positive_(blue.level(u, v)));
+}
+
+const LedSolver &LedSolver::defaults() {
+	return DEFAULT_MODEL.getSolver();
+}
+
+LedLocusPoint LedLocus::fromMired(const float mired) {
+
+	// Clamp into the tabulated range
+	float x = (mired - MIRED_MIN) / MIRED_STEP;
+	if (x < 0) x = 0;
+	if (x > SIZE - 1) x = SIZE - 1;
+
+	// Interpolate between adjacent entries
+	uint16_t i = x < SIZE - 1 ? static_cast<uint16_t>(x) : SIZE - 2;
+	float t = x - i;
+	const LedLocusPoint &p0 = LOCUS_TABLE.points[i];
+	const LedLocusPoint &p1 = LOCUS_TABLE.points[i + 1];
+	LedLocusPoint p = { p0.u + (p1.u - p0.u) * t, p0.v + (p1.v - p0.v) * t };
+	return p;
+}
+
+LedLocusPoint LedLocus::fromMired(const float mired, const float duv) {
+
+	// Clamp into the tabulated range
+	float x = (mired - MIRED_MIN) / MIRED_STEP;
+	if (x < 0) x = 0;
+	if (x > SIZE - 1) x = SIZE - 1;
+
+	// Interpolate point and normal between adjacent entries and offset the point along the normal
+	uint16_t i = x < SIZE - 1 ? static_cast<uint16_t>(x) : SIZE - 2;
+	float t = x - i;
+	const LedLocusPoint &p0 = LOCUS_TABLE.points[i];
+	const LedLocusPoint &p1 = LOCUS_TABLE.points[i + 1];
+	const LedLocusPoint &n0 = LOCUS_TABLE.normals[i];
+	const LedLocusPoint &n1 = LOCUS_TABLE.normals[i + 1];
+	LedLocusPoint p = {
+		p0.u + (p1.u - p0.u) * t + (n0.u + (n1.u - n0.u) * t) * duv,
+		p0.v + (p1.v - p0.v) * t + (n0.v + (n1.v - n0.v) * t) * duv
+	};
+	return p;
+}
+
+/**
+ * Signed distances of a CIE 1960 UCS point from an isotemperature line, along the locus and along the normal
+ */
+static void isotemperatureDistance(const uint16_t i, const float u, const float v, float &along, float &duv) {
+	const LedLocusPoint &p = LOCUS_TABLE.points[i];
+	const LedLocusPoint &n = LOCUS_TABLE.normals[i];
+
+	// Table is in u', v' units, CIE 1960 v is two thirds of v'
+	float du = u - p.u;
+	float dv = v - p.v * (2.0f / 3.0f);
+	float nu = n.u;
+	float nv = n.v * (2.0f / 3.0f);
+
+	// Tangent points towards warmer temperatures
+	along = du * nv - dv * nu;
+	duv = du * nu + dv * nv;
+}
+
+LedTemperature LedLocus::toTemperature(const float u, const float v) {
+
+	// CIE 1960 UCS
+	float v60 = v * (2.0f / 3.0f);
+
+	// Distance along the locus decreases with table index, find the pair of lines the point is between. End lines
+	// are only looked at when the point is beyond them, the locus fit bends sharply at the cool end and its first
+	// isotemperature lines are not reliable far from the locus.
+	uint16_t lo = 0;
+	uint16_t hi = SIZE - 1;
+	while (hi - lo > 1) {
+		uint16_t mid = (lo + hi) / 2;
+		float along;
+		float duv;
+		isotemperatureDistance(mid, u, v60, along, duv);
+		if (along > 0) {
+			lo = mid;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	float along0;
+	float along1;
+	float duv0;
+	float duv1;
+	isotemperatureDistance(lo, u, v60, along0, duv0);
+	isotemperatureDistance(hi, u, v60, along1, duv1);
+
+	// Clamp to the tabulated range
+	LedTemperature temperature;
+	if (along0 <= 0) {
+		temperature.mired = MIRED_MIN + lo * MIRED_STEP;
+		temperature.duv = duv0;
+		return temperature;
+	}
+	if (along1 >= 0) {
+		temperature.mired = MIRED_MIN + hi * MIRED_STEP;
+		temperature.duv = duv1;
+		return temperature;
+	}
+
+	// Interpolate between the two isotemperature lines
+	float t = along0 / (along0 - along1);
+	temperature.mired = MIRED_MIN + (lo + t) * MIRED_STEP;
+	temperature.duv = duv0 + (duv1 - duv0) * t;
+	return temperature;
+}
+
+LedLocusPoint LedLocus::fromKelvin(const float T) {
+	if (T <= 0) return fromMired(MIRED_MAX);
+	return fromMired(1000000.0 / T);
+}
+
+uint16_t LedLightness::toLuma(const float L) {
+
+	// Clamp into the tabulated range
+	float x = L * ((SIZE - 1) / 100.0f);
+	if (!(x > 0)) return 0;
+	if (x >= SIZE - 1) return LIGHTNESS_TABLE.luma[SIZE - 1];
+
+	// Interpolate between adjacent entries
+	uint16_t i = static_cast<uint16_t>(x);
+	float t = x - i;
+	uint16_t y0 = LIGHTNESS_TABLE.luma[i];
+	uint16_t y1 = LIGHTNESS_TABLE.luma[i + 1];
+	return y0 + static_cast<uint16_t>((y1 - y0) * t + 0.5f);
+}
+
+float LedLightness::fromLuma(const uint16_t Y) {
+	if (Y >= LIGHTNESS_TABLE.luma[SIZE - 1]) return 100;
+
+	// Find entries around the luma, the table is increasing
+	uint16_t lo = 0;
+	uint16_t hi = SIZE - 1;
+	while (hi - lo > 1) {
+		uint16_t mid = (lo + hi) / 2;
+		if (LIGHTNESS_TABLE.luma[mid] <= Y) {
+			lo = mid;
+		}
+		else {
+			hi = mid;
+		}
+	}
+
+	// Interpolate between the entries
+	uint16_t y0 = LIGHTNESS_TABLE.luma[lo];
+	uint16_t y1 = LIGHTNESS_TABLE.luma[hi];
+	float t = static_cast<float>(Y - y0) / (y1 - y0);
+	return (lo + t) * (100.0f / (SIZE - 1));
+}
+
+LedModel::LedModel(const LedCalibration &calibration)
+	: LedModel(calibration, LedSolver::fromCalibration(calibration)) {
+}
+
+LedModel::LedModel(const LedCalibration &calibration, const LedSolver &solver)
+	: calibration_(calibration), solver_(solver),
+	lightnessGrid_(LedLightnessGrid<LED_LIGHTNESS_GRID>::build(calibration, solver)) {
+}
+
+const LedModel &LedModel::defaults() {
+	return DEFAULT_MODEL;
+}
+
+LedModelRef::LedModelRef(const LedModel &model) {
+	model_ = &model;
+}
+
+LedModelRef::LedModelRef(const LedModelRef &other) {
+	model_ = other.model_;
+	acquire_();
+}
+
+LedModelRef &LedModelRef::operator=(const LedModelRef &other) {
+	if (model_ != other.model_) {
+		release_();
+		model_ = other.model_;
+		acquire_();
+	}
+	return *this;
+}
+
+LedModelRef::~LedModelRef() {
+	release_();
+}
+
+LedModelRef LedModelRef::make(const LedCalibration &calibration, const LedSolver &solver) {
+	LedModel *model = new LedModel(calibration, solver);
+	LedModelRef ref(*model);
+	model->references_ = 1;
+	return ref;
+}
+
+void LedModelRef::acquire_() {
+	// Count of an allocated model stays positive while this reference holds it, caller owned models stay at zero
+#ifdef LED_MODEL_ATOMIC
+	if (model_->references_.load(std::memory_order_relaxed) > 0) {
+		model_->references_.fetch_add(1, std::memory_order_relaxed);
+	}
+#else
+	if (model_->references_ > 0) ++model_->references_;
+#endif
+}
+
+void LedModelRef::release_() {
+	// References in other threads may go away at the same time, the last one deletes
+#ifdef LED_MODEL_ATOMIC
+	if (model_->references_.load(std::memory_order_relaxed) > 0
+		&& model_->references_.fetch_sub(1, std::memory_order_acq_rel) == 1) delete model_;
+#else
+	if (model_->references_ > 0 && --model_->references_ == 0) delete model_;
+#endif
+}
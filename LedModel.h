@@ -0,0 +1,1087 @@
+#pragma once
+
+#include <stdint.h>
+
+#if !defined(ARDUINO) || defined(ESP32)
+#include <atomic>
+#define LED_MODEL_ATOMIC 1
+#endif
+
+/**
+ * Data structure for CIE 1976 Luv coordinates
+ */
+struct Luv {
+	float L;
+	float u;
+	float v;
+};
+
+/**
+ * Data structure for RGB color
+ */
+struct RGB {
+	float R;
+	float G;
+	float B;
+};
+
+/**
+ * Calibration parameters of a fixture model
+ *
+ * Plain aggregate so that a fixture model can be declared as a constexpr constant and everything derived from it can
+ * be generated at compile time.
+ */
+struct LedCalibration {
+	/**
+	 * CIE 1976 UCS coordinates for red LED
+	 */
+	Luv redUv;
+
+	/**
+	 * CIE 1976 UCS coordinates for green LED
+	 */
+	Luv greenUv;
+
+	/**
+	 * CIE 1976 UCS coordinates for blue LED
+	 */
+	Luv blueUv;
+
+	/**
+	 * Luminous flux for red LED
+	 */
+	float redLum;
+
+	/**
+	 * Luminous flux for green LED
+	 */
+	float greenLum;
+
+	/**
+	 * Luminous flux for blue LED
+	 */
+	float blueLum;
+
+	/**
+	 * Rational function coefficients for red LED level vs normalized red-to-green distance
+	 */
+	float redToGreenFit[3];
+
+	/**
+	 * Rational function coefficients for green LED level vs normalized green-to-blue distance
+	 */
+	float greenToBlueFit[3];
+
+	/**
+	 * Rational function coefficients for blue LED level vs normalized blue-to-red distance
+	 */
+	float blueToRedFit[3];
+
+	/**
+	 * Default calibration
+	 *
+	 * \return Calibration used by LedEngine until calibrate is called
+	 */
+	static constexpr LedCalibration defaults() {
+		return LedCalibration{
+			{ 100, 0.5535, 0.5170 }, { 100, 0.0373, 0.5856 }, { 100, 0.1679, 0.1153 },
+			0.5, 1.0, 0.75,
+			{ 2.9658, 0.0, 1.9658 }, { 1.3587, 0.0, 0.3587 }, { -0.2121, 0.2121, 0.2121 }
+		};
+	}
+};
+
+/**
+ * Precomputed solver coefficients for a single LED
+ *
+ * Level of an LED is a rational function of normalized distance x, which is a root of a quadratic equation whose
+ * coefficients depend on the target u', v' only linearly. Everything that depends on calibration alone is folded in
+ * here so that
+ *
+ *     x = offset + (linear(u', v') + root * sqrt(radicand(u', v'))) / denominator(u', v')
+ *     level = (fit[0] * x + fit[1]) / (x + fit[2])
+ *
+ * where radicand is a second order and linear and denominator are first order polynomials of u' and v'. When linear
+ * and the square root term have opposite signs the same root is computed as
+ *
+ *     x = offset + conjugate(u', v') / (linear(u', v') - root * sqrt(radicand(u', v')))
+ *
+ * where conjugate = (linear^2 - radicand) / denominator is a first order polynomial as well. This form does not
+ * subtract nearly equal numbers and stays finite where the denominator vanishes.
+ */
+struct LedSolverChannel {
+	/**
+	 * Radicand coefficients for u'u', v'v', u'v', u', v' and constant terms
+	 */
+	double radicand[6];
+
+	/**
+	 * Linear term coefficients for u', v' and constant terms
+	 */
+	double linear[3];
+
+	/**
+	 * Denominator coefficients for u', v' and constant terms
+	 */
+	double denominator[3];
+
+	/**
+	 * Conjugate form numerator coefficients for u', v' and constant terms
+	 */
+	double conjugate[3];
+
+	/**
+	 * Sign of the square root term, selects the root of the quadratic equation
+	 */
+	double root;
+
+	/**
+	 * Constant offset added to the normalized distance
+	 */
+	double offset;
+
+	/**
+	 * Rational function coefficients for LED level vs normalized distance
+	 */
+	float fit[3];
+
+	/**
+	 * Solves LED level at compile time
+	 *
+	 * Runtime code should use level which uses libm square root instead of the Newton iteration used here.
+	 *
+	 * \param u Target u' coordinate
+	 * \param v Target v' coordinate
+	 * \return LED level, negative radicand is treated as zero
+	 */
+	constexpr double levelAt(const double u, const double v) const {
+		return level_(distance(linear[0] * u + linear[1] * v + linear[2],
+			root * sqrt_((radicand[0] * u + radicand[2] * v + radicand[3]) * u + (radicand[1] * v + radicand[4]) * v + radicand[5]),
+			denominator[0] * u + denominator[1] * v + denominator[2],
+			conjugate[0] * u + conjugate[1] * v + conjugate[2]));
+	}
+
+	/**
+	 * Solves LED level at runtime, same as levelAt
+	 *
+	 * \param u Target u' coordinate
+	 * \param v Target v' coordinate
+	 * \return LED level, negative radicand is treated as zero
+	 */
+	double level(const double u, const double v) const;
+
+	/**
+	 * Computes solver coefficients for an LED
+	 *
+	 * \param P0 CIE 1976 UCS coordinates for the source LED whose level is to be searched, e.g. redUv
+	 * \param P1 CIE 1976 UCS coordinates for the next LED counter-clockwise, e.g. greenUv
+	 * \param P2 CIE 1976 UCS coordinates for the last RGB LED, e.g. blueUv
+	 * \param rightHandFit Rational function coefficients for source LED level vs normalized right hand side distance
+	 * \param leftHandFit Rational function coefficients for normalized left hand side distance vs normalized right hand side distance
+	 * \return Solver coefficients
+	 */
+	static constexpr LedSolverChannel fromCalibration(const Luv P0, const Luv P1, const Luv P2, const float *rightHandFit, const float *leftHandFit) {
+		return withConjugate_(fromCalibration_(P0, P1, P2, rightHandFit, leftHandFit, leftHandFit[0] < 0, rightHandFit[0] >= 0 ? -1.0 : 1.0));
+	}
+
+	/**
+	 * Computes normalized distance from the polynomial values with the numerically stable form of the root
+	 *
+	 * Degenerate cases, where both numerator and denominator vanish, e.g. at the LED's own primary, fall back to the
+	 * closed form limit. Result is limited in the range 0..1 which spans the gamut, so the level never hits the pole
+	 * of the rational fit function and the result is never NaN.
+	 *
+	 * \param l Value of the linear polynomial
+	 * \param r Signed square root of the radicand, radicand must be clamped to non-negative
+	 * \param d Value of the denominator polynomial
+	 * \param c Value of the conjugate polynomial
+	 * \return Normalized distance
+	 */
+	constexpr double distance(const double l, const double r, const double d, const double c) const {
+		return clamp_(offset + ((l < 0) != (r < 0)
+			? (l - r != 0 ? c / (l - r) : 1 - offset)
+			: (d != 0 ? (l + r) / d : (l + r != 0 ? (l + r > 0 ? 1.0 : -1.0) : 1 - offset))));
+	}
+
+	/**
+	 * Refines normalized distance of a target close to the previous one with simplified Newton iterations
+	 *
+	 * Normalized distance x = offset + y solves d * y^2 - 2 * l * y + c = 0 and the closed form selects the root where
+	 * d * y - l has the sign of root. Two steps start from the previous solution and share the derivative at it, so
+	 * they need a single division and no square root. The result is accepted only when the steps converge to the
+	 * selected root within the gamut.
+	 *
+	 * \param l Value of the linear polynomial
+	 * \param d Value of the denominator polynomial
+	 * \param c Value of the conjugate polynomial
+	 * \param x Normalized distance of the previous target, replaced with the refined one on success
+	 * \return Did the steps converge, the closed form must be used if not
+	 */
+	bool refine(const double l, const double d, const double c, double &x) const {
+		if (!(x >= 0)) return false;
+		double y = x - offset;
+		double slope = d * y - l;
+		if (!(slope * root > 0)) return false;
+		double gain = 0.5 / slope;
+		double first = ((d * y - 2 * l) * y + c) * gain;
+		y -= first;
+		double second = ((d * y - 2 * l) * y + c) * gain;
+		y -= second;
+
+		// Derivative changed by 2 * d * first since the first step, which bounds the error left after the second.
+		// The other root has the derivative of opposite sign. Negated comparisons also reject NaN.
+		double refined = offset + y;
+		if (!(abs_(second) < 1e-3) || !(abs_(2 * d * gain * first * second) < 1e-6)
+			|| !((d * y - l) * root > 0) || !(refined >= 0 && refined <= 1)) return false;
+		x = refined;
+		return true;
+	}
+
+private:
+	static constexpr LedSolverChannel fromCalibration_(const Luv P0, const Luv P1, const Luv P2, const float *R, const float *L, const bool low, const double sign) {
+		return LedSolverChannel{
+			{
+				(radicandAt_(low, 1, 0, P0, P1, P2, L) + radicandAt_(low, -1, 0, P0, P1, P2, L)) / 2 - radicandAt_(low, 0, 0, P0, P1, P2, L),
+				(radicandAt_(low, 0, 1, P0, P1, P2, L) + radicandAt_(low, 0, -1, P0, P1, P2, L)) / 2 - radicandAt_(low, 0, 0, P0, P1, P2, L),
+				radicandAt_(low, 1, 1, P0, P1, P2, L) - radicandAt_(low, 1, 0, P0, P1, P2, L) - radicandAt_(low, 0, 1, P0, P1, P2, L) + radicandAt_(low, 0, 0, P0, P1, P2, L),
+				(radicandAt_(low, 1, 0, P0, P1, P2, L) - radicandAt_(low, -1, 0, P0, P1, P2, L)) / 2,
+				(radicandAt_(low, 0, 1, P0, P1, P2, L) - radicandAt_(low, 0, -1, P0, P1, P2, L)) / 2,
+				radicandAt_(low, 0, 0, P0, P1, P2, L)
+			},
+			{
+				sign * (linearAt_(low, 1, 0, P0, P1, P2, L) - linearAt_(low, 0, 0, P0, P1, P2, L)),
+				sign * (linearAt_(low, 0, 1, P0, P1, P2, L) - linearAt_(low, 0, 0, P0, P1, P2, L)),
+				sign * linearAt_(low, 0, 0, P0, P1, P2, L)
+			},
+			{
+				denominatorAt_(1, 0, P0, P1, P2, L) - denominatorAt_(0, 0, P0, P1, P2, L),
+				denominatorAt_(0, 1, P0, P1, P2, L) - denominatorAt_(0, 0, P0, P1, P2, L),
+				denominatorAt_(0, 0, P0, P1, P2, L)
+			},
+			{ 0, 0, 0 },
+			sign * (low ? 1.0 : -1.0),
+			// Right hand fits with a positive first coefficient are functions of 1 - x instead of x
+			sign < 0 ? (low ? 1.0 : 0.0) : (low ? 0.0 : 1.0),
+			{ R[0], R[1], R[2] }
+		};
+	}
+
+	static constexpr double radicandAt_(const bool low, const double PTu, const double PTv, const Luv P0, const Luv P1, const Luv P2, const float *L) {
+		return radicand_(low, PTu, PTv, P0.u, P0.v, P1.u, P1.v, P2.u, P2.v, L[0], L[1], L[2]) / 4;
+	}
+
+	static constexpr double linearAt_(const bool low, const double PTu, const double PTv, const Luv P0, const Luv P1, const Luv P2, const float *L) {
+		return linear_(low, PTu, PTv, P0.u, P0.v, P1.u, P1.v, P2.u, P2.v, L[0], L[1], L[2]);
+	}
+
+	static constexpr double denominatorAt_(const double PTu, const double PTv, const Luv P0, const Luv P1, const Luv P2, const float *L) {
+		return denominator_(PTu, PTv, P0.u, P0.v, P1.u, P1.v, P2.u, P2.v, L[0]);
+	}
+
+	static constexpr double radicand_(const bool low, const double PTu, const double PTv, const double P0u, const double P0v, const double P1u, const double P1v, const double P2u, const double P2v, const double Lp1, const double Lp2, const double Lq1) {
+		return low
+			? ((P0u*P0u)*(P1v*P1v) + (P1u*P1u)*(P0v*P0v) + (P0u*P0u)*(PTv*PTv) + (P0v*P0v)*(PTu*PTu) + (P1u*P1u)*(PTv*PTv) + (P1v*P1v)*(PTu*PTu) - Lp1*(P0u*P0u)*(P1v*P1v)*2.0 - Lp1*(P1u*P1u)*(P0v*P0v)*2.0 - Lp2*(P0u*P0u)*(P1v*P1v)*2.0 - Lp2*(P1u*P1u)*(P0v*P0v)*2.0 + Lq1*(P0u*P0u)*(P1v*P1v)*2.0 + Lq1*(P1u*P1u)*(P0v*P0v)*2.0 - Lp1*(P0u*P0u)*(PTv*PTv)*2.0 - Lp1*(P0v*P0v)*(PTu*PTu)*2.0 - Lp2*(P0u*P0u)*(PTv*PTv)*4.0 - Lp2*(P0v*P0v)*(PTu*PTu)*4.0 + Lq1*(P0u*P0u)*(PTv*PTv)*2.0 + Lq1*(P0v*P0v)*(PTu*PTu)*2.0 + Lq1*(P1u*P1u)*(PTv*PTv)*2.0 + Lq1*(P1v*P1v)*(PTu*PTu)*2.0 + (Lp1*Lp1)*(P0u*P0u)*(P1v*P1v) + (Lp1*Lp1)*(P1u*P1u)*(P0v*P0v) + (Lp2*Lp2)*(P0u*P0u)*(P1v*P1v) + (Lp2*Lp2)*(P1u*P1u)*(P0v*P0v) + (Lp1*Lp1)*(P1u*P1u)*(P2v*P2v) + (Lp1*Lp1)*(P2u*P2u)*(P1v*P1v) + (Lp2*Lp2)*(P0u*P0u)*(P2v*P2v) + (Lp2*Lp2)*(P2u*P2u)*(P0v*P0v) + (Lp2*Lp2)*(P1u*P1u)*(P2v*P2v) + (Lp2*Lp2)*(P2u*P2u)*(P1v*P1v) + (Lq1*Lq1)*(P0u*P0u)*(P1v*P1v) + (Lq1*Lq1)*(P1u*P1u)*(P0v*P0v) + (Lp1*Lp1)*(P0u*P0u)*(PTv*PTv) + (Lp1*Lp1)*(P0v*P0v)*(PTu*PTu) + (Lp1*Lp1)*(P2u*P2u)*(PTv*PTv) + (Lp1*Lp1)*(P2v*P2v)*(PTu*PTu) + (Lq1*Lq1)*(P0u*P0u)*(PTv*PTv) + (Lq1*Lq1)*(P0v*P0v)*(PTu*PTu) + (Lq1*Lq1)*(P1u*P1u)*(PTv*PTv) + (Lq1*Lq1)*(P1v*P1v)*(PTu*PTu) - P0u*P1u*(PTv*PTv)*2.0 - P0u*(P1v*P1v)*PTu*2.0 - P1u*(P0v*P0v)*PTu*2.0 - P0v*P1v*(PTu*PTu)*2.0 - (P0u*P0u)*P1v*PTv*2.0 - (P1u*P1u)*P0v*PTv*2.0 + Lp1*Lp2*(P0u*P0u)*(P1v*P1v)*2.0 + Lp1*Lp2*(P1u*P1u)*(P0v*P0v)*2.0 + Lp1*Lp2*(P1u*P1u)*(P2v*P2v)*2.0 + Lp1*Lp2*(P2u*P2u)*(P1v*P1v)*2.0 - Lp1*Lq1*(P0u*P0u)*(P1v*P1v)*2.0 - Lp1*Lq1*(P1u*P1u)*(P0v*P0v)*2.0 - Lp2*Lq1*(P0u*P0u)*(P1v*P1v)*2.0 - Lp2*Lq1*(P1u*P1u)*(P0v*P0v)*2.0 + Lp1*Lq1*(P0u*P0u)*(PTv*PTv)*2.0 + Lp1*Lq1*(P0v*P0v)*(PTu*PTu)*2.0 - (Lp1*Lp1)*P0u*P2u*(P1v*P1v)*2.0 - (Lp2*Lp2)*P0u*P1u*(P2v*P2v)*2.0 - (Lp2*Lp2)*P0u*P2u*(P1v*P1v)*2.0 - (Lp2*Lp2)*P1u*P2u*(P0v*P0v)*2.0 - (Lp1*Lp1)*(P1u*P1u)*P0v*P2v*2.0 - (Lp2*Lp2)*(P0u*P0u)*P1v*P2v*2.0 - (Lp2*Lp2)*(P1u*P1u)*P0v*P2v*2.0 - (Lp2*Lp2)*(P2u*P2u)*P0v*P1v*2.0 - (Lp1*Lp1)*P1u*(P0v*P0v)*PTu*2.0 - (Lp1*Lp1)*P0u*P2u*(PTv*PTv)*2.0 - (Lp1*Lp1)*P1u*(P2v*P2v)*PTu*2.0 - (Lp1*Lp1)*(P0u*P0u)*P1v*PTv*2.0 - (Lp1*Lp1)*P0v*P2v*(PTu*PTu)*2.0 - (Lp1*Lp1)*(P2u*P2u)*P1v*PTv*2.0 - (Lq1*Lq1)*P0u*P1u*(PTv*PTv)*2.0 - (Lq1*Lq1)*P0u*(P1v*P1v)*PTu*2.0 - (Lq1*Lq1)*P1u*(P0v*P0v)*PTu*2.0 - (Lq1*Lq1)*P0v*P1v*(PTu*PTu)*2.0 - (Lq1*Lq1)*(P0u*P0u)*P1v*PTv*2.0 - (Lq1*Lq1)*(P1u*P1u)*P0v*PTv*2.0 - P0u*P1u*P0v*P1v*2.0 + P0u*P1u*P0v*PTv*2.0 + P0u*P0v*P1v*PTu*2.0 + P0u*P1u*P1v*PTv*2.0 + P1u*P0v*P1v*PTu*2.0 - P0u*P0v*PTu*PTv*2.0 + P0u*P1v*PTu*PTv*2.0 + P1u*P0v*PTu*PTv*2.0 - P1u*P1v*PTu*PTv*2.0 + Lp1*P0u*P2u*(P1v*P1v)*2.0 + Lp2*P0u*P2u*(P1v*P1v)*2.0 - Lp2*P1u*P2u*(P0v*P0v)*2.0 + Lp1*(P1u*P1u)*P0v*P2v*2.0 - Lp2*(P0u*P0u)*P1v*P2v*2.0 + Lp2*(P1u*P1u)*P0v*P2v*2.0 + Lp1*P0u*P1u*(PTv*PTv)*2.0 + Lp1*P0u*(P1v*P1v)*PTu*2.0 + Lp1*P1u*(P0v*P0v)*PTu*4.0 + Lp1*P0u*P2u*(PTv*PTv)*2.0 + Lp2*P0u*P1u*(PTv*PTv)*4.0 + Lp2*P0u*(P1v*P1v)*PTu*2.0 + Lp2*P1u*(P0v*P0v)*PTu*6.0 - Lp1*P1u*P2u*(PTv*PTv)*2.0 - Lp1*P2u*(P1v*P1v)*PTu*2.0 + Lp2*P0u*P2u*(PTv*PTv)*4.0 + Lp2*P2u*(P0v*P0v)*PTu*2.0 - Lp2*P1u*P2u*(PTv*PTv)*4.0 - Lp2*P2u*(P1v*P1v)*PTu*2.0 + Lp1*P0v*P1v*(PTu*PTu)*2.0 + Lp1*(P0u*P0u)*P1v*PTv*4.0 + Lp1*(P1u*P1u)*P0v*PTv*2.0 + Lp1*P0v*P2v*(PTu*PTu)*2.0 + Lp2*P0v*P1v*(PTu*PTu)*4.0 + Lp2*(P0u*P0u)*P1v*PTv*6.0 + Lp2*(P1u*P1u)*P0v*PTv*2.0 - Lp1*P1v*P2v*(PTu*PTu)*2.0 - Lp1*(P1u*P1u)*P2v*PTv*2.0 + Lp2*P0v*P2v*(PTu*PTu)*4.0 + Lp2*(P0u*P0u)*P2v*PTv*2.0 - Lp2*P1v*P2v*(PTu*PTu)*4.0 - Lp2*(P1u*P1u)*P2v*PTv*2.0 - Lq1*P0u*P1u*(PTv*PTv)*4.0 - Lq1*P0u*(P1v*P1v)*PTu*4.0 - Lq1*P1u*(P0v*P0v)*PTu*4.0 - Lq1*P0v*P1v*(PTu*PTu)*4.0 - Lq1*(P0u*P0u)*P1v*PTv*4.0 - Lq1*(P1u*P1u)*P0v*PTv*4.0 - Lp1*Lp2*P0u*P1u*(P2v*P2v)*2.0 - Lp1*Lp2*P0u*P2u*(P1v*P1v)*4.0 - Lp1*Lp2*P1u*P2u*(P0v*P0v)*2.0 - Lp1*Lp2*(P0u*P0u)*P1v*P2v*2.0 - Lp1*Lp2*(P1u*P1u)*P0v*P2v*4.0 - Lp1*Lp2*(P2u*P2u)*P0v*P1v*2.0 + Lp1*Lq1*P0u*P2u*(P1v*P1v)*2.0 + Lp1*Lq1*P1u*P2u*(P0v*P0v)*4.0 + Lp2*Lq1*P0u*P2u*(P1v*P1v)*2.0 + Lp2*Lq1*P1u*P2u*(P0v*P0v)*2.0 + Lp1*Lq1*(P0u*P0u)*P1v*P2v*4.0 + Lp1*Lq1*(P1u*P1u)*P0v*P2v*2.0 + Lp2*Lq1*(P0u*P0u)*P1v*P2v*2.0 + Lp2*Lq1*(P1u*P1u)*P0v*P2v*2.0 - Lp1*Lp2*P1u*(P0v*P0v)*PTu*2.0 + Lp1*Lp2*P0u*(P2v*P2v)*PTu*2.0 + Lp1*Lp2*P2u*(P0v*P0v)*PTu*2.0 - Lp1*Lp2*P1u*(P2v*P2v)*PTu*2.0 - Lp1*Lp2*(P0u*P0u)*P1v*PTv*2.0 + Lp1*Lp2*(P0u*P0u)*P2v*PTv*2.0 + Lp1*Lp2*(P2u*P2u)*P0v*PTv*2.0 - Lp1*Lp2*(P2u*P2u)*P1v*PTv*2.0 - Lp1*Lq1*P0u*P1u*(PTv*PTv)*2.0 + Lp1*Lq1*P0u*(P1v*P1v)*PTu*2.0 - Lp1*Lq1*P0u*P2u*(PTv*PTv)*2.0 - Lp1*Lq1*P2u*(P0v*P0v)*PTu*4.0 + Lp2*Lq1*P0u*(P1v*P1v)*PTu*2.0 + Lp2*Lq1*P1u*(P0v*P0v)*PTu*2.0 + Lp1*Lq1*P1u*P2u*(PTv*PTv)*2.0 - Lp1*Lq1*P2u*(P1v*P1v)*PTu*2.0 - Lp2*Lq1*P2u*(P0v*P0v)*PTu*2.0 - Lp2*Lq1*P2u*(P1v*P1v)*PTu*2.0 - Lp1*Lq1*P0v*P1v*(PTu*PTu)*2.0 + Lp1*Lq1*(P1u*P1u)*P0v*PTv*2.0 - Lp1*Lq1*P0v*P2v*(PTu*PTu)*2.0 - Lp1*Lq1*(P0u*P0u)*P2v*PTv*4.0 + Lp2*Lq1*(P0u*P0u)*P1v*PTv*2.0 + Lp2*Lq1*(P1u*P1u)*P0v*PTv*2.0 + Lp1*Lq1*P1v*P2v*(PTu*PTu)*2.0 - Lp1*Lq1*(P1u*P1u)*P2v*PTv*2.0 - Lp2*Lq1*(P0u*P0u)*P2v*PTv*2.0 - Lp2*Lq1*(P1u*P1u)*P2v*PTv*2.0 - (Lp1*Lp1)*P0u*P1u*P0v*P1v*2.0 - (Lp2*Lp2)*P0u*P1u*P0v*P1v*2.0 + (Lp1*Lp1)*P0u*P1u*P1v*P2v*2.0 + (Lp1*Lp1)*P1u*P2u*P0v*P1v*2.0 + (Lp2*Lp2)*P0u*P1u*P0v*P2v*2.0 + (Lp2*Lp2)*P0u*P2u*P0v*P1v*2.0 + (Lp2*Lp2)*P0u*P1u*P1v*P2v*2.0 - (Lp2*Lp2)*P0u*P2u*P0v*P2v*2.0 + (Lp2*Lp2)*P1u*P2u*P0v*P1v*2.0 - (Lp1*Lp1)*P1u*P2u*P1v*P2v*2.0 + (Lp2*Lp2)*P0u*P2u*P1v*P2v*2.0 + (Lp2*Lp2)*P1u*P2u*P0v*P2v*2.0 - (Lp2*Lp2)*P1u*P2u*P1v*P2v*2.0 - (Lq1*Lq1)*P0u*P1u*P0v*P1v*2.0 + (Lp1*Lp1)*P0u*P1u*P0v*PTv*2.0 + (Lp1*Lp1)*P0u*P0v*P1v*PTu*2.0 - (Lp1*Lp1)*P0u*P1u*P2v*PTv*2.0 + (Lp1*Lp1)*P0u*P2u*P1v*PTv*4.0 - (Lp1*Lp1)*P0u*P1v*P2v*PTu*2.0 - (Lp1*Lp1)*P1u*P2u*P0v*PTv*2.0 + (Lp1*Lp1)*P1u*P0v*P2v*PTu*4.0 - (Lp1*Lp1)*P2u*P0v*P1v*PTu*2.0 + (Lp1*Lp1)*P1u*P2u*P2v*PTv*2.0 + (Lp1*Lp1)*P2u*P1v*P2v*PTu*2.0 + (Lq1*Lq1)*P0u*P1u*P0v*PTv*2.0 + (Lq1*Lq1)*P0u*P0v*P1v*PTu*2.0 + (Lq1*Lq1)*P0u*P1u*P1v*PTv*2.0 + (Lq1*Lq1)*P1u*P0v*P1v*PTu*2.0 - (Lp1*Lp1)*P0u*P0v*PTu*PTv*2.0 + (Lp1*Lp1)*P0u*P2v*PTu*PTv*2.0 + (Lp1*Lp1)*P2u*P0v*PTu*PTv*2.0 - (Lp1*Lp1)*P2u*P2v*PTu*PTv*2.0 - (Lq1*Lq1)*P0u*P0v*PTu*PTv*2.0 + (Lq1*Lq1)*P0u*P1v*PTu*PTv*2.0 + (Lq1*Lq1)*P1u*P0v*PTu*PTv*2.0 - (Lq1*Lq1)*P1u*P1v*PTu*PTv*2.0 + Lp1*P0u*P1u*P0v*P1v*4.0 + Lp2*P0u*P1u*P0v*P1v*4.0 - Lp1*P0u*P1u*P1v*P2v*2.0 - Lp1*P1u*P2u*P0v*P1v*2.0 + Lp2*P0u*P1u*P0v*P2v*2.0 + Lp2*P0u*P2u*P0v*P1v*2.0 - Lp2*P0u*P1u*P1v*P2v*2.0 - Lp2*P1u*P2u*P0v*P1v*2.0 - Lq1*P0u*P1u*P0v*P1v*4.0 - Lp1*P0u*P1u*P0v*PTv*4.0 - Lp1*P0u*P0v*P1v*PTu*4.0 - Lp1*P0u*P1u*P1v*PTv*2.0 - Lp1*P1u*P0v*P1v*PTu*2.0 - Lp2*P0u*P1u*P0v*PTv*6.0 - Lp2*P0u*P0v*P1v*PTu*6.0 + Lp1*P0u*P1u*P2v*PTv*2.0 - Lp1*P0u*P2u*P1v*PTv*4.0 + Lp1*P0u*P1v*P2v*PTu*2.0 + Lp1*P1u*P2u*P0v*PTv*2.0 - Lp1*P1u*P0v*P2v*PTu*4.0 + Lp1*P2u*P0v*P1v*PTu*2.0 - Lp2*P0u*P1u*P1v*PTv*2.0 - Lp2*P0u*P2u*P0v*PTv*2.0 - Lp2*P0u*P0v*P2v*PTu*2.0 - Lp2*P1u*P0v*P1v*PTu*2.0 + Lp1*P1u*P2u*P1v*PTv*2.0 + Lp1*P1u*P1v*P2v*PTu*2.0 - Lp2*P0u*P2u*P1v*PTv*6.0 + Lp2*P0u*P1v*P2v*PTu*6.0 + Lp2*P1u*P2u*P0v*PTv*6.0 - Lp2*P1u*P0v*P2v*PTu*6.0 + Lp2*P1u*P2u*P1v*PTv*2.0 + Lp2*P1u*P1v*P2v*PTu*2.0 + Lq1*P0u*P1u*P0v*PTv*4.0 + Lq1*P0u*P0v*P1v*PTu*4.0 + Lq1*P0u*P1u*P1v*PTv*4.0 + Lq1*P1u*P0v*P1v*PTu*4.0 + Lp1*P0u*P0v*PTu*PTv*4.0 - Lp1*P0u*P1v*PTu*PTv*2.0 - Lp1*P1u*P0v*PTu*PTv*2.0 + Lp2*P0u*P0v*PTu*PTv*8.0 - Lp1*P0u*P2v*PTu*PTv*2.0 - Lp1*P2u*P0v*PTu*PTv*2.0 - Lp2*P0u*P1v*PTu*PTv*4.0 - Lp2*P1u*P0v*PTu*PTv*4.0 + Lp1*P1u*P2v*PTu*PTv*2.0 + Lp1*P2u*P1v*PTu*PTv*2.0 - Lp2*P0u*P2v*PTu*PTv*4.0 - Lp2*P2u*P0v*PTu*PTv*4.0 + Lp2*P1u*P2v*PTu*PTv*4.0 + Lp2*P2u*P1v*PTu*PTv*4.0 - Lq1*P0u*P0v*PTu*PTv*4.0 + Lq1*P0u*P1v*PTu*PTv*4.0 + Lq1*P1u*P0v*PTu*PTv*4.0 - Lq1*P1u*P1v*PTu*PTv*4.0 - Lp1*Lp2*P0u*P1u*P0v*P1v*4.0 + Lp1*Lp2*P0u*P1u*P0v*P2v*2.0 + Lp1*Lp2*P0u*P2u*P0v*P1v*2.0 + Lp1*Lp2*P0u*P1u*P1v*P2v*4.0 + Lp1*Lp2*P1u*P2u*P0v*P1v*4.0 + Lp1*Lp2*P0u*P2u*P1v*P2v*2.0 + Lp1*Lp2*P1u*P2u*P0v*P2v*2.0 - Lp1*Lp2*P1u*P2u*P1v*P2v*4.0 + Lp1*Lq1*P0u*P1u*P0v*P1v*4.0 - Lp1*Lq1*P0u*P1u*P0v*P2v*4.0 - Lp1*Lq1*P0u*P2u*P0v*P1v*4.0 + Lp2*Lq1*P0u*P1u*P0v*P1v*4.0 - Lp1*Lq1*P0u*P1u*P1v*P2v*2.0 - Lp1*Lq1*P1u*P2u*P0v*P1v*2.0 - Lp2*Lq1*P0u*P1u*P0v*P2v*2.0 - Lp2*Lq1*P0u*P2u*P0v*P1v*2.0 - Lp2*Lq1*P0u*P1u*P1v*P2v*2.0 - Lp2*Lq1*P1u*P2u*P0v*P1v*2.0 + Lp1*Lp2*P0u*P1u*P0v*PTv*2.0 + Lp1*Lp2*P0u*P0v*P1v*PTu*2.0 - Lp1*Lp2*P0u*P2u*P0v*PTv*2.0 - Lp1*Lp2*P0u*P0v*P2v*PTu*2.0 - Lp1*Lp2*P0u*P1u*P2v*PTv*2.0 + Lp1*Lp2*P0u*P2u*P1v*PTv*4.0 - Lp1*Lp2*P0u*P1v*P2v*PTu*2.0 - Lp1*Lp2*P1u*P2u*P0v*PTv*2.0 + Lp1*Lp2*P1u*P0v*P2v*PTu*4.0 - Lp1*Lp2*P2u*P0v*P1v*PTu*2.0 - Lp1*Lp2*P0u*P2u*P2v*PTv*2.0 - Lp1*Lp2*P2u*P0v*P2v*PTu*2.0 + Lp1*Lp2*P1u*P2u*P2v*PTv*2.0 + Lp1*Lp2*P2u*P1v*P2v*PTu*2.0 - Lp1*Lq1*P0u*P1u*P1v*PTv*2.0 + Lp1*Lq1*P0u*P2u*P0v*PTv*4.0 + Lp1*Lq1*P0u*P0v*P2v*PTu*4.0 - Lp1*Lq1*P1u*P0v*P1v*PTu*2.0 - Lp2*Lq1*P0u*P1u*P0v*PTv*2.0 - Lp2*Lq1*P0u*P0v*P1v*PTu*2.0 + Lp1*Lq1*P0u*P1u*P2v*PTv*6.0 - Lp1*Lq1*P0u*P1v*P2v*PTu*6.0 - Lp1*Lq1*P1u*P2u*P0v*PTv*6.0 + Lp1*Lq1*P2u*P0v*P1v*PTu*6.0 - Lp2*Lq1*P0u*P1u*P1v*PTv*2.0 + Lp2*Lq1*P0u*P2u*P0v*PTv*2.0 + Lp2*Lq1*P0u*P0v*P2v*PTu*2.0 - Lp2*Lq1*P1u*P0v*P1v*PTu*2.0 + Lp1*Lq1*P1u*P2u*P1v*PTv*2.0 + Lp1*Lq1*P1u*P1v*P2v*PTu*2.0 + Lp2*Lq1*P0u*P1u*P2v*PTv*4.0 - Lp2*Lq1*P0u*P2u*P1v*PTv*2.0 - Lp2*Lq1*P0u*P1v*P2v*PTu*2.0 - Lp2*Lq1*P1u*P2u*P0v*PTv*2.0 - Lp2*Lq1*P1u*P0v*P2v*PTu*2.0 + Lp2*Lq1*P2u*P0v*P1v*PTu*4.0 + Lp2*Lq1*P1u*P2u*P1v*PTv*2.0 + Lp2*Lq1*P1u*P1v*P2v*PTu*2.0 - Lp1*Lq1*P0u*P0v*PTu*PTv*4.0 + Lp1*Lq1*P0u*P1v*PTu*PTv*2.0 + Lp1*Lq1*P1u*P0v*PTu*PTv*2.0 + Lp1*Lq1*P0u*P2v*PTu*PTv*2.0 + Lp1*Lq1*P2u*P0v*PTu*PTv*2.0 - Lp1*Lq1*P1u*P2v*PTu*PTv*2.0 - Lp1*Lq1*P2u*P1v*PTu*PTv*2.0)
+			: (Lp1*Lp1*P0u*P0u*P2v*P2v - 2 * Lp1*Lp1*P0u*P0u*P2v*PTv + Lp1*Lp1*P0u*P0u*PTv*PTv - 2 * Lp1*Lp1*P0u*P2u*P0v*P2v + 2 * Lp1*Lp1*P0u*P2u*P0v*PTv + 2 * Lp1*Lp1*P0u*P2u*P2v*PTv - 2 * Lp1*Lp1*P0u*P2u*PTv*PTv + 2 * Lp1*Lp1*P0u*P0v*P2v*PTu - 2 * Lp1*Lp1*P0u*P0v*PTu*PTv - 2 * Lp1*Lp1*P0u*P2v*P2v*PTu + 2 * Lp1*Lp1*P0u*P2v*PTu*PTv + Lp1*Lp1*P2u*P2u*P0v*P0v - 2 * Lp1*Lp1*P2u*P2u*P0v*PTv + Lp1*Lp1*P2u*P2u*PTv*PTv - 2 * Lp1*Lp1*P2u*P0v*P0v*PTu + 2 * Lp1*Lp1*P2u*P0v*P2v*PTu + 2 * Lp1*Lp1*P2u*P0v*PTu*PTv - 2 * Lp1*Lp1*P2u*P2v*PTu*PTv + Lp1*Lp1*P0v*P0v*PTu*PTu - 2 * Lp1*Lp1*P0v*P2v*PTu*PTu + Lp1*Lp1*P2v*P2v*PTu*PTu - 2 * Lp1*Lp2*P0u*P0u*P1v*P2v + 2 * Lp1*Lp2*P0u*P0u*P1v*PTv + 2 * Lp1*Lp2*P0u*P0u*P2v*P2v - 2 * Lp1*Lp2*P0u*P0u*P2v*PTv + 2 * Lp1*Lp2*P0u*P1u*P0v*P2v - 2 * Lp1*Lp2*P0u*P1u*P0v*PTv - 2 * Lp1*Lp2*P0u*P1u*P2v*P2v + 2 * Lp1*Lp2*P0u*P1u*P2v*PTv + 2 * Lp1*Lp2*P0u*P2u*P0v*P1v - 4 * Lp1*Lp2*P0u*P2u*P0v*P2v + 2 * Lp1*Lp2*P0u*P2u*P0v*PTv + 2 * Lp1*Lp2*P0u*P2u*P1v*P2v - 4 * Lp1*Lp2*P0u*P2u*P1v*PTv + 2 * Lp1*Lp2*P0u*P2u*P2v*PTv - 2 * Lp1*Lp2*P0u*P0v*P1v*PTu + 2 * Lp1*Lp2*P0u*P0v*P2v*PTu + 2 * Lp1*Lp2*P0u*P1v*P2v*PTu - 2 * Lp1*Lp2*P0u*P2v*P2v*PTu - 2 * Lp1*Lp2*P1u*P2u*P0v*P0v + 2 * Lp1*Lp2*P1u*P2u*P0v*P2v + 2 * Lp1*Lp2*P1u*P2u*P0v*PTv - 2 * Lp1*Lp2*P1u*P2u*P2v*PTv + 2 * Lp1*Lp2*P1u*P0v*P0v*PTu - 4 * Lp1*Lp2*P1u*P0v*P2v*PTu + 2 * Lp1*Lp2*P1u*P2v*P2v*PTu + 2 * Lp1*Lp2*P2u*P2u*P0v*P0v - 2 * Lp1*Lp2*P2u*P2u*P0v*P1v - 2 * Lp1*Lp2*P2u*P2u*P0v*PTv + 2 * Lp1*Lp2*P2u*P2u*P1v*PTv - 2 * Lp1*Lp2*P2u*P0v*P0v*PTu + 2 * Lp1*Lp2*P2u*P0v*P1v*PTu + 2 * Lp1*Lp2*P2u*P0v*P2v*PTu - 2 * Lp1*Lp2*P2u*P1v*P2v*PTu - 2 * Lp1*Lq1*P0u*P0u*P1v*P2v + 2 * Lp1*Lq1*P0u*P0u*P1v*PTv + 2 * Lp1*Lq1*P0u*P0u*P2v*PTv - 2 * Lp1*Lq1*P0u*P0u*PTv*PTv + 2 * Lp1*Lq1*P0u*P1u*P0v*P2v - 2 * Lp1*Lq1*P0u*P1u*P0v*PTv - 2 * Lp1*Lq1*P0u*P1u*P2v*PTv + 2 * Lp1*Lq1*P0u*P1u*PTv*PTv + 2 * Lp1*Lq1*P0u*P2u*P0v*P1v - 2 * Lp1*Lq1*P0u*P2u*P0v*PTv - 2 * Lp1*Lq1*P0u*P2u*P1v*PTv + 2 * Lp1*Lq1*P0u*P2u*PTv*PTv - 2 * Lp1*Lq1*P0u*P0v*P1v*PTu - 2 * Lp1*Lq1*P0u*P0v*P2v*PTu + 4 * Lp1*Lq1*P0u*P0v*PTu*PTv + 4 * Lp1*Lq1*P0u*P1v*P2v*PTu - 2 * Lp1*Lq1*P0u*P1v*PTu*PTv - 2 * Lp1*Lq1*P0u*P2v*PTu*PTv - 2 * Lp1*Lq1*P1u*P2u*P0v*P0v + 4 * Lp1*Lq1*P1u*P2u*P0v*PTv - 2 * Lp1*Lq1*P1u*P2u*PTv*PTv + 2 * Lp1*Lq1*P1u*P0v*P0v*PTu - 2 * Lp1*Lq1*P1u*P0v*P2v*PTu - 2 * Lp1*Lq1*P1u*P0v*PTu*PTv + 2 * Lp1*Lq1*P1u*P2v*PTu*PTv + 2 * Lp1*Lq1*P2u*P0v*P0v*PTu - 2 * Lp1*Lq1*P2u*P0v*P1v*PTu - 2 * Lp1*Lq1*P2u*P0v*PTu*PTv + 2 * Lp1*Lq1*P2u*P1v*PTu*PTv - 2 * Lp1*Lq1*P0v*P0v*PTu*PTu + 2 * Lp1*Lq1*P0v*P1v*PTu*PTu + 2 * Lp1*Lq1*P0v*P2v*PTu*PTu - 2 * Lp1*Lq1*P1v*P2v*PTu*PTu + Lp2*Lp2*P0u*P0u*P1v*P1v - 2 * Lp2*Lp2*P0u*P0u*P1v*P2v + Lp2*Lp2*P0u*P0u*P2v*P2v - 2 * Lp2*Lp2*P0u*P1u*P0v*P1v + 2 * Lp2*Lp2*P0u*P1u*P0v*P2v + 2 * Lp2*Lp2*P0u*P1u*P1v*P2v - 2 * Lp2*Lp2*P0u*P1u*P2v*P2v + 2 * Lp2*Lp2*P0u*P2u*P0v*P1v - 2 * Lp2*Lp2*P0u*P2u*P0v*P2v - 2 * Lp2*Lp2*P0u*P2u*P1v*P1v + 2 * Lp2*Lp2*P0u*P2u*P1v*P2v + Lp2*Lp2*P1u*P1u*P0v*P0v - 2 * Lp2*Lp2*P1u*P1u*P0v*P2v + Lp2*Lp2*P1u*P1u*P2v*P2v - 2 * Lp2*Lp2*P1u*P2u*P0v*P0v + 2 * Lp2*Lp2*P1u*P2u*P0v*P1v + 2 * Lp2*Lp2*P1u*P2u*P0v*P2v - 2 * Lp2*Lp2*P1u*P2u*P1v*P2v + Lp2*Lp2*P2u*P2u*P0v*P0v - 2 * Lp2*Lp2*P2u*P2u*P0v*P1v + Lp2*Lp2*P2u*P2u*P1v*P1v - 2 * Lp2*Lq1*P0u*P0u*P1v*P1v + 2 * Lp2*Lq1*P0u*P0u*P1v*P2v + 2 * Lp2*Lq1*P0u*P0u*P1v*PTv - 2 * Lp2*Lq1*P0u*P0u*P2v*PTv + 4 * Lp2*Lq1*P0u*P1u*P0v*P1v - 2 * Lp2*Lq1*P0u*P1u*P0v*P2v - 2 * Lp2*Lq1*P0u*P1u*P0v*PTv - 2 * Lp2*Lq1*P0u*P1u*P1v*P2v - 2 * Lp2*Lq1*P0u*P1u*P1v*PTv + 4 * Lp2*Lq1*P0u*P1u*P2v*PTv - 2 * Lp2*Lq1*P0u*P2u*P0v*P1v + 2 * Lp2*Lq1*P0u*P2u*P0v*PTv + 2 * Lp2*Lq1*P0u*P2u*P1v*P1v - 2 * Lp2*Lq1*P0u*P2u*P1v*PTv - 2 * Lp2*Lq1*P0u*P0v*P1v*PTu + 2 * Lp2*Lq1*P0u*P0v*P2v*PTu + 2 * Lp2*Lq1*P0u*P1v*P1v*PTu - 2 * Lp2*Lq1*P0u*P1v*P2v*PTu - 2 * Lp2*Lq1*P1u*P1u*P0v*P0v + 2 * Lp2*Lq1*P1u*P1u*P0v*P2v + 2 * Lp2*Lq1*P1u*P1u*P0v*PTv - 2 * Lp2*Lq1*P1u*P1u*P2v*PTv + 2 * Lp2*Lq1*P1u*P2u*P0v*P0v - 2 * Lp2*Lq1*P1u*P2u*P0v*P1v - 2 * Lp2*Lq1*P1u*P2u*P0v*PTv + 2 * Lp2*Lq1*P1u*P2u*P1v*PTv + 2 * Lp2*Lq1*P1u*P0v*P0v*PTu - 2 * Lp2*Lq1*P1u*P0v*P1v*PTu - 2 * Lp2*Lq1*P1u*P0v*P2v*PTu + 2 * Lp2*Lq1*P1u*P1v*P2v*PTu - 2 * Lp2*Lq1*P2u*P0v*P0v*PTu + 4 * Lp2*Lq1*P2u*P0v*P1v*PTu - 2 * Lp2*Lq1*P2u*P1v*P1v*PTu + 4 * Lp2*P0u*P0u*P1v*P2v - 4 * Lp2*P0u*P0u*P1v*PTv - 4 * Lp2*P0u*P0u*P2v*PTv + 4 * Lp2*P0u*P0u*PTv*PTv - 4 * Lp2*P0u*P1u*P0v*P2v + 4 * Lp2*P0u*P1u*P0v*PTv + 4 * Lp2*P0u*P1u*P2v*PTv - 4 * Lp2*P0u*P1u*PTv*PTv - 4 * Lp2*P0u*P2u*P0v*P1v + 4 * Lp2*P0u*P2u*P0v*PTv + 4 * Lp2*P0u*P2u*P1v*PTv - 4 * Lp2*P0u*P2u*PTv*PTv + 4 * Lp2*P0u*P0v*P1v*PTu + 4 * Lp2*P0u*P0v*P2v*PTu - 8 * Lp2*P0u*P0v*PTu*PTv - 8 * Lp2*P0u*P1v*P2v*PTu + 4 * Lp2*P0u*P1v*PTu*PTv + 4 * Lp2*P0u*P2v*PTu*PTv + 4 * Lp2*P1u*P2u*P0v*P0v - 8 * Lp2*P1u*P2u*P0v*PTv + 4 * Lp2*P1u*P2u*PTv*PTv - 4 * Lp2*P1u*P0v*P0v*PTu + 4 * Lp2*P1u*P0v*P2v*PTu + 4 * Lp2*P1u*P0v*PTu*PTv - 4 * Lp2*P1u*P2v*PTu*PTv - 4 * Lp2*P2u*P0v*P0v*PTu + 4 * Lp2*P2u*P0v*P1v*PTu + 4 * Lp2*P2u*P0v*PTu*PTv - 4 * Lp2*P2u*P1v*PTu*PTv + 4 * Lp2*P0v*P0v*PTu*PTu - 4 * Lp2*P0v*P1v*PTu*PTu - 4 * Lp2*P0v*P2v*PTu*PTu + 4 * Lp2*P1v*P2v*PTu*PTu + Lq1*Lq1*P0u*P0u*P1v*P1v - 2 * Lq1*Lq1*P0u*P0u*P1v*PTv + Lq1*Lq1*P0u*P0u*PTv*PTv - 2 * Lq1*Lq1*P0u*P1u*P0v*P1v + 2 * Lq1*Lq1*P0u*P1u*P0v*PTv + 2 * Lq1*Lq1*P0u*P1u*P1v*PTv - 2 * Lq1*Lq1*P0u*P1u*PTv*PTv + 2 * Lq1*Lq1*P0u*P0v*P1v*PTu - 2 * Lq1*Lq1*P0u*P0v*PTu*PTv - 2 * Lq1*Lq1*P0u*P1v*P1v*PTu + 2 * Lq1*Lq1*P0u*P1v*PTu*PTv + Lq1*Lq1*P1u*P1u*P0v*P0v - 2 * Lq1*Lq1*P1u*P1u*P0v*PTv + Lq1*Lq1*P1u*P1u*PTv*PTv - 2 * Lq1*Lq1*P1u*P0v*P0v*PTu + 2 * Lq1*Lq1*P1u*P0v*P1v*PTu + 2 * Lq1*Lq1*P1u*P0v*PTu*PTv - 2 * Lq1*Lq1*P1u*P1v*PTu*PTv + Lq1*Lq1*P0v*P0v*PTu*PTu - 2 * Lq1*Lq1*P0v*P1v*PTu*PTu + Lq1*Lq1*P1v*P1v*PTu*PTu);
+	}
+
+	static constexpr double linear_(const bool low, const double PTu, const double PTv, const double P0u, const double P0v, const double P1u, const double P1v, const double P2u, const double P2v, const double Lp1, const double Lp2, const double Lq1) {
+		return low
+			? (P0u*P1v*(1.0 / 2.0) - P1u*P0v*(1.0 / 2.0) - P0u*PTv*(1.0 / 2.0) + P0v*PTu*(1.0 / 2.0) + P1u*PTv*(1.0 / 2.0) - P1v*PTu*(1.0 / 2.0) - Lp1*P0u*P1v*(1.0 / 2.0) + Lp1*P1u*P0v*(1.0 / 2.0) + Lp1*P0u*P2v - Lp1*P2u*P0v - Lp2*P0u*P1v*(1.0 / 2.0) + Lp2*P1u*P0v*(1.0 / 2.0) - Lp1*P1u*P2v*(1.0 / 2.0) + Lp1*P2u*P1v*(1.0 / 2.0) + Lp2*P0u*P2v*(1.0 / 2.0) - Lp2*P2u*P0v*(1.0 / 2.0) - Lp2*P1u*P2v*(1.0 / 2.0) + Lp2*P2u*P1v*(1.0 / 2.0) + Lq1*P0u*P1v*(1.0 / 2.0) - Lq1*P1u*P0v*(1.0 / 2.0) - Lp1*P0u*PTv*(1.0 / 2.0) + Lp1*P0v*PTu*(1.0 / 2.0) + Lp1*P2u*PTv*(1.0 / 2.0) - Lp1*P2v*PTu*(1.0 / 2.0) - Lq1*P0u*PTv*(1.0 / 2.0) + Lq1*P0v*PTu*(1.0 / 2.0) + Lq1*P1u*PTv*(1.0 / 2.0) - Lq1*P1v*PTu*(1.0 / 2.0))
+			: -(2 * P0u*P1v - 2 * P1u*P0v - 2 * P0u*PTv + 2 * P0v*PTu + 2 * P1u*PTv - 2 * P1v*PTu - 2 * Lp1*P0u*P1v + 2 * Lp1*P1u*P0v + Lp1*P0u*P2v - Lp1*P2u*P0v - Lp2*P0u*P1v + Lp2*P1u*P0v - 2 * Lp1*P1u*P2v + 2 * Lp1*P2u*P1v + Lp2*P0u*P2v - Lp2*P2u*P0v - Lp2*P1u*P2v + Lp2*P2u*P1v + Lq1*P0u*P1v - Lq1*P1u*P0v + Lp1*P0u*PTv - Lp1*P0v*PTu - Lp1*P2u*PTv + Lp1*P2v*PTu - Lq1*P0u*PTv + Lq1*P0v*PTu + Lq1*P1u*PTv - Lq1*P1v*PTu) / 2;
+	}
+
+	static constexpr double denominator_(const double PTu, const double PTv, const double P0u, const double P0v, const double P1u, const double P1v, const double P2u, const double P2v, const double Lp1) {
+		return P0u*P1v - P1u*P0v - P0u*PTv + P0v*PTu + P1u*PTv - P1v*PTu - Lp1*P0u*P1v + Lp1*P1u*P0v + Lp1*P0u*P2v - Lp1*P2u*P0v - Lp1*P1u*P2v + Lp1*P2u*P1v;
+	}
+
+	/**
+	 * Fills in conjugate coefficients by dividing linear^2 - radicand by the denominator, pivoting on the largest
+	 * denominator coefficient
+	 */
+	static constexpr LedSolverChannel withConjugate_(const LedSolverChannel &c) {
+		return LedSolverChannel{
+			{ c.radicand[0], c.radicand[1], c.radicand[2], c.radicand[3], c.radicand[4], c.radicand[5] },
+			{ c.linear[0], c.linear[1], c.linear[2] },
+			{ c.denominator[0], c.denominator[1], c.denominator[2] },
+			{ chop_(c, conjugateU_(c, pivot_(c))), chop_(c, conjugateV_(c, pivot_(c))), chop_(c, conjugate0_(c, pivot_(c))) },
+			c.root,
+			c.offset,
+			{ c.fit[0], c.fit[1], c.fit[2] }
+		};
+	}
+
+	static constexpr uint8_t pivot_(const LedSolverChannel &c) {
+		return abs_(c.denominator[0]) >= abs_(c.denominator[1]) && abs_(c.denominator[0]) >= abs_(c.denominator[2])
+			? 0 : (abs_(c.denominator[1]) >= abs_(c.denominator[2]) ? 1 : 2);
+	}
+
+	// Coefficients of linear^2 - radicand for u'u', v'v', u'v', u', v' and constant terms
+	static constexpr double pUU_(const LedSolverChannel &c) { return c.linear[0] * c.linear[0] - c.radicand[0]; }
+	static constexpr double pVV_(const LedSolverChannel &c) { return c.linear[1] * c.linear[1] - c.radicand[1]; }
+	static constexpr double pUV_(const LedSolverChannel &c) { return 2 * c.linear[0] * c.linear[1] - c.radicand[2]; }
+	static constexpr double pU_(const LedSolverChannel &c) { return 2 * c.linear[0] * c.linear[2] - c.radicand[3]; }
+	static constexpr double pV_(const LedSolverChannel &c) { return 2 * c.linear[1] * c.linear[2] - c.radicand[4]; }
+	static constexpr double p1_(const LedSolverChannel &c) { return c.linear[2] * c.linear[2] - c.radicand[5]; }
+
+	static constexpr double conjugateU_(const LedSolverChannel &c, const uint8_t pivot) {
+		return pivot == 0 ? pUU_(c) / c.denominator[0]
+			: pivot == 1 ? (pUV_(c) - c.denominator[0] * (pVV_(c) / c.denominator[1])) / c.denominator[1]
+			: (pU_(c) - c.denominator[0] * (p1_(c) / c.denominator[2])) / c.denominator[2];
+	}
+
+	static constexpr double conjugateV_(const LedSolverChannel &c, const uint8_t pivot) {
+		return pivot == 0 ? (pUV_(c) - c.denominator[1] * (pUU_(c) / c.denominator[0])) / c.denominator[0]
+			: pivot == 1 ? pVV_(c) / c.denominator[1]
+			: (pV_(c) - c.denominator[1] * (p1_(c) / c.denominator[2])) / c.denominator[2];
+	}
+
+	static constexpr double conjugate0_(const LedSolverChannel &c, const uint8_t pivot) {
+		return pivot == 0 ? (pU_(c) - c.denominator[2] * (pUU_(c) / c.denominator[0])) / c.denominator[0]
+			: pivot == 1 ? (pV_(c) - c.denominator[2] * (pVV_(c) / c.denominator[1])) / c.denominator[1]
+			: p1_(c) / c.denominator[2];
+	}
+
+	/**
+	 * Zeroes a conjugate coefficient which is only rounding error
+	 *
+	 * Linear left hand fits make linear^2 equal to radicand, so the conjugate vanishes. Its rounding error divided by
+	 * the sum which vanishes at the LED's own primary would not.
+	 */
+	static constexpr double chop_(const LedSolverChannel &c, const double k) {
+		return abs_(k) * (abs_(c.denominator[0]) + abs_(c.denominator[1]) + abs_(c.denominator[2]))
+			< 1e-9 * (abs_(c.linear[0]) + abs_(c.linear[1]) + abs_(c.linear[2])) * (abs_(c.linear[0]) + abs_(c.linear[1]) + abs_(c.linear[2])) ? 0.0 : k;
+	}
+
+	static constexpr double abs_(const double x) {
+		return x < 0 ? -x : x;
+	}
+
+	static constexpr double clamp_(const double x) {
+		return x > 0 ? (x < 1 ? x : 1.0) : 0.0;
+	}
+
+	constexpr double level_(const double x) const {
+		return (fit[0] * x + fit[1]) / (x + fit[2]);
+	}
+
+	static constexpr double sqrt_(const double x) {
+		return x > 0 ? sqrtIterate_(x, x > 1 ? x : 1.0, 48) : 0.0;
+	}
+
+	static constexpr double sqrtIterate_(const double x, const double guess, const uint8_t n) {
+		return n == 0 ? guess : sqrtIterate_(x, (guess + x / guess) / 2, n - 1);
+	}
+};
+
+/**
+ * Solver output for a single u', v' grid node
+ */
+struct LedUvNode {
+	/**
+	 * Red LED level normalized so that the brightest LED is at full power
+	 */
+	float R;
+
+	/**
+	 * Green LED level normalized so that the brightest LED is at full power
+	 */
+	float G;
+
+	/**
+	 * Blue LED level normalized so that the brightest LED is at full power
+	 */
+	float B;
+
+	/**
+	 * Relative luma produced by the normalized levels, i.e. maximum achievable luma at this chromaticity
+	 */
+	float Y;
+};
+
+/**
+ * Precomputed solver coefficients for a fixture model
+ */
+struct LedSolver {
+	/**
+	 * Solver coefficients for red LED
+	 */
+	LedSolverChannel red;
+
+	/**
+	 * Solver coefficients for green LED
+	 */
+	LedSolverChannel green;
+
+	/**
+	 * Solver coefficients for blue LED
+	 */
+	LedSolverChannel blue;
+
+	/**
+	 * Relative luma of red LED at full power, all three sum up to 1
+	 */
+	float redY;
+
+	/**
+	 * Relative luma of green LED at full power, all three sum up to 1
+	 */
+	float greenY;
+
+	/**
+	 * Relative luma of blue LED at full power, all three sum up to 1
+	 */
+	float blueY;
+
+	/**
+	 * Solves normalized LED levels at compile time
+	 *
+	 * \param u Target u' coordinate
+	 * \param v Target v' coordinate
+	 * \return LED levels normalized to the brightest LED and the luma they produce
+	 */
+	constexpr LedUvNode nodeAt(const double u, const double v) const {
+		return node_(positive_(red.levelAt(u, v)), positive_(green.levelAt(u, v)), positive_(blue.levelAt(u, v)));
+	}
+
+	/**
+	 * Solves normalized LED levels at runtime, same as nodeAt
+	 *
+	 * \param u Target u' coordinate
+	 * \param v Target v' coordinate
+	 * \return LED levels normalized to the brightest LED and the luma they produce
+	 */
+	LedUvNode node(const double u, const double v) const;
+
+	/**
+	 * Computes solver coefficients for a fixture model
+	 *
+	 * Can be evaluated at compile time when calibration is a constexpr constant.
+	 *
+	 * \param calibration Calibration parameters
+	 * \return Solver coefficients
+	 */
+	static constexpr LedSolver fromCalibration(const LedCalibration &calibration) {
+		return LedSolver{
+			LedSolverChannel::fromCalibration(calibration.redUv, calibration.greenUv, calibration.blueUv, calibration.redToGreenFit, calibration.greenToBlueFit),
+			LedSolverChannel::fromCalibration(calibration.greenUv, calibration.blueUv, calibration.redUv, calibration.greenToBlueFit, calibration.blueToRedFit),
+			LedSolverChannel::fromCalibration(calibration.blueUv, calibration.redUv, calibration.greenUv, calibration.blueToRedFit, calibration.redToGreenFit),
+			calibration.redLum / (calibration.redLum + calibration.greenLum + calibration.blueLum),
+			calibration.greenLum / (calibration.redLum + calibration.greenLum + calibration.blueLum),
+			calibration.blueLum / (calibration.redLum + calibration.greenLum + calibration.blueLum)
+		};
+	}
+
+	/**
+	 * Solver coefficients for the default calibration
+	 *
+	 * \return Solver generated at compile time from LedCalibration::defaults()
+	 */
+	static const LedSolver &defaults();
+
+private:
+	static constexpr double positive_(const double x) {
+		return x > 0 ? x : 0.0;
+	}
+
+	constexpr LedUvNode node_(const double R, const double G, const double B) const {
+		return node_(R, G, B, R > G ? (R > B ? R : B) : (G > B ? G : B));
+	}
+
+	constexpr LedUvNode node_(const double R, const double G, const double B, const double maxRaw) const {
+		return maxRaw > 0
+			? LedUvNode{ float(R / maxRaw), float(G / maxRaw), float(B / maxRaw), float((R * redY + G * greenY + B * blueY) / maxRaw) }
+			: LedUvNode{ 0, 0, 0, 0 };
+	}
+};
+
+/**
+ * Compile time sequence of indices for generating tables
+ */
+template <uint16_t... I>
+struct LedIndices {};
+
+/**
+ * Generates LedIndices<0, 1, ..., N - 1> as LedIndexRange<N>::Type
+ */
+template <uint16_t N, uint16_t... I>
+struct LedIndexRange : LedIndexRange<N - 1, N - 1, I...> {};
+
+template <uint16_t... I>
+struct LedIndexRange<0, I...> {
+	typedef LedIndices<I...> Type;
+};
+
+/**
+ * Point on the Planckian locus in CIE 1976 UCS
+ */
+struct LedLocusPoint {
+	/**
+	 * u' coordinate
+	 */
+	float u;
+
+	/**
+	 * v' coordinate
+	 */
+	float v;
+};
+
+/**
+ * Correlated color temperature and distance from the Planckian locus
+ */
+struct LedTemperature {
+	/**
+	 * Reciprocal correlated color temperature in mireds
+	 */
+	float mired;
+
+	/**
+	 * Distance from the Planckian locus in CIE 1960 UCS, positive above the locus
+	 */
+	float duv;
+};
+
+/**
+ * Planckian locus lookup table sampled uniformly in mireds
+ *
+ * The table is generated at compile time from a least squares fit of CIE 1976 UCS coordinates vs color temperature,
+ * linear interpolation between 10 mired steps stays within 0.0003 of the fit. Each entry also has the unit normal of
+ * the locus in CIE 1960 UCS, where Duv is defined, expressed in u', v' units, so that a tint offset is a single
+ * multiply-add per coordinate.
+ */
+class LedLocus {
+public:
+	/**
+	 * Smallest tabulated reciprocal color temperature, 20000 K
+	 */
+	static const uint16_t MIRED_MIN = 50;
+
+	/**
+	 * Largest tabulated reciprocal color temperature, 1000 K
+	 */
+	static const uint16_t MIRED_MAX = 1000;
+
+	/**
+	 * Distance between table entries in mireds
+	 */
+	static const uint16_t MIRED_STEP = 10;
+
+	/**
+	 * Number of table entries
+	 */
+	static const uint16_t SIZE = (MIRED_MAX - MIRED_MIN) / MIRED_STEP + 1;
+
+	/**
+	 * Table entries
+	 */
+	struct Table {
+		LedLocusPoint points[SIZE];
+		LedLocusPoint normals[SIZE];
+	};
+
+	/**
+	 * Looks up CIE 1976 UCS coordinates for a reciprocal color temperature
+	 *
+	 * \param mired Reciprocal color temperature, clamped to the tabulated range
+	 * \return Interpolated point on the locus
+	 */
+	static LedLocusPoint fromMired(const float mired);
+
+	/**
+	 * Looks up CIE 1976 UCS coordinates for a color temperature
+	 *
+	 * \param T Color temperature in Kelvins, clamped to the tabulated range
+	 * \return Interpolated point on the locus
+	 */
+	static LedLocusPoint fromKelvin(const float T);
+
+	/**
+	 * Looks up CIE 1976 UCS coordinates for a reciprocal color temperature and a distance from the locus
+	 *
+	 * \param mired Reciprocal color temperature, clamped to the tabulated range
+	 * \param duv Distance from the locus in CIE 1960 UCS, positive values are above the locus towards green and
+	 *            negative below towards magenta
+	 * \return Interpolated point on the locus offset along its normal
+	 */
+	static LedLocusPoint fromMired(const float mired, const float duv);
+
+	/**
+	 * Estimates correlated color temperature and tint of CIE 1976 UCS coordinates
+	 *
+	 * Robertson's method on the lookup table: the table normals are the isotemperature lines, a binary search finds
+	 * the pair of lines the point falls between and the temperature is interpolated from the distances to them.
+	 * Accurate near the locus, say within Duv 0.02, below about 16000 K where the locus fit bends sharply.
+	 *
+	 * \param u u' coordinate
+	 * \param v v' coordinate
+	 * \return Reciprocal correlated color temperature clamped to the tabulated range and distance from the locus
+	 */
+	static LedTemperature toTemperature(const float u, const float v);
+
+	/**
+	 * Evaluates the locus fit
+	 *
+	 * These cryptic looking formulas are a result of polynomial least squares fit of CIE1976UCS coordinates vs
+	 * color temperature. Fit variable has been transformed to z-score in order to avoid floating point precision
+	 * problems.
+	 *
+	 * \param T Color temperature in Kelvins
+	 * \return CIE 1976 UCS coordinates
+	 */
+	static constexpr LedLocusPoint fit(const double T) {
+		return fit_((T - 5500.0) / 2599.0);
+	}
+
+	/**
+	 * Generates the lookup table
+	 *
+	 * \return Table sampled from the locus fit
+	 */
+	static constexpr Table generate() {
+		return generate_(LedIndexRange<SIZE>::Type());
+	}
+
+private:
+	static constexpr LedLocusPoint fit_(const double x) {
+		return LedLocusPoint{
+			float((-0.0001747*x*x*x + 0.1833*x*x + 0.872*x + 1.227) / (x*x + 4.813*x + 5.933)),
+			float((0.000311*x*x*x*x + 0.0009124*x*x*x + 0.3856*x*x + 1.873*x + 2.619) / (x*x + 4.323*x + 5.485))
+		};
+	}
+
+	/**
+	 * Evaluates the unit normal of the locus fit from the chord between two nearby points
+	 *
+	 * \param p0 Point half a table step cooler
+	 * \param p1 Point half a table step warmer
+	 * \return Normal pointing above the locus, in u', v' units
+	 */
+	static constexpr LedLocusPoint normal_(const LedLocusPoint p0, const LedLocusPoint p1) {
+		return unit_(double(p1.u) - p0.u, (double(p1.v) - p0.v) * 2 / 3);
+	}
+
+	/**
+	 * Rotates a CIE 1960 UCS tangent a quarter turn and normalizes it, v is converted back to v' units
+	 */
+	static constexpr LedLocusPoint unit_(const double du, const double dv) {
+		return LedLocusPoint{ float(-dv / sqrt_(du * du + dv * dv)), float(1.5 * du / sqrt_(du * du + dv * dv)) };
+	}
+
+	static constexpr double sqrt_(const double x) {
+		return x > 0 ? sqrtIterate_(x, x > 1 ? x : 1.0, 64) : 0.0;
+	}
+
+	static constexpr double sqrtIterate_(const double x, const double guess, const uint8_t n) {
+		return n == 0 ? guess : sqrtIterate_(x, (guess + x / guess) / 2, n - 1);
+	}
+
+	template <uint16_t... I>
+	static constexpr Table generate_(LedIndices<I...>) {
+		return Table{
+			{ fit(1000000.0 / (MIRED_MIN + I * MIRED_STEP))... },
+			{ normal_(fit(1000000.0 / (MIRED_MIN + I * MIRED_STEP - MIRED_STEP / 2.0)), fit(1000000.0 / (MIRED_MIN + I * MIRED_STEP + MIRED_STEP / 2.0)))... }
+		};
+	}
+};
+
+/**
+ * CIE 1976 lightness to relative luma lookup table
+ *
+ * The table is indexed by lightness, which is perceptually uniform, so low luma levels where the eye is most
+ * sensitive to steps get as much resolution as bright ones. Luma is in 16-bit fixed point, which matches the
+ * resolution of 16-bit PWM drivers.
+ */
+class LedLightness {
+public:
+	/**
+	 * Number of table entries spanning lightness 0..100
+	 */
+	static const uint16_t SIZE = 257;
+
+	/**
+	 * Table entries
+	 */
+	struct Table {
+		uint16_t luma[SIZE];
+	};
+
+	/**
+	 * Looks up relative luma for lightness
+	 *
+	 * \param L CIE 1976 lightness, limited in the range 0..100, NaN is treated as zero
+	 * \return Relative luma in 16-bit fixed point, 65535 is the luma of lightness 100
+	 */
+	static uint16_t toLuma(const float L);
+
+	/**
+	 * Looks up lightness for relative luma, inverse of toLuma
+	 *
+	 * \param Y Relative luma in 16-bit fixed point, 65535 is the luma of lightness 100
+	 * \return CIE 1976 lightness in the range 0..100
+	 */
+	static float fromLuma(const uint16_t Y);
+
+	/**
+	 * Converts CIE 1976 lightness to relative luma
+	 *
+	 * \param L CIE 1976 lightness
+	 * \return Relative luma in the range 0..1 for lightness 0..100
+	 */
+	static constexpr double luma(const double L) {
+		return L > 8 ? cube_((L + 16) / 116) : L * (27.0 / 24389.0);
+	}
+
+	/**
+	 * Converts relative luma to CIE 1976 lightness at compile time, inverse of luma
+	 *
+	 * Runtime code should use fromLuma instead of the Newton iteration used here.
+	 *
+	 * \param Y Relative luma in the range 0..1
+	 * \return CIE 1976 lightness in the range 0..100
+	 */
+	static constexpr double lightness(const double Y) {
+		return Y > 216.0 / 24389.0 ? 116 * cbrt_(Y) - 16 : Y * (24389.0 / 27.0);
+	}
+
+	/**
+	 * Generates the lookup table
+	 *
+	 * \return Table sampled from the lightness function
+	 */
+	static constexpr Table generate() {
+		return generate_(LedIndexRange<SIZE>::Type());
+	}
+
+private:
+	static constexpr double cube_(const double x) {
+		return x * x * x;
+	}
+
+	static constexpr double cbrt_(const double x) {
+		return cbrtIterate_(x, 1.0, 32);
+	}
+
+	static constexpr double cbrtIterate_(const double x, const double guess, const uint8_t n) {
+		return n == 0 ? guess : cbrtIterate_(x, (2 * guess + x / (guess * guess)) / 3, n - 1);
+	}
+
+	template <uint16_t... I>
+	static constexpr Table generate_(LedIndices<I...>) {
+		return Table{ { static_cast<uint16_t>(luma(100.0 * I / (SIZE - 1)) * 65535 + 0.5)... } };
+	}
+};
+
+/**
+ * Square grid of maximum achievable lightness spanning the bounding box of the RGB gamut in u', v'
+ *
+ * Maximum lightness is what the LEDs produce when the brightest of them is at full power, lightness 100 being all
+ * LEDs at full power. Grid is sampled in constant time and generated at compile time for a constexpr fixture model:
+ *
+ *     constexpr LedCalibration calibration = { ... };
+ *     constexpr LedSolver solver = LedSolver::fromCalibration(calibration);
+ *     constexpr LedLightnessGrid<16> grid = LedLightnessGrid<16>::generate(calibration, solver);
+ *
+ * Calibrations only known at runtime are built with N * N solves instead.
+ *
+ * \tparam N Number of nodes per side
+ */
+template <uint8_t N>
+struct LedLightnessGrid {
+	/**
+	 * Grid row with constant v'
+	 */
+	struct Row {
+		uint16_t lightness[N];
+	};
+
+	/**
+	 * u' coordinate of the first column
+	 */
+	float uMin;
+
+	/**
+	 * v' coordinate of the first row
+	 */
+	float vMin;
+
+	/**
+	 * Distance between adjacent nodes in u' and v'
+	 */
+	float step;
+
+	/**
+	 * Maximum lightness in 16-bit fixed point, 65535 is lightness 100, rows[j].lightness[i] is at
+	 * u' = uMin + i * step, v' = vMin + j * step
+	 */
+	Row rows[N];
+
+	/**
+	 * Bilinearly interpolates maximum lightness, coordinates outside of the grid are clamped to the edges
+	 *
+	 * \param u u' coordinate
+	 * \param v v' coordinate
+	 * \return Maximum CIE 1976 lightness
+	 */
+	float sample(const float u, const float v) const {
+		float x = (u - uMin) / step;
+		float y = (v - vMin) / step;
+		if (!(x > 0)) x = 0;
+		if (x > N - 1) x = N - 1;
+		if (!(y > 0)) y = 0;
+		if (y > N - 1) y = N - 1;
+		uint8_t i = x < N - 1 ? static_cast<uint8_t>(x) : N - 2;
+		uint8_t j = y < N - 1 ? static_cast<uint8_t>(y) : N - 2;
+		float tx = x - i;
+		float ty = y - j;
+		const uint16_t *r0 = rows[j].lightness;
+		const uint16_t *r1 = rows[j + 1].lightness;
+		float l0 = r0[i] + (r0[i + 1] - r0[i]) * tx;
+		float l1 = r1[i] + (r1[i + 1] - r1[i]) * tx;
+		return (l0 + (l1 - l0) * ty) * (100.0f / 65535);
+	}
+
+	/**
+	 * Generates the grid at compile time
+	 *
+	 * \param calibration Calibration parameters, LED coordinates define the grid extents
+	 * \param solver Solver coefficients computed from the same calibration
+	 * \return Grid of maximum lightness
+	 */
+	static constexpr LedLightnessGrid generate(const LedCalibration &calibration, const LedSolver &solver) {
+		return generate_(solver, uMin_(calibration), vMin_(calibration), step_(calibration),
+			typename LedIndexRange<N>::Type());
+	}
+
+	/**
+	 * Builds the grid at runtime, same as generate
+	 *
+	 * \param calibration Calibration parameters, LED coordinates define the grid extents
+	 * \param solver Solver coefficients computed from the same calibration
+	 * \return Grid of maximum lightness
+	 */
+	static LedLightnessGrid build(const LedCalibration &calibration, const LedSolver &solver) {
+		LedLightnessGrid grid;
+		grid.uMin = uMin_(calibration);
+		grid.vMin = vMin_(calibration);
+		grid.step = step_(calibration);
+
+		// Luma at full power converted to lightness
+		for (uint8_t j = 0; j < N; ++j) {
+			for (uint8_t i = 0; i < N; ++i) {
+				float Y = solver.node(grid.uMin + i * grid.step, grid.vMin + j * grid.step).Y;
+				uint16_t luma = Y < 1 ? static_cast<uint16_t>(Y * 65535 + 0.5f) : 65535;
+				grid.rows[j].lightness[i] = static_cast<uint16_t>(LedLightness::fromLuma(luma) * 655.35f + 0.5f);
+			}
+		}
+		return grid;
+	}
+
+private:
+	template <uint16_t... I>
+	static constexpr LedLightnessGrid generate_(const LedSolver &solver, const float uMin, const float vMin, const float step, LedIndices<I...> indices) {
+		return LedLightnessGrid{ uMin, vMin, step, { row_(solver, uMin, vMin + I * step, step, indices)... } };
+	}
+
+	template <uint16_t... I>
+	static constexpr Row row_(const LedSolver &solver, const float uMin, const float v, const float step, LedIndices<I...>) {
+		return Row{ { lightness_(solver.nodeAt(uMin + I * step, v).Y)... } };
+	}
+
+	static constexpr uint16_t lightness_(const float Y) {
+		return static_cast<uint16_t>(LedLightness::lightness(Y < 1 ? Y : 1) * 655.35 + 0.5);
+	}
+
+	static constexpr float uMin_(const LedCalibration &c) {
+		return min_(c.redUv.u, c.greenUv.u, c.blueUv.u);
+	}
+
+	static constexpr float vMin_(const LedCalibration &c) {
+		return min_(c.redUv.v, c.greenUv.v, c.blueUv.v);
+	}
+
+	static constexpr float step_(const LedCalibration &c) {
+		return max_(max_(c.redUv.u, c.greenUv.u, c.blueUv.u) - uMin_(c), max_(c.redUv.v, c.greenUv.v, c.blueUv.v) - vMin_(c), 0) / (N - 1);
+	}
+
+	static constexpr float min_(const float a, const float b, const float c) {
+		return a < b ? (a < c ? a : c) : (b < c ? b : c);
+	}
+
+	static constexpr float max_(const float a, const float b, const float c) {
+		return a > b ? (a > c ? a : c) : (b > c ? b : c);
+	}
+};
+
+#ifndef LED_LIGHTNESS_GRID
+/**
+ * Number of maximum lightness grid nodes per side, each fixture model keeps 2 * LED_LIGHTNESS_GRID^2 bytes of them
+ */
+#define LED_LIGHTNESS_GRID 16
+#endif
+
+/**
+ * Immutable fixture model holding everything derived from calibration
+ *
+ * All fixtures of the same model share one instance, so engines only keep a pointer to it next to their own light
+ * state. Models are typically static and generated at compile time:
+ *
+ *     static constexpr LedCalibration calibration = { ... };
+ *     static constexpr LedSolver solver = LedSolver::fromCalibration(calibration);
+ *     static constexpr LedModel model(calibration, solver,
+ *         LedLightnessGrid<LED_LIGHTNESS_GRID>::generate(calibration, solver));
+ *     light1.calibrate(model);
+ *     light2.calibrate(model);
+ *
+ * Models of calibrations only known at runtime are constructed from the calibration parameters.
+ *
+ * Engines calibrated with parameters allocate a model of their own, which is reference counted so that copies of an
+ * engine share it.
+ */
+class LedModel {
+public:
+	/**
+	 * Constructor
+	 *
+	 * \param calibration Calibration parameters, solver coefficients are computed from them
+	 */
+	LedModel(const LedCalibration &calibration);
+
+	/**
+	 * Constructor with precomputed solver coefficients
+	 *
+	 * \param calibration Calibration parameters
+	 * \param solver Solver coefficients computed from the same calibration parameters
+	 */
+	LedModel(const LedCalibration &calibration, const LedSolver &solver);
+
+	/**
+	 * Constructor with precomputed solver coefficients and maximum lightness grid
+	 *
+	 * \param calibration Calibration parameters
+	 * \param solver Solver coefficients computed from the same calibration parameters
+	 * \param lightnessGrid Maximum lightness grid generated from the same calibration parameters
+	 */
+	constexpr LedModel(const LedCalibration &calibration, const LedSolver &solver,
+		const LedLightnessGrid<LED_LIGHTNESS_GRID> &lightnessGrid)
+		: calibration_(calibration), solver_(solver), lightnessGrid_(lightnessGrid) {
+	}
+
+	LedModel(const LedModel &) = delete;
+
+	LedModel &operator=(const LedModel &) = delete;
+
+	/**
+	 * Get calibration parameters
+	 *
+	 * \return Calibration parameters
+	 */
+	const LedCalibration &getCalibration() const {
+		return calibration_;
+	}
+
+	/**
+	 * Get solver coefficients
+	 *
+	 * \return Solver coefficients
+	 */
+	const LedSolver &getSolver() const {
+		return solver_;
+	}
+
+	/**
+	 * Get maximum lightness grid
+	 *
+	 * \return Maximum lightness over the gamut
+	 */
+	const LedLightnessGrid<LED_LIGHTNESS_GRID> &getLightnessGrid() const {
+		return lightnessGrid_;
+	}
+
+	/**
+	 * Model for the default calibration
+	 *
+	 * \return Model used by LedEngine until calibrate is called
+	 */
+	static const LedModel &defaults();
+
+private:
+	friend class LedModelRef;
+
+	/**
+	 * Calibration parameters
+	 */
+	LedCalibration calibration_;
+
+	/**
+	 * Solver coefficients computed from calibration parameters
+	 */
+	LedSolver solver_;
+
+	/**
+	 * Maximum lightness over the gamut
+	 */
+	LedLightnessGrid<LED_LIGHTNESS_GRID> lightnessGrid_;
+
+	/**
+	 * Number of references to a model allocated by LedModelRef, zero for models owned by the caller
+	 */
+#ifdef LED_MODEL_ATOMIC
+	mutable std::atomic<uint32_t> references_{0};
+#else
+	mutable uint32_t references_ = 0;
+#endif
+};
+
+/**
+ * Reference to a shared fixture model
+ *
+ * Caller owned models are only pointed to. Models created with make are deleted when the last reference goes away.
+ */
+class LedModelRef {
+public:
+	/**
+	 * Constructor
+	 *
+	 * \param model Caller owned model which outlives the reference
+	 */
+	LedModelRef(const LedModel &model);
+
+	LedModelRef(const LedModelRef &other);
+
+	LedModelRef &operator=(const LedModelRef &other);
+
+	~LedModelRef();
+
+	/**
+	 * Allocates a model
+	 *
+	 * \param calibration Calibration parameters
+	 * \param solver Solver coefficients computed from the same calibration parameters
+	 * \return Reference owning the new model
+	 */
+	static LedModelRef make(const LedCalibration &calibration, const LedSolver &solver);
+
+	const LedModel *operator->() const {
+		return model_;
+	}
+
+	const LedModel &operator*() const {
+		return *model_;
+	}
+
+private:
+	/**
+	 * Referenced model
+	 */
+	const LedModel *model_;
+
+	/**
+	 * Takes a reference to the current model
+	 */
+	void acquire_();
+
+	/**
+	 * Drops the reference to the current model, deleting allocated models without references
+	 */
+	void release_();
+};
@@ -0,0 +1,75 @@
+#ifdef ARDUINO
+#include "Arduino.h"
+#endif
+#include "LedOutput.h"
+
+void LedOutput::flush() {
+	if (frameDepth_ == 0) {
+		write_();
+	}
+}
+
+void LedOutput::beginFrame() {
+	++frameDepth_;
+}
+
+void LedOutput::commitFrame() {
+	if (frameDepth_ == 0) return;
+	--frameDepth_;
+	flush();
+}
+
+bool LedOutput::inFrame() {
+	return frameDepth_ > 0;
+}
+
+#ifdef ARDUINO
+
+LedAnalogOutput &LedAnalogOutput::instance() {
+	static LedAnalogOutput output;
+	return output;
+}
+
+void LedAnalogOutput::attach(const uint16_t channel, const uint16_t pwmRange) {
+
+	// Set LED pin as output and set it off
+	analogWriteRange(pwmRange);
+	pinMode(channel, OUTPUT);
+	analogWrite(channel, 0);
+
+	// Already attached by another engine
+	for (uint8_t i = 0; i < count_; ++i) {
+		if (pins_[i] == channel) {
+			duty_[i] = 0;
+			return;
+		}
+	}
+
+	if (count_ < CAPACITY) {
+		pins_[count_] = channel;
+		duty_[count_] = 0;
+		++count_;
+	}
+}
+
+void LedAnalogOutput::set(const uint16_t channel, const uint16_t duty) {
+	for (uint8_t i = 0; i < count_; ++i) {
+		if (pins_[i] == channel) {
+			if (duty_[i] != duty) {
+				duty_[i] = duty;
+				dirty_ |= 1UL << i;
+			}
+			return;
+		}
+	}
+}
+
+void LedAnalogOutput::write_() {
+	for (uint8_t i = 0; dirty_ != 0; ++i, dirty_ >>= 1) {
+		if (dirty_ & 1) {
+			analogWrite(pins_[i], duty_[i]);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Output backend for PWM channels
+ *
+ * Engines stage channel duties with set and push them out with flush. Between beginFrame and commitFrame flushes
+ * are deferred, so that all channels of any number of engines sharing the backend are written together in a single
+ * backend flush:
+ *
+ *     output.beginFrame();
+ *     light1.setColorTemperature(50, 2700);
+ *     light2.setCie1976Ucs(luv);
+ *     output.commitFrame();
+ */
+class LedOutput {
+public:
+	virtual ~LedOutput() {}
+
+	/**
+	 * Prepares a channel for output, called once for each channel of an engine
+	 *
+	 * \param channel Channel number
+	 * \param pwmRange PWM bit width as a maximum possible value used by the engine
+	 */
+	virtual void attach(const uint16_t channel, const uint16_t pwmRange) = 0;
+
+	/**
+	 * Stages duty for a channel, nothing is written before flush
+	 *
+	 * \param channel Channel number
+	 * \param duty PWM duty
+	 */
+	virtual void set(const uint16_t channel, const uint16_t duty) = 0;
+
+	/**
+	 * Writes staged duties unless a frame is open
+	 */
+	void flush();
+
+	/**
+	 * Opens a frame, flushes are deferred until the frame is committed
+	 *
+	 * Frames can be nested, only committing the outermost frame writes the channels.
+	 */
+	void beginFrame();
+
+	/**
+	 * Commits a frame and writes all channels staged since beginFrame in one flush
+	 */
+	void commitFrame();
+
+	/**
+	 * Is a frame open?
+	 *
+	 * \return Is a frame open
+	 */
+	bool inFrame();
+
+protected:
+	/**
+	 * Writes all staged duties that have changed since the previous write
+	 */
+	virtual void write_() = 0;
+
+private:
+	/**
+	 * Number of open frames
+	 */
+	uint8_t frameDepth_ = 0;
+};
+
+/**
+ * Output backend which keeps committed duties in memory
+ *
+ * Useful for recording engine output on a host and as a staging area for backends which send whole frames at once.
+ *
+ * \tparam Channels Number of channels
+ */
+template <uint16_t Channels>
+class LedBufferOutput : public LedOutput {
+public:
+	void attach(const uint16_t channel, const uint16_t /*pwmRange*/) override {
+		if (channel < Channels) {
+			staged_[channel] = 0;
+			duty_[channel] = 0;
+		}
+	}
+
+	void set(const uint16_t channel, const uint16_t duty) override {
+		if (channel < Channels && staged_[channel] != duty) {
+			staged_[channel] = duty;
+			dirty_ = true;
+		}
+	}
+
+	/**
+	 * Get committed duty
+	 *
+	 * \param channel Channel number
+	 * \return Duty as of the latest flush
+	 */
+	uint16_t get(const uint16_t channel) {
+		return channel < Channels ? duty_[channel] : 0;
+	}
+
+	/**
+	 * Get committed duties
+	 *
+	 * \return Pointer to duties of all channels as of the latest flush
+	 */
+	const uint16_t *getDuties() {
+		return duty_;
+	}
+
+	/**
+	 * Get number of flushes which changed any channel
+	 *
+	 * \return Number of written frames
+	 */
+	uint32_t getFrameCount() {
+		return frameCount_;
+	}
+
+protected:
+	void write_() override {
+		if (!dirty_) return;
+		for (uint16_t i = 0; i < Channels; ++i) {
+			duty_[i] = staged_[i];
+		}
+		dirty_ = false;
+		++frameCount_;
+	}
+
+private:
+	/**
+	 * Duties staged for the next flush
+	 */
+	uint16_t staged_[Channels] = {};
+
+	/**
+	 * Duties as of the latest flush
+	 */
+	uint16_t duty_[Channels] = {};
+
+	/**
+	 * Has any staged duty changed since the latest flush?
+	 */
+	bool dirty_ = false;
+
+	/**
+	 * Number of written frames
+	 */
+	uint32_t frameCount_ = 0;
+};
+
+/**
+ * View of pixel colors in a caller owned buffer, e.g. a frame buffer which is sent to an LED strip as such
+ *
+ * Pixels are at fixed stride and each of them has red, green and blue components at the given byte offsets. 16-bit
+ * components are stored most significant byte first.
+ */
+struct LedPixels {
+	/**
+	 * First byte of the first pixel
+	 */
+	uint8_t *data;
+
+	/**
+	 * Number of pixels
+	 */
+	uint32_t count;
+
+	/**
+	 * Bytes from the start of a pixel to the start of the next
+	 */
+	uint8_t stride;
+
+	/**
+	 * Byte offset of red component within a pixel
+	 */
+	uint8_t red;
+
+	/**
+	 * Byte offset of green component within a pixel
+	 */
+	uint8_t green;
+
+	/**
+	 * Byte offset of blue component within a pixel
+	 */
+	uint8_t blue;
+
+	/**
+	 * Bytes per component, 1 or 2
+	 */
+	uint8_t bytes;
+
+	/**
+	 * Writes fixed point levels of a pixel
+	 *
+	 * \param index Pixel index
+	 * \param level Red, green and blue levels, 65536 is full power
+	 */
+	void setFixed(const uint32_t index, const uint32_t level[3]) const {
+		uint8_t *pixel = data + index * stride;
+		if (bytes == 2) {
+			put16_(pixel + red, level[0]);
+			put16_(pixel + green, level[1]);
+			put16_(pixel + blue, level[2]);
+		}
+		else {
+			pixel[red] = static_cast<uint8_t>((level[0] * 255 + 32768) >> 16);
+			pixel[green] = static_cast<uint8_t>((level[1] * 255 + 32768) >> 16);
+			pixel[blue] = static_cast<uint8_t>((level[2] * 255 + 32768) >> 16);
+		}
+	}
+
+	/**
+	 * Get view of a part of the pixels
+	 *
+	 * \param first Index of the first pixel
+	 * \param n Number of pixels
+	 * \return Pixels first..first + n - 1
+	 */
+	LedPixels slice(const uint32_t first, const uint32_t n) const {
+		LedPixels pixels = *this;
+		pixels.data += first * stride;
+		pixels.count = n;
+		return pixels;
+	}
+
+	/**
+	 * Rounds a number of pixels up so that their bytes span whole 64-byte cache lines
+	 *
+	 * Chunks of such size starting from a cache line aligned buffer never share cache lines, so separate threads can
+	 * fill them without false sharing.
+	 *
+	 * \param n Minimum number of pixels
+	 * \return Number of pixels
+	 */
+	uint32_t alignedCount(const uint32_t n) const {
+		uint8_t unit = 64;
+		while (unit > 1 && (static_cast<uint16_t>(unit) * stride) % 128 == 0) unit /= 2;
+		return (n + unit - 1) / unit * unit;
+	}
+
+private:
+	/**
+	 * Writes a fixed point level as a 16-bit component
+	 *
+	 * \param p First byte of the component
+	 * \param level Level, 65536 is full power
+	 */
+	static void put16_(uint8_t *p, const uint32_t level) {
+		uint16_t value = static_cast<uint16_t>((level * 65535 + 32768) >> 16);
+		p[0] = value >> 8;
+		p[1] = value & 0xFF;
+	}
+};
+
+#ifdef ARDUINO
+
+/**
+ * Output backend for the MCU's own PWM pins, channel numbers are GPIO pin numbers
+ */
+class LedAnalogOutput : public LedOutput {
+public:
+	/**
+	 * Maximum number of pins
+	 */
+	static const uint8_t CAPACITY = 20;
+
+	/**
+	 * Shared backend used by engines constructed with pin numbers
+	 *
+	 * \return Shared analogWrite backend
+	 */
+	static LedAnalogOutput &instance();
+
+	void attach(const uint16_t channel, const uint16_t pwmRange) override;
+
+	void set(const uint16_t channel, const uint16_t duty) override;
+
+protected:
+	void write_() override;
+
+private:
+	/**
+	 * GPIO pin numbers of attached pins
+	 */
+	uint8_t pins_[CAPACITY];
+
+	/**
+	 * Staged duties of attached pins
+	 */
+	uint16_t duty_[CAPACITY];
+
+	/**
+	 * Bit mask of pins whose duty has changed since the latest flush
+	 */
+	uint32_t dirty_ = 0;
+
+	/**
+	 * Number of attached pins
+	 */
+	uint8_t count_ = 0;
+};
+
+#endif
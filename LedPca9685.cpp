@@ -0,0 +1,128 @@
+#include "LedPca9685.h"
+
+/**
+ * Register addresses
+ */
+static const uint8_t MODE1 = 0x00;
+static const uint8_t MODE2 = 0x01;
+static const uint8_t LED0_ON_L = 0x06;
+static const uint8_t PRE_SCALE = 0xFE;
+
+/**
+ * Register bits
+ */
+static const uint8_t MODE1_AI = 0x20;
+static const uint8_t MODE1_SLEEP = 0x10;
+static const uint8_t MODE2_OUTDRV = 0x04;
+static const uint8_t LED_FULL = 0x10;
+
+LedPca9685Output::LedPca9685Output(LedI2cBus &bus, const uint8_t address, const uint8_t chips) {
+	bus_ = &bus;
+	address_ = address;
+	chips_ = chips < LED_PCA9685_MAX_CHIPS ? chips : LED_PCA9685_MAX_CHIPS;
+	for (uint16_t i = 0; i < LED_PCA9685_MAX_CHIPS * CHANNELS_PER_CHIP; ++i) {
+		duty_[i] = 0;
+		scale_[i] = 65536;
+	}
+	for (uint8_t i = 0; i < LED_PCA9685_MAX_CHIPS; ++i) {
+		dirty_[i] = 0;
+	}
+}
+
+bool LedPca9685Output::begin(const uint16_t frequency) {
+
+	// Prescaler for the 25 MHz internal oscillator
+	uint32_t prescale = (25000000UL + 2048UL * frequency) / (4096UL * frequency) - 1;
+	if (prescale < 3) prescale = 3;
+	if (prescale > 255) prescale = 255;
+
+	bool ok = true;
+	for (uint8_t chip = 0; chip < chips_; ++chip) {
+		uint8_t address = address_ + chip;
+
+		// Prescaler can only be written in sleep
+		uint8_t sleep[2] = { MODE1, MODE1_AI | MODE1_SLEEP };
+		uint8_t preScale[2] = { PRE_SCALE, static_cast<uint8_t>(prescale) };
+		uint8_t mode1[2] = { MODE1, MODE1_AI };
+		uint8_t mode2[2] = { MODE2, MODE2_OUTDRV };
+		ok = bus_->write(address, sleep, 2) && ok;
+		ok = bus_->write(address, preScale, 2) && ok;
+		ok = bus_->write(address, mode1, 2) && ok;
+		ok = bus_->write(address, mode2, 2) && ok;
+
+		// Chip state is unknown, write all channels on next flush
+		dirty_[chip] = 0xFFFF;
+	}
+	flush();
+	return ok;
+}
+
+void LedPca9685Output::attach(const uint16_t channel, const uint16_t pwmRange) {
+	if (channel >= chips_ * CHANNELS_PER_CHIP) return;
+	scale_[channel] = pwmRange > 0 ? (static_cast<uint32_t>(PWM_RANGE) << 16) / pwmRange : 65536;
+	set(channel, 0);
+}
+
+void LedPca9685Output::set(const uint16_t channel, const uint16_t duty) {
+	if (channel >= chips_ * CHANNELS_PER_CHIP) return;
+
+	// Rescale to native range
+	uint32_t scale = scale_[channel];
+	uint16_t native = scale == 65536 ? duty : static_cast<uint16_t>((duty * scale + 32768) >> 16);
+	if (native > PWM_RANGE) native = PWM_RANGE;
+
+	if (duty_[channel] != native) {
+		duty_[channel] = native;
+		dirty_[channel / CHANNELS_PER_CHIP] |= 1 << (channel % CHANNELS_PER_CHIP);
+	}
+}
+
+void LedPca9685Output::write_() {
+	for (uint8_t chip = 0; chip < chips_; ++chip) {
+		uint16_t dirty = dirty_[chip];
+		if (dirty == 0) continue;
+
+		// Span of changed channels, unchanged channels in between are rewritten with their current values
+		uint8_t first = 0;
+		while (!(dirty & (1 << first))) ++first;
+		uint8_t last = CHANNELS_PER_CHIP - 1;
+		while (!(dirty & (1 << last))) --last;
+
+		// Split only if the bus cannot take the whole span in one transaction
+		uint16_t perBurst = (bus_->getMaxLength() - 1) / 4;
+		if (perBurst == 0) return;
+		if (perBurst > CHANNELS_PER_CHIP) perBurst = CHANNELS_PER_CHIP;
+		bool ok = true;
+		for (uint8_t i = first; i <= last; i += perBurst) {
+			uint8_t end = i + perBurst - 1 < last ? i + perBurst - 1 : last;
+			ok = writeChannels_(chip, i, end) && ok;
+		}
+
+		// Retry on next flush if the chip did not acknowledge
+		if (ok) dirty_[chip] = 0;
+	}
+}
+
+bool LedPca9685Output::writeChannels_(const uint8_t chip, const uint8_t first, const uint8_t last) {
+	uint8_t data[1 + 4 * CHANNELS_PER_CHIP];
+	uint8_t length = 0;
+	data[length++] = LED0_ON_L + 4 * first;
+	for (uint8_t i = first; i <= last; ++i) {
+		uint16_t duty = duty_[chip * CHANNELS_PER_CHIP + i];
+		if (duty >= PWM_RANGE) {
+			// Full on
+			data[length++] = 0;
+			data[length++] = LED_FULL;
+			data[length++] = 0;
+			data[length++] = 0;
+		}
+		else {
+			// Turn on at the start of the period, off after duty counts, zero duty is full off
+			data[length++] = 0;
+			data[length++] = 0;
+			data[length++] = duty & 0xFF;
+			data[length++] = duty == 0 ? LED_FULL : duty >> 8;
+		}
+	}
+	return bus_->write(address_ + chip, data, length);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "LedI2c.h"
+#include "LedOutput.h"
+
+#ifndef LED_PCA9685_MAX_CHIPS
+/**
+ * Maximum number of chips driven by a single backend
+ */
+#define LED_PCA9685_MAX_CHIPS 4
+#endif
+
+/**
+ * Output backend for PCA9685 style 16-channel 12-bit I2C PWM controllers
+ *
+ * Chips are at consecutive I2C addresses, channel number is chip index * 16 + chip channel. Each flush writes all
+ * changed channels of a chip in a single auto-increment register burst, so a frame costs one I2C transaction per
+ * chip no matter how many fixtures changed. Engines should use PWM range 4095, other ranges are rescaled per channel,
+ * so engines with different ranges can share the chips.
+ */
+class LedPca9685Output : public LedOutput {
+public:
+	/**
+	 * Number of PWM channels per chip
+	 */
+	static const uint8_t CHANNELS_PER_CHIP = 16;
+
+	/**
+	 * Native PWM range
+	 */
+	static const uint16_t PWM_RANGE = 4095;
+
+	/**
+	 * Constructor
+	 *
+	 * \param bus I2C bus
+	 * \param address 7-bit I2C address of the first chip
+	 * \param chips Number of chips at consecutive addresses, at most LED_PCA9685_MAX_CHIPS
+	 */
+	LedPca9685Output(LedI2cBus &bus, const uint8_t address = 0x40, const uint8_t chips = 1);
+
+	/**
+	 * Configures chips for auto-increment and totem pole outputs and sets PWM frequency
+	 *
+	 * \param frequency PWM frequency in Hz
+	 * \return Did all chips acknowledge
+	 */
+	bool begin(const uint16_t frequency = 1000);
+
+	void attach(const uint16_t channel, const uint16_t pwmRange) override;
+
+	void set(const uint16_t channel, const uint16_t duty) override;
+
+protected:
+	void write_() override;
+
+private:
+	/**
+	 * I2C bus
+	 */
+	LedI2cBus *bus_;
+
+	/**
+	 * 7-bit I2C address of the first chip
+	 */
+	uint8_t address_;
+
+	/**
+	 * Number of chips
+	 */
+	uint8_t chips_;
+
+	/**
+	 * Fixed point factors from the PWM range of the attached engine to native range, 65536 is one
+	 */
+	uint32_t scale_[LED_PCA9685_MAX_CHIPS * CHANNELS_PER_CHIP];
+
+	/**
+	 * Staged duties in native range
+	 */
+	uint16_t duty_[LED_PCA9685_MAX_CHIPS * CHANNELS_PER_CHIP];
+
+	/**
+	 * Bit masks of channels changed since the latest flush, one per chip
+	 */
+	uint16_t dirty_[LED_PCA9685_MAX_CHIPS];
+
+	/**
+	 * Writes a range of channels of a chip in a single auto-increment burst
+	 *
+	 * \param chip Chip index
+	 * \param first First chip channel
+	 * \param last Last chip channel
+	 * \return Was the transaction acknowledged
+	 */
+	bool writeChannels_(const uint8_t chip, const uint8_t first, const uint8_t last);
+};
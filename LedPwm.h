@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "LedModel.h"
+
+/**
+ * Conversions between normalized raw levels and PWM duties for a PWM range known at compile time
+ *
+ * With the range as a template parameter multiplications by the range and its reciprocal are constants, so
+ * quantization compiles to multiplies and shifts without any divisions.
+ *
+ * \tparam Range PWM bit width as a maximum possible value e.g. 255, 1023 or 4095
+ */
+template <uint16_t Range>
+class LedPwm {
+public:
+	/**
+	 * PWM bit width as a maximum possible value
+	 */
+	static const uint16_t RANGE = Range;
+
+	/**
+	 * Converts normalized raw level to PWM duty
+	 *
+	 * \param raw Raw level, limited in the range 0..1, NaN is treated as zero
+	 * \return PWM duty in the range 0..Range
+	 */
+	static uint16_t toDuty(float raw) {
+		if (!(raw > 0)) raw = 0.0;
+		if (raw > 1) raw = 1.0;
+		return static_cast<uint16_t>(raw * Range + 0.5f);
+	}
+
+	/**
+	 * Converts normalized raw levels to PWM duties
+	 *
+	 * \param raw Raw levels, limited in the range 0..1
+	 * \param duty Output PWM duties for red, green and blue LEDs
+	 */
+	static void toDuty(const RGB raw, uint16_t duty[3]) {
+		duty[0] = toDuty(raw.R);
+		duty[1] = toDuty(raw.G);
+		duty[2] = toDuty(raw.B);
+	}
+
+	/**
+	 * Converts fixed point level to PWM duty with integer arithmetic only
+	 *
+	 * \param level Level in 16-bit fixed point, 65536 is full power
+	 * \return PWM duty in the range 0..Range
+	 */
+	static uint16_t fromFixed(const uint32_t level) {
+		return static_cast<uint16_t>((level * Range + 32768) >> 16);
+	}
+
+	/**
+	 * Converts PWM duty to normalized raw level
+	 *
+	 * \param duty PWM duty in the range 0..Range
+	 * \return Raw level in the range 0..1
+	 */
+	static float toRaw(const uint16_t duty) {
+		return duty * (1.0f / Range);
+	}
+};
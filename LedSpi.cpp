@@ -0,0 +1,60 @@
+#include "LedSpi.h"
+
+#ifdef ARDUINO
+
+LedArduinoSpiBus::LedArduinoSpiBus(SPIClass &spi, const uint32_t clock) {
+	spi_ = &spi;
+	clock_ = clock;
+}
+
+bool LedArduinoSpiBus::write(const uint8_t *data, const uint32_t length) {
+	spi_->beginTransaction(SPISettings(clock_, MSBFIRST, SPI_MODE0));
+#if defined(ESP8266) || defined(ESP32)
+	// Write only transfer, does not overwrite the frame buffer with received bytes
+	spi_->writeBytes(data, length);
+#else
+	for (uint32_t i = 0; i < length; ++i) {
+		spi_->transfer(data[i]);
+	}
+#endif
+	spi_->endTransaction();
+	return true;
+}
+
+#else
+
+#include <fcntl.h>
+#include <unistd.h>
+
+LedFileSpiBus::LedFileSpiBus(const char *path) {
+	fd_ = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+}
+
+LedFileSpiBus::~LedFileSpiBus() {
+	if (fd_ >= 0) close(fd_);
+}
+
+bool LedFileSpiBus::write(const uint8_t *data, const uint32_t length) {
+	if (fd_ < 0) return false;
+
+	// Clocked strips have no latch timing, so splitting a frame into several transfers is harmless
+	uint32_t written = 0;
+	while (written < length) {
+		uint32_t chunk = length - written < MAX_TRANSFER ? length - written : MAX_TRANSFER;
+		ssize_t n = ::write(fd_, data + written, chunk);
+		if (n <= 0) return false;
+		written += n;
+		byteCount_ += n;
+	}
+	return true;
+}
+
+bool LedFileSpiBus::isOpen() {
+	return fd_ >= 0;
+}
+
+uint32_t LedFileSpiBus::getByteCount() {
+	return byteCount_;
+}
+
+#endif
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * SPI bus used by addressable LED strip backends
+ */
+class LedSpiBus {
+public:
+	virtual ~LedSpiBus() {}
+
+	/**
+	 * Writes bytes to the bus, received bytes are discarded and the data is not modified
+	 *
+	 * \param data Bytes to write
+	 * \param length Number of bytes
+	 * \return Were all bytes written
+	 */
+	virtual bool write(const uint8_t *data, const uint32_t length) = 0;
+};
+
+#ifdef ARDUINO
+
+#include <SPI.h>
+
+/**
+ * SPI bus using the Arduino SPI library
+ */
+class LedArduinoSpiBus : public LedSpiBus {
+public:
+	/**
+	 * Constructor
+	 *
+	 * \param spi SPI instance, must be initialized with begin() by the caller
+	 * \param clock SPI clock frequency in Hz
+	 */
+	LedArduinoSpiBus(SPIClass &spi = SPI, const uint32_t clock = 4000000);
+
+	bool write(const uint8_t *data, const uint32_t length) override;
+
+private:
+	/**
+	 * SPI instance
+	 */
+	SPIClass *spi_;
+
+	/**
+	 * SPI clock frequency in Hz
+	 */
+	uint32_t clock_;
+};
+
+#else
+
+/**
+ * SPI bus for host builds writing to a file
+ *
+ * With a Linux spidev device such as /dev/spidev0.0 every write is an SPI transfer, with a regular file the bytes
+ * are appended to it, so that whole frames can be recorded and inspected without hardware.
+ */
+class LedFileSpiBus : public LedSpiBus {
+public:
+	/**
+	 * Maximum number of bytes in a single write, spidev rejects larger transfers by default
+	 */
+	static const uint32_t MAX_TRANSFER = 4096;
+
+	/**
+	 * Constructor
+	 *
+	 * \param path SPI device or file path, a missing file is created
+	 */
+	LedFileSpiBus(const char *path);
+
+	LedFileSpiBus(const LedFileSpiBus &) = delete;
+
+	LedFileSpiBus &operator=(const LedFileSpiBus &) = delete;
+
+	~LedFileSpiBus();
+
+	bool write(const uint8_t *data, const uint32_t length) override;
+
+	/**
+	 * Was the device or file opened?
+	 *
+	 * \return Is the bus usable
+	 */
+	bool isOpen();
+
+	/**
+	 * Get number of bytes written since construction
+	 *
+	 * \return Number of bytes written
+	 */
+	uint32_t getByteCount();
+
+private:
+	/**
+	 * File descriptor, negative if opening failed
+	 */
+	int fd_;
+
+	/**
+	 * Number of bytes written
+	 */
+	uint32_t byteCount_ = 0;
+};
+
+#endif
@@ -0,0 +1,376 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "LedModel.h"
+
+#ifndef ARDUINO
+#include <atomic>
+#endif
+
+/**
+ * Light state of an engine
+ */
+struct LedState {
+	/**
+	 * CIE 1976 UCS coordinates and lightness, negative if the color was not set by coordinates
+	 */
+	Luv luv;
+
+	/**
+	 * PWM duties for red, green and blue LEDs in the range 0..pwmRange
+	 */
+	uint16_t duty[3];
+
+	/**
+	 * Color temperature, 0xFFFF if the color was not set by color temperature
+	 */
+	uint16_t T;
+
+	/**
+	 * Distance from the Planckian locus in CIE 1960 UCS of a color set by color temperature
+	 */
+	float duv;
+
+	/**
+	 * Is the light on?
+	 */
+	bool onOff;
+};
+
+/**
+ * Light state packed into 16 bytes for keeping large numbers of fixtures in memory
+ *
+ * Lightness and u', v' coordinates are quantized to 16 bits, steps of 0.0015 in lightness and 0.00001 in u', v' are
+ * far below what is visible. Duties are kept as such, so a packed state drives the LEDs exactly like the original.
+ */
+struct LedPackedState {
+	/**
+	 * Lightness in the range 0..100 scaled to 0..65534, 0xFFFF if the color was not set by coordinates
+	 */
+	uint16_t L;
+
+	/**
+	 * u' coordinate in the range 0..0.625 scaled to 0..65535
+	 */
+	uint16_t u;
+
+	/**
+	 * v' coordinate in the range 0..0.625 scaled to 0..65535
+	 */
+	uint16_t v;
+
+	/**
+	 * PWM duties for red, green and blue LEDs in the range 0..pwmRange
+	 */
+	uint16_t duty[3];
+
+	/**
+	 * Color temperature limited to 32766 Kelvins, 0x7FFF if the color was not set by color temperature
+	 */
+	uint16_t T : 15;
+
+	/**
+	 * Is the light on?
+	 */
+	uint16_t onOff : 1;
+
+	/**
+	 * Distance from the Planckian locus in CIE 1960 UCS in units of 2^-19, range is about -0.0625..0.0625
+	 */
+	int16_t duv;
+
+	/**
+	 * Packs a light state
+	 *
+	 * \param state Light state
+	 * \return Packed light state
+	 */
+	static LedPackedState fromState(const LedState &state) {
+		LedPackedState packed;
+		if (state.luv.L >= 0) {
+			packed.L = quantize_(state.luv.L, 65534.0f / 100, 65534);
+			packed.u = quantize_(state.luv.u, 65535.0f / 0.625f, 65535);
+			packed.v = quantize_(state.luv.v, 65535.0f / 0.625f, 65535);
+		}
+		else {
+			packed.L = 0xFFFF;
+			packed.u = 0;
+			packed.v = 0;
+		}
+		packed.duty[0] = state.duty[0];
+		packed.duty[1] = state.duty[1];
+		packed.duty[2] = state.duty[2];
+		packed.T = state.T == 0xFFFF ? 0x7FFF : (state.T < 0x7FFF ? state.T : 0x7FFE);
+		packed.onOff = state.onOff ? 1 : 0;
+		float duv = state.T == 0xFFFF ? 0.0f : state.duv * 524288;
+		if (duv > 32767) duv = 32767;
+		if (duv < -32767) duv = -32767;
+		packed.duv = static_cast<int16_t>(duv < 0 ? duv - 0.5f : duv + 0.5f);
+		return packed;
+	}
+
+	/**
+	 * Unpacks the light state
+	 *
+	 * \return Light state
+	 */
+	LedState toState() const {
+		LedState state;
+		if (L != 0xFFFF) {
+			state.luv.L = L * (100.0f / 65534);
+			state.luv.u = u * (0.625f / 65535);
+			state.luv.v = v * (0.625f / 65535);
+		}
+		else {
+			state.luv.L = -1.0;
+			state.luv.u = -1.0;
+			state.luv.v = -1.0;
+		}
+		state.duty[0] = duty[0];
+		state.duty[1] = duty[1];
+		state.duty[2] = duty[2];
+		state.T = T == 0x7FFF ? 0xFFFF : T;
+		state.duv = duv * (1.0f / 524288);
+		state.onOff = onOff != 0;
+		return state;
+	}
+
+private:
+	/**
+	 * Scales a value to an unsigned 16-bit integer
+	 *
+	 * \param x Value
+	 * \param scale Scale
+	 * \param max Largest integer
+	 * \return Rounded value limited in the range 0..max
+	 */
+	static uint16_t quantize_(const float x, const float scale, const uint16_t max) {
+		float y = x * scale + 0.5f;
+		if (!(y > 0)) return 0;
+		if (y >= max) return max;
+		return static_cast<uint16_t>(y);
+	}
+};
+
+/**
+ * Change thresholds for skipping updates which would not be visible
+ *
+ * A threshold of zero disables the respective check. Differences are measured from the latest color which was
+ * actually written, so slow drifts are applied once they add up to a visible change.
+ */
+struct LedThreshold {
+	/**
+	 * CIE 1976 color difference, Delta E*uv, below which CIE 1976 UCS updates are skipped, also limits lightness
+	 * change of color temperature updates
+	 */
+	float deltaE;
+
+	/**
+	 * Distance in u', v' below which CIE 1976 UCS updates are skipped, also limits tint change of color temperature
+	 * updates
+	 */
+	float deltaUv;
+
+	/**
+	 * Reciprocal color temperature change in mireds below which color temperature updates are skipped
+	 */
+	float deltaMired;
+};
+
+#ifndef ARDUINO
+
+/**
+ * Sequence lock holding a value for a single writer and any number of readers
+ *
+ * The writer never waits and readers never lock, a reader which overlaps a store simply reads again. The value is
+ * kept in relaxed atomic words, so that concurrent access is well defined.
+ *
+ * \tparam T Trivially copyable value type
+ */
+template <typename T>
+class LedSeqlock {
+public:
+	LedSeqlock() {
+		T value;
+		memset(&value, 0, sizeof(T));
+		store(value);
+	}
+
+	LedSeqlock(const LedSeqlock &other) : LedSeqlock() {
+		store(other.load());
+	}
+
+	LedSeqlock &operator=(const LedSeqlock &other) {
+		store(other.load());
+		return *this;
+	}
+
+	/**
+	 * Publishes a value, must not be called from more than one thread at a time
+	 *
+	 * \param value Value to publish
+	 */
+	void store(const T &value) {
+		uint32_t words[WORDS] = {};
+		memcpy(words, &value, sizeof(T));
+
+		// Odd sequence marks a store in progress
+		uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+		sequence_.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (uint8_t i = 0; i < WORDS; ++i) {
+			words_[i].store(words[i], std::memory_order_relaxed);
+		}
+		sequence_.store(sequence + 2, std::memory_order_release);
+	}
+
+	/**
+	 * Reads a consistent snapshot of the latest published value
+	 *
+	 * \return Value
+	 */
+	T load() const {
+		uint32_t words[WORDS];
+		uint32_t before;
+		uint32_t after;
+		do {
+			before = sequence_.load(std::memory_order_acquire);
+			for (uint8_t i = 0; i < WORDS; ++i) {
+				words[i] = words_[i].load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = sequence_.load(std::memory_order_relaxed);
+		} while ((before & 1) || before != after);
+		T value;
+		memcpy(&value, words, sizeof(T));
+		return value;
+	}
+
+private:
+	/**
+	 * Number of 32-bit words needed for the value
+	 */
+	static const uint8_t WORDS = (sizeof(T) + 3) / 4;
+
+	/**
+	 * Value words
+	 */
+	std::atomic<uint32_t> words_[WORDS];
+
+	/**
+	 * Sequence number, incremented before and after each store
+	 */
+	std::atomic<uint32_t> sequence_{0};
+};
+
+/**
+ * Event counter incremented by one thread and read by any number of threads
+ *
+ * Relaxed atomic, readers only need the count itself and never order other data by it. Copies take the current count.
+ */
+class LedCounter {
+public:
+	LedCounter() {
+	}
+
+	LedCounter(const LedCounter &other) : count_(other.get()) {
+	}
+
+	LedCounter &operator=(const LedCounter &other) {
+		count_.store(other.get(), std::memory_order_relaxed);
+		return *this;
+	}
+
+	/**
+	 * Counts an event
+	 */
+	void increment() {
+		count_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Get number of counted events
+	 *
+	 * \return Count
+	 */
+	uint32_t get() const {
+		return count_.load(std::memory_order_relaxed);
+	}
+
+private:
+	/**
+	 * Count
+	 */
+	std::atomic<uint32_t> count_{0};
+};
+
+#else
+
+/**
+ * Value holder with the same interface as the host sequence lock for single threaded builds
+ *
+ * \tparam T Trivially copyable value type
+ */
+template <typename T>
+class LedSeqlock {
+public:
+	LedSeqlock() {
+		memset(&value_, 0, sizeof(T));
+	}
+
+	/**
+	 * Publishes a value
+	 *
+	 * \param value Value to publish
+	 */
+	void store(const T &value) {
+		value_ = value;
+	}
+
+	/**
+	 * Reads the latest published value
+	 *
+	 * \return Value
+	 */
+	T load() const {
+		return value_;
+	}
+
+private:
+	/**
+	 * Value
+	 */
+	T value_;
+};
+
+/**
+ * Event counter with the same interface as the host counter for single threaded builds
+ */
+class LedCounter {
+public:
+	/**
+	 * Counts an event
+	 */
+	void increment() {
+		++count_;
+	}
+
+	/**
+	 * Get number of counted events
+	 *
+	 * \return Count
+	 */
+	uint32_t get() const {
+		return count_;
+	}
+
+private:
+	/**
+	 * Count
+	 */
+	uint32_t count_ = 0;
+};
+
+#endif
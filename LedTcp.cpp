@@ -0,0 +1,90 @@
+#include "LedTcp.h"
+
+#ifndef ARDUINO
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+LedTcpServer::LedTcpServer(const uint16_t port, const char *address) {
+	fd_ = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd_ < 0) return;
+
+	// Restarting the server must not wait for connections of the previous one to time out
+	int on = 1;
+	setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	sockaddr_in local;
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_port = htons(port);
+	if (inet_pton(AF_INET, address, &local.sin_addr) != 1
+		|| bind(fd_, reinterpret_cast<sockaddr *>(&local), sizeof(local)) != 0
+		|| listen(fd_, 4) != 0
+		|| fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK) != 0) {
+		::close(fd_);
+		fd_ = -1;
+	}
+}
+
+LedTcpServer::~LedTcpServer() {
+	close();
+	if (fd_ >= 0) ::close(fd_);
+}
+
+bool LedTcpServer::isOpen() {
+	return fd_ >= 0;
+}
+
+bool LedTcpServer::accept() {
+	if (fd_ < 0 || client_ >= 0) return false;
+	client_ = ::accept(fd_, nullptr, nullptr);
+	if (client_ < 0) return false;
+	fcntl(client_, F_SETFL, fcntl(client_, F_GETFL) | O_NONBLOCK);
+	return true;
+}
+
+bool LedTcpServer::connected() {
+	return client_ >= 0;
+}
+
+uint16_t LedTcpServer::receive(uint8_t *buffer, const uint16_t size) {
+	if (client_ < 0) return 0;
+	ssize_t n = recv(client_, buffer, size, 0);
+	if (n > 0) return static_cast<uint16_t>(n);
+
+	// Zero is an orderly shutdown by the peer, would block just means nothing is waiting
+	if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) close();
+	return 0;
+}
+
+void LedTcpServer::write(const uint8_t *data, const uint16_t length) {
+	uint16_t sent = 0;
+	while (client_ >= 0 && sent < length) {
+		ssize_t n = send(client_, data + sent, length - sent, MSG_NOSIGNAL);
+		if (n > 0) {
+			sent += n;
+		}
+		else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			// Peer which stops reading for a second is dropped
+			pollfd p = { client_, POLLOUT, 0 };
+			if (poll(&p, 1, 1000) <= 0) close();
+		}
+		else {
+			close();
+		}
+	}
+}
+
+void LedTcpServer::close() {
+	if (client_ < 0) return;
+	::close(client_);
+	client_ = -1;
+}
+
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifndef ARDUINO
+
+#include "LedJson.h"
+
+/**
+ * Non-blocking TCP server for host builds which serves one connection at a time
+ *
+ * Serves request handlers such as LedHttpHandler on a host. Binding to 127.0.0.1 lets them be exercised with a
+ * browser or curl on the same machine. Written bytes go straight to the connection.
+ */
+class LedTcpServer : public LedWriter {
+public:
+	/**
+	 * Constructor
+	 *
+	 * \param port TCP port to listen on, e.g. 8080
+	 * \param address IPv4 address to bind to in dotted decimal notation, e.g. "127.0.0.1" for loopback only
+	 */
+	LedTcpServer(const uint16_t port, const char *address = "0.0.0.0");
+
+	LedTcpServer(const LedTcpServer &) = delete;
+
+	LedTcpServer &operator=(const LedTcpServer &) = delete;
+
+	~LedTcpServer();
+
+	/**
+	 * Was the socket opened, bound and put to listen?
+	 *
+	 * \return Is the server usable
+	 */
+	bool isOpen();
+
+	/**
+	 * Accepts a waiting connection unless one is open already, never blocks
+	 *
+	 * \return Was a connection accepted
+	 */
+	bool accept();
+
+	/**
+	 * Is a connection open?
+	 *
+	 * \return Is a connection open
+	 */
+	bool connected();
+
+	/**
+	 * Receives bytes of the open connection if some are waiting, never blocks
+	 *
+	 * The connection is closed when the peer has closed it.
+	 *
+	 * \param buffer Receive buffer
+	 * \param size Receive buffer size
+	 * \return Number of bytes received, zero if nothing was waiting
+	 */
+	uint16_t receive(uint8_t *buffer, const uint16_t size);
+
+	/**
+	 * Sends bytes to the open connection, waits until the socket buffer takes them
+	 *
+	 * \param data Bytes to send
+	 * \param length Number of bytes
+	 */
+	void write(const uint8_t *data, const uint16_t length) override;
+
+	/**
+	 * Closes the open connection
+	 */
+	void close();
+
+private:
+	/**
+	 * Listening socket descriptor, negative if opening failed
+	 */
+	int fd_;
+
+	/**
+	 * Connection socket descriptor, negative if no connection is open
+	 */
+	int client_ = -1;
+};
+
+#endif
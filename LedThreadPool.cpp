@@ -0,0 +1,168 @@
+#include "LedThreadPool.h"
+
+#ifndef ARDUINO
+
+#ifdef LED_ENGINE_POOL_BENCHMARK
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "LedEngine.h"
+#endif
+
+LedThreadPool::LedThreadPool(uint8_t threads) {
+	if (threads == 0) {
+		unsigned hardware = std::thread::hardware_concurrency();
+		threads = hardware > 0 && hardware < LED_THREAD_POOL_MAX_THREADS ? hardware : LED_THREAD_POOL_MAX_THREADS;
+	}
+	if (threads > LED_THREAD_POOL_MAX_THREADS) threads = LED_THREAD_POOL_MAX_THREADS;
+	threadCount_ = threads;
+	for (uint8_t i = 0; i < LED_THREAD_POOL_MAX_THREADS; ++i) {
+		ranges_[i].next.store(0, std::memory_order_relaxed);
+		ranges_[i].end = 0;
+	}
+
+	// Calling thread is thread zero
+	workers_ = new std::thread[threadCount_ - 1];
+	for (uint8_t i = 1; i < threadCount_; ++i) {
+		workers_[i - 1] = std::thread(&LedThreadPool::loop_, this, i);
+	}
+}
+
+LedThreadPool::~LedThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	start_.notify_all();
+	for (uint8_t i = 1; i < threadCount_; ++i) {
+		workers_[i - 1].join();
+	}
+	delete[] workers_;
+}
+
+uint8_t LedThreadPool::getThreadCount() {
+	return threadCount_;
+}
+
+void LedThreadPool::run_(const uint32_t count, const uint32_t grain, const Function function, const void *context) {
+	if (count == 0) return;
+
+	// Not worth waking anybody up
+	if (threadCount_ == 1 || count <= grain) {
+		function(context, 0, count);
+		return;
+	}
+
+	// Equal contiguous ranges, ends are fixed and only the fronts move while the job runs. Boundaries are multiples
+	// of the grain, so every chunk starts at a multiple of it and only the last one can be partial.
+	grain_ = grain > 0 ? grain : 1;
+	for (uint8_t i = 0; i < threadCount_; ++i) {
+		ranges_[i].next.store(static_cast<uint64_t>(count) * i / threadCount_ / grain_ * grain_, std::memory_order_relaxed);
+		ranges_[i].end = i + 1 < threadCount_ ? static_cast<uint64_t>(count) * (i + 1) / threadCount_ / grain_ * grain_
+			: count;
+	}
+	function_ = function;
+	context_ = context;
+
+	// Mutex publishes the job to the workers
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		busy_ = threadCount_ - 1;
+		++generation_;
+	}
+	start_.notify_all();
+
+	work_(0);
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	done_.wait(lock, [this] { return busy_ == 0; });
+}
+
+void LedThreadPool::work_(const uint8_t thread) {
+	for (uint8_t k = 0; k < threadCount_; ++k) {
+
+		// Own range first, then the others starting from the neighbour
+		Range &range = ranges_[(thread + k) % threadCount_];
+		while (true) {
+			uint32_t first = range.next.fetch_add(grain_, std::memory_order_relaxed);
+			if (first >= range.end) break;
+			uint32_t last = range.end - first < grain_ ? range.end : first + grain_;
+			function_(context_, first, last);
+		}
+	}
+}
+
+void LedThreadPool::loop_(const uint8_t thread) {
+	uint32_t generation = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			start_.wait(lock, [&] { return stop_ || generation_ != generation; });
+			if (stop_) return;
+			generation = generation_;
+		}
+
+		work_(thread);
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			last = --busy_ == 0;
+		}
+		if (last) done_.notify_one();
+	}
+}
+
+#ifdef LED_ENGINE_POOL_BENCHMARK
+/**
+ * Measures scaling of the pool overloads of the batch setters from one thread to many
+ *
+ * Arguments: largest thread count, default the number of hardware threads, and number of pixels, default 1000000
+ */
+int main(int argc, char **argv) {
+	unsigned hardware = std::thread::hardware_concurrency();
+	uint8_t threads = static_cast<uint8_t>(argc > 1 ? atoi(argv[1]) : (hardware > 0 ? hardware : 1));
+	if (threads < 1) threads = 1;
+	if (threads > LED_THREAD_POOL_MAX_THREADS) threads = LED_THREAD_POOL_MAX_THREADS;
+	uint32_t count = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1000000;
+
+	// Random in-gamut targets and temperatures, 8-bit RGB pixels in a 64-byte aligned buffer
+	LedBufferOutput<5> output;
+	LedEngine engine(output, 0, 1, 2, 3, 4, 4095);
+	std::vector<Luv> targets(count);
+	std::vector<float> L(count);
+	std::vector<uint16_t> T(count);
+	srand(1);
+	for (uint32_t i = 0; i < count; ++i) {
+		targets[i] = { 10.0f + rand() % 90, 0.19f + rand() % 80 * 0.001f, 0.46f + rand() % 50 * 0.001f };
+		L[i] = 10.0f + rand() % 90;
+		T[i] = static_cast<uint16_t>(2000 + rand() % 4500);
+	}
+	std::vector<uint8_t> buffer(3 * static_cast<size_t>(count) + 64);
+	uint8_t *data = buffer.data() + (64 - reinterpret_cast<uintptr_t>(buffer.data()) % 64) % 64;
+	LedPixels pixels = { data, count, 3, 0, 1, 2, 1 };
+
+	// Best of five runs for each setter and thread count
+	printf("threads  luv Mpx/s  temperature Mpx/s\n");
+	for (uint8_t n = 1; n <= threads; ++n) {
+		LedThreadPool pool(n);
+		double best[2] = { 0, 0 };
+		for (uint8_t setter = 0; setter < 2; ++setter) {
+			for (uint8_t run = 0; run < 5; ++run) {
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				if (setter == 0) engine.setCie1976Ucs(targets.data(), pixels, pool);
+				else engine.setColorTemperature(L.data(), T.data(), pixels, pool);
+				std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+				double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() * 1e-9;
+				double rate = seconds > 0 ? count / seconds * 1e-6 : 0;
+				if (rate > best[setter]) best[setter] = rate;
+			}
+		}
+		printf("%7u  %9.1f  %17.1f\n", n, best[0], best[1]);
+	}
+	return 0;
+}
+#endif
+
+#endif
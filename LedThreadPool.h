@@ -0,0 +1,172 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifndef ARDUINO
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#ifndef LED_THREAD_POOL_MAX_THREADS
+/**
+ * Maximum number of threads in a pool, including the calling thread
+ */
+#define LED_THREAD_POOL_MAX_THREADS 64
+#endif
+
+/**
+ * Thread pool for splitting batch conversions across cores on host builds
+ *
+ * A job is split into one contiguous range per thread. Each thread claims chunks from the front of its own range and
+ * when it runs out steals chunks from the ranges of the others, so uneven progress, e.g. from other load on the
+ * machine, does not leave cores idle. The calling thread takes part in every job.
+ *
+ *     LedThreadPool pool(16);
+ *     engine.setCie1976Ucs(targets, pixels, pool);
+ */
+class LedThreadPool {
+public:
+	/**
+	 * Constructor
+	 *
+	 * \param threads Number of threads including the calling thread, zero for the number of hardware threads
+	 */
+	LedThreadPool(uint8_t threads = 0);
+
+	LedThreadPool(const LedThreadPool &) = delete;
+
+	LedThreadPool &operator=(const LedThreadPool &) = delete;
+
+	~LedThreadPool();
+
+	/**
+	 * Get number of threads including the calling thread
+	 *
+	 * \return Number of threads
+	 */
+	uint8_t getThreadCount();
+
+	/**
+	 * Runs a function over a range of indices and waits until all of them are done
+	 *
+	 * Every chunk starts at a multiple of the grain, so chunks of a grain spanning whole cache lines never share them.
+	 *
+	 * \param count Number of indices
+	 * \param grain Number of indices claimed at a time
+	 * \param f Function called with the first and one past the last index of each chunk
+	 */
+	template <typename F>
+	void run(const uint32_t count, const uint32_t grain, const F &f) {
+		run_(count, grain, &call_<F>, &f);
+	}
+
+private:
+	/**
+	 * Type erased chunk function
+	 */
+	typedef void (*Function)(const void *context, uint32_t first, uint32_t last);
+
+	/**
+	 * Range of indices owned by a thread, on its own cache line so that claiming does not contend with neighbours
+	 */
+	struct alignas(64) Range {
+		std::atomic<uint32_t> next;
+		uint32_t end;
+	};
+
+	/**
+	 * Ranges of the current job, one per thread
+	 */
+	Range ranges_[LED_THREAD_POOL_MAX_THREADS];
+
+	/**
+	 * Worker threads, the calling thread is thread zero and has no entry
+	 */
+	std::thread *workers_;
+
+	/**
+	 * Number of threads including the calling thread
+	 */
+	uint8_t threadCount_;
+
+	/**
+	 * Chunk function of the current job
+	 */
+	Function function_ = nullptr;
+
+	/**
+	 * Chunk function context of the current job
+	 */
+	const void *context_ = nullptr;
+
+	/**
+	 * Number of indices claimed at a time
+	 */
+	uint32_t grain_ = 1;
+
+	/**
+	 * Job number, incremented to wake up the workers
+	 */
+	uint32_t generation_ = 0;
+
+	/**
+	 * Number of workers still running the current job
+	 */
+	uint8_t busy_ = 0;
+
+	/**
+	 * Is the pool shutting down?
+	 */
+	bool stop_ = false;
+
+	/**
+	 * Protects job number, busy count and stop flag
+	 */
+	std::mutex mutex_;
+
+	/**
+	 * Wakes up workers for a new job
+	 */
+	std::condition_variable start_;
+
+	/**
+	 * Wakes up the calling thread when the workers are done
+	 */
+	std::condition_variable done_;
+
+	/**
+	 * Calls a function object for a chunk
+	 */
+	template <typename F>
+	static void call_(const void *context, uint32_t first, uint32_t last) {
+		(*static_cast<const F *>(context))(first, last);
+	}
+
+	/**
+	 * Splits a job into ranges, runs it and waits for completion
+	 *
+	 * \param count Number of indices
+	 * \param grain Number of indices claimed at a time
+	 * \param function Chunk function
+	 * \param context Chunk function context
+	 */
+	void run_(const uint32_t count, const uint32_t grain, const Function function, const void *context);
+
+	/**
+	 * Runs chunks of the own range and then steals from the others
+	 *
+	 * \param thread Thread index
+	 */
+	void work_(const uint8_t thread);
+
+	/**
+	 * Worker thread main loop
+	 *
+	 * \param thread Thread index
+	 */
+	void loop_(const uint8_t thread);
+};
+
+#endif
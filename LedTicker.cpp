@@ -0,0 +1,127 @@
+#include "LedTicker.h"
+
+#if defined(LED_ENGINE_TICK_BENCHMARK) && !defined(ARDUINO)
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#endif
+
+LedTicker::LedTicker(LedClock &clock, LedTransition *transitions, const uint8_t count, LedOutput *output,
+	const uint32_t interval) {
+	clock_ = &clock;
+	transitions_ = transitions;
+	output_ = output;
+	count_ = count;
+	interval_ = interval > 0 ? interval : 1;
+	last_ = clock_->micros();
+}
+
+bool LedTicker::tick(const uint8_t budget) {
+	uint32_t late = clock_->micros() - last_;
+	if (late < interval_) return false;
+
+	// Schedule stays aligned to the interval, ticks missed in between are dropped
+	uint32_t ticks = late / interval_;
+	uint32_t advance = ticks * interval_;
+	missedCount_ += ticks - 1;
+	last_ += advance;
+	millis_ += advance / 1000;
+	remainder_ += advance % 1000;
+	if (remainder_ >= 1000) {
+		++millis_;
+		remainder_ -= 1000;
+	}
+
+	// Round robin from where the previous tick ran out of budget
+	if (output_) output_->beginFrame();
+	uint8_t stepped = 0;
+	uint8_t visited = 0;
+	for (; visited < count_ && stepped < budget; ++visited) {
+		LedTransition &transition = transitions_[next_];
+		if (++next_ == count_) next_ = 0;
+		if (!transition.isRunning()) continue;
+		transition.update(millis_);
+		++stepped;
+	}
+	if (output_) output_->commitFrame();
+
+	// Over budget only if a running transition was left out
+	for (uint8_t i = next_; visited < count_; ++visited) {
+		if (transitions_[i].isRunning()) {
+			++deferredCount_;
+			break;
+		}
+		if (++i == count_) i = 0;
+	}
+	++tickCount_;
+	return true;
+}
+
+uint32_t LedTicker::now() {
+	return millis_ + (remainder_ + (clock_->micros() - last_)) / 1000;
+}
+
+uint32_t LedTicker::getTickCount() {
+	return tickCount_;
+}
+
+uint32_t LedTicker::getMissedCount() {
+	return missedCount_;
+}
+
+uint32_t LedTicker::getDeferredCount() {
+	return deferredCount_;
+}
+
+#if defined(LED_ENGINE_TICK_BENCHMARK) && !defined(ARDUINO)
+/**
+ * Runs fades of many engines on a simulated clock and measures how much faster than real time it goes
+ *
+ * Arguments: simulated seconds, default 3600, and tick budget, default 4
+ */
+int main(int argc, char **argv) {
+	uint32_t seconds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 3600;
+	uint8_t budget = argc > 2 ? static_cast<uint8_t>(atoi(argv[2])) : 4;
+
+	// Sixteen fixtures ticked every 10 ms, each starting a new fade every few seconds
+	static const uint8_t ENGINES = 16;
+	LedBufferOutput<5 * ENGINES> output;
+	LedEngine *engines[ENGINES];
+	std::vector<LedTransition> transitions;
+	for (uint8_t i = 0; i < ENGINES; ++i) {
+		engines[i] = new LedEngine(output, 5 * i, 5 * i + 1, 5 * i + 2, 5 * i + 3, 5 * i + 4, 4095);
+		engines[i]->setOnOff(true);
+		transitions.push_back(LedTransition(*engines[i]));
+	}
+	LedSimulatedClock clock;
+	LedTicker ticker(clock, transitions.data(), ENGINES, &output);
+	srand(1);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t ms = 0; ms < seconds * 1000; ++ms) {
+		clock.advance(1000);
+		if (ms % 250 == 0) {
+			uint8_t i = static_cast<uint8_t>(rand() % ENGINES);
+			if (rand() % 2) transitions[i].start(20 + rand() % 70, 2000 + rand() % 4500, 0, 500 + rand() % 4000, ticker.now());
+			else transitions[i].start({ 20.0f + rand() % 70, 0.19f + rand() % 80 * 0.001f, 0.46f + rand() % 50 * 0.001f },
+				500 + rand() % 4000, ticker.now());
+		}
+		ticker.tick(budget);
+	}
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	double wall = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() * 1e-6;
+
+	uint32_t solved = 0;
+	for (uint8_t i = 0; i < ENGINES; ++i) solved += engines[i]->getSolvedCount();
+	printf("simulated seconds %u\n", seconds);
+	printf("wall seconds      %.3f\n", wall);
+	printf("speedup           %.0f\n", wall > 0 ? seconds / wall : 0);
+	printf("ticks             %u\n", ticker.getTickCount());
+	printf("missed ticks      %u\n", ticker.getMissedCount());
+	printf("deferred ticks    %u\n", ticker.getDeferredCount());
+	printf("solves            %u\n", solved);
+	printf("frames            %u\n", output.getFrameCount());
+	return 0;
+}
+#endif
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "LedClock.h"
+#include "LedOutput.h"
+#include "LedTransition.h"
+
+/**
+ * Fixed rate tick loop stepping the transitions of engines
+ *
+ * Ticks are scheduled at multiples of the interval on the clock, not relative to when tick was called, so a late call
+ * does not shift later ticks. Transitions see the scheduled time of the tick, which keeps fades smooth even when the
+ * main loop is jittery. Each tick steps at most a budget of transitions, one solve each, and the next tick continues
+ * with the transitions that were left out, so a tick never takes longer than the budget allows.
+ *
+ *     LedTicker ticker(LedSystemClock::instance(), transitions, 4, &output);
+ *     transitions[0].start(60, 2700, 0, 1000, ticker.now());
+ *     ...
+ *     void loop() {
+ *         ticker.tick(2);
+ *     }
+ *
+ * With LedSimulatedClock everything is deterministic, e.g. an hour of fades runs in well under a second on a host.
+ * Building with LED_ENGINE_TICK_BENCHMARK defined adds a main function which does that.
+ */
+class LedTicker {
+public:
+	/**
+	 * Constructor
+	 *
+	 * \param clock Time source, must outlive the ticker
+	 * \param transitions Transitions stepped by the ticks, kept by reference
+	 * \param count Number of transitions
+	 * \param output Output backend shared by the engines, if given every tick is written in a single frame
+	 * \param interval Tick interval in microseconds
+	 */
+	LedTicker(LedClock &clock, LedTransition *transitions, const uint8_t count, LedOutput *output = nullptr,
+		const uint32_t interval = 10000);
+
+	/**
+	 * Runs a tick if one is due
+	 *
+	 * Ticks which were missed because the call came late are dropped rather than run back to back.
+	 *
+	 * \param budget Most transitions to step in this tick
+	 * \return Was a tick due
+	 */
+	bool tick(const uint8_t budget = 0xFF);
+
+	/**
+	 * Get current time in the timebase of the transitions
+	 *
+	 * Use for starting transitions, e.g. as the time passed to LedCommandReceiver::handle. Counts from zero at
+	 * construction, so the clock must be read by tick or now at least once per 71 minutes.
+	 *
+	 * \return Milliseconds since construction
+	 */
+	uint32_t now();
+
+	/**
+	 * Get number of ticks run since construction
+	 *
+	 * \return Number of ticks
+	 */
+	uint32_t getTickCount();
+
+	/**
+	 * Get number of ticks dropped because tick was called late
+	 *
+	 * \return Number of missed ticks
+	 */
+	uint32_t getMissedCount();
+
+	/**
+	 * Get number of ticks whose budget ran out before all running transitions were stepped
+	 *
+	 * \return Number of ticks over budget
+	 */
+	uint32_t getDeferredCount();
+
+private:
+	/**
+	 * Time source
+	 */
+	LedClock *clock_;
+
+	/**
+	 * Transitions stepped by the ticks
+	 */
+	LedTransition *transitions_;
+
+	/**
+	 * Output backend shared by the engines, nullptr if not framed
+	 */
+	LedOutput *output_;
+
+	/**
+	 * Number of transitions
+	 */
+	uint8_t count_;
+
+	/**
+	 * Index of the transition stepped first by the next tick
+	 */
+	uint8_t next_ = 0;
+
+	/**
+	 * Tick interval in microseconds
+	 */
+	uint32_t interval_;
+
+	/**
+	 * Clock time of the latest scheduled tick
+	 */
+	uint32_t last_;
+
+	/**
+	 * Whole milliseconds from construction to the latest scheduled tick
+	 */
+	uint32_t millis_ = 0;
+
+	/**
+	 * Microseconds left over from the whole milliseconds
+	 */
+	uint32_t remainder_ = 0;
+
+	/**
+	 * Number of ticks run
+	 */
+	uint32_t tickCount_ = 0;
+
+	/**
+	 * Number of ticks dropped
+	 */
+	uint32_t missedCount_ = 0;
+
+	/**
+	 * Number of ticks over budget
+	 */
+	uint32_t deferredCount_ = 0;
+};
@@ -0,0 +1,213 @@
+#include <string.h>
+#include "LedTrace.h"
+
+#ifndef ARDUINO
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#endif
+
+static void put32(uint8_t *p, const uint32_t x) {
+	p[0] = x & 0xFF;
+	p[1] = (x >> 8) & 0xFF;
+	p[2] = (x >> 16) & 0xFF;
+	p[3] = x >> 24;
+}
+
+LedTrace::LedTrace(uint8_t *storage, const uint32_t size, LedClock &clock) {
+	clock_ = &clock;
+	storage_ = storage;
+	capacity_ = size / ENTRY_SIZE;
+}
+
+void LedTrace::record(const uint8_t id, const LedCommand &command) {
+	if (capacity_ == 0) return;
+	uint8_t *entry = storage_ + head_ * ENTRY_SIZE;
+	put32(entry, clock_->micros());
+	LedCommand target = command;
+	target.target = id;
+	LedCommandReceiver::encode(target, entry + 4);
+	if (++head_ == capacity_) head_ = 0;
+	++total_;
+}
+
+uint32_t LedTrace::getCount() {
+	return total_ < capacity_ ? total_ : capacity_;
+}
+
+uint32_t LedTrace::getTotal() {
+	return total_;
+}
+
+const uint8_t *LedTrace::get(const uint32_t i) {
+	// Oldest entry is at the head once the buffer has wrapped around
+	uint32_t count = getCount();
+	uint32_t index = (count < capacity_ ? 0 : head_) + i;
+	if (index >= capacity_) index -= capacity_;
+	return storage_ + index * ENTRY_SIZE;
+}
+
+void LedTrace::dump(LedWriter &writer) {
+	// Held entries are at most two contiguous runs, written in chunks the writer can take
+	uint32_t count = getCount();
+	uint32_t i = 0;
+	while (i < count) {
+		uint32_t first = (count < capacity_ ? 0 : head_) + i;
+		if (first >= capacity_) first -= capacity_;
+		uint32_t run = capacity_ - first;
+		if (run > count - i) run = count - i;
+		if (run > 0xFFFF / ENTRY_SIZE) run = 0xFFFF / ENTRY_SIZE;
+		writer.write(storage_ + first * ENTRY_SIZE, static_cast<uint16_t>(run * ENTRY_SIZE));
+		i += run;
+	}
+}
+
+void LedTrace::clear() {
+	head_ = 0;
+	total_ = 0;
+}
+
+#ifndef ARDUINO
+
+static uint32_t get32(const uint8_t *p) {
+	return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16
+		| static_cast<uint32_t>(p[3]) << 24;
+}
+
+/**
+ * Value of a sorted vector at a percentile
+ */
+static float percentile(const std::vector<float> &sorted, const float p) {
+	if (sorted.empty()) return 0;
+	size_t i = static_cast<size_t>(p / 100 * (sorted.size() - 1) + 0.5f);
+	return sorted[i];
+}
+
+LedReplay::LedReplay(const uint8_t *trace, const uint32_t length) {
+	trace_ = trace;
+	count_ = length / LedTrace::ENTRY_SIZE;
+}
+
+uint32_t LedReplay::getCount() {
+	return count_;
+}
+
+uint16_t LedReplay::getEngineCount() {
+	uint16_t count = 0;
+	for (uint32_t i = 0; i < count_; ++i) {
+		uint8_t id = trace_[i * LedTrace::ENTRY_SIZE + 5];
+		if (id != LedCommandReceiver::ALL && id >= count) count = id + 1;
+	}
+	return count;
+}
+
+LedReplayReport LedReplay::run(LedEngine *const *engines, LedEngine *const *references, const uint8_t count) {
+	LedReplayReport report = {};
+	LedCommandReceiver receiver(engines, count);
+	LedCommandReceiver reference(references, references ? count : 0);
+	std::vector<float> latency;
+	latency.reserve(count_);
+	double total = 0;
+	uint64_t span = 0;
+	for (uint32_t i = 0; i < count_; ++i) {
+		const uint8_t *entry = trace_ + i * LedTrace::ENTRY_SIZE;
+
+		// Unsigned difference stays correct when the timestamp wraps around
+		if (i > 0) span += get32(entry) - get32(entry - LedTrace::ENTRY_SIZE);
+
+		LedCommand command;
+		if (!LedCommandReceiver::parse(entry + 4, command) || command.target >= count
+			|| command.type == LedCommandType::Transition) {
+			++report.skipped;
+			continue;
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		receiver.dispatch(command, 0, 0);
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		float nanoseconds = static_cast<float>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+		latency.push_back(nanoseconds);
+		total += nanoseconds;
+		++report.count;
+
+		if (!references) continue;
+		reference.dispatch(command, 0, 0);
+		LedState a = engines[command.target]->getState();
+		LedState b = references[command.target]->getState();
+		uint16_t divergence = 0;
+		for (uint8_t j = 0; j < 3; ++j) {
+			uint16_t d = a.duty[j] > b.duty[j] ? a.duty[j] - b.duty[j] : b.duty[j] - a.duty[j];
+			if (d > divergence) divergence = d;
+		}
+		if (divergence > 0) ++report.divergent;
+		if (divergence > report.maxDivergence) report.maxDivergence = divergence;
+	}
+
+	std::sort(latency.begin(), latency.end());
+	report.recordedSeconds = span * 1e-6;
+	report.callsPerSecond = total > 0 ? report.count * 1e9 / total : 0;
+	report.p50Nanoseconds = percentile(latency, 50);
+	report.p99Nanoseconds = percentile(latency, 99);
+	report.maxNanoseconds = latency.empty() ? 0 : latency.back();
+	return report;
+}
+
+void LedReplay::print(const LedReplayReport &report) {
+	printf("calls             %u\n", report.count);
+	printf("skipped           %u\n", report.skipped);
+	printf("recorded seconds  %.3f\n", report.recordedSeconds);
+	printf("calls per second  %.0f\n", report.callsPerSecond);
+	printf("ns per call p50   %.1f\n", report.p50Nanoseconds);
+	printf("ns per call p99   %.1f\n", report.p99Nanoseconds);
+	printf("ns per call max   %.1f\n", report.maxNanoseconds);
+	printf("divergent calls   %u\n", report.divergent);
+	printf("divergence max    %u\n", report.maxDivergence);
+}
+
+#ifdef LED_ENGINE_REPLAY_MAIN
+/**
+ * Replays a trace file
+ *
+ * Arguments: trace file, candidate solver mode "closed" or "newton", default newton
+ */
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s trace [closed|newton]\n", argv[0]);
+		return 2;
+	}
+	FILE *file = fopen(argv[1], "rb");
+	if (!file) {
+		perror(argv[1]);
+		return 2;
+	}
+	std::vector<uint8_t> trace;
+	uint8_t buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) trace.insert(trace.end(), buffer, buffer + n);
+	fclose(file);
+	LedSolverMode mode = argc > 2 && strcmp(argv[2], "closed") == 0 ? LedSolverMode::ClosedForm : LedSolverMode::Newton;
+
+	// Engines with five channels each in separate outputs for the candidate and the reference
+	LedReplay replay(trace.data(), static_cast<uint32_t>(trace.size()));
+	uint8_t count = static_cast<uint8_t>(replay.getEngineCount());
+	LedBufferOutput<5 * 255> *outputs = new LedBufferOutput<5 * 255>[2];
+	std::vector<LedEngine *> engines, references;
+	for (uint8_t i = 0; i < count; ++i) {
+		engines.push_back(new LedEngine(outputs[0], 5 * i, 5 * i + 1, 5 * i + 2, 5 * i + 3, 5 * i + 4, 4095));
+		references.push_back(new LedEngine(outputs[1], 5 * i, 5 * i + 1, 5 * i + 2, 5 * i + 3, 5 * i + 4, 4095));
+		engines.back()->setSolverMode(mode);
+	}
+	LedReplayReport report = replay.run(engines.data(), references.data(), count);
+	LedReplay::print(report);
+	for (uint8_t i = 0; i < count; ++i) {
+		delete engines[i];
+		delete references[i];
+	}
+	delete[] outputs;
+	return 0;
+}
+#endif
+
+#endif
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "LedClock.h"
+#include "LedCommand.h"
+#include "LedJson.h"
+
+/**
+ * Ring buffer recording the color setters called on engines
+ *
+ * Each call takes one entry: a 32-bit timestamp in microseconds of the trace clock followed by the call as a command
+ * record of LedCommandReceiver, so arguments are quantized like those of received commands. Once the buffer is full
+ * the oldest entries are overwritten. The storage is supplied by the caller and nothing is allocated.
+ *
+ *     static uint8_t storage[1024 * LedTrace::ENTRY_SIZE];
+ *     LedTrace trace(storage, sizeof(storage));
+ *     light1.setTrace(&trace, 0);
+ *     light2.setTrace(&trace, 1);
+ *     ...
+ *     trace.dump(writer);
+ *
+ * Traced are setOnOff, setRaw, setCie1976Ucs and setColorTemperature for a single light. Batch setters, setState and
+ * configuration calls are not. Engines sharing a trace must be set from the same thread.
+ *
+ * Dumped traces are replayed on a host with LedReplay.
+ */
+class LedTrace {
+public:
+	/**
+	 * Bytes per entry, timestamp and command record
+	 */
+	static const uint8_t ENTRY_SIZE = 4 + LedCommandReceiver::RECORD_SIZE;
+
+	/**
+	 * Constructor
+	 *
+	 * \param storage Storage for the entries, must outlive the trace
+	 * \param size Storage size in bytes, a trailing partial entry is not used
+	 * \param clock Source of the timestamps, must outlive the trace
+	 */
+	LedTrace(uint8_t *storage, const uint32_t size, LedClock &clock = LedSystemClock::instance());
+
+	/**
+	 * Records a call
+	 *
+	 * \param id Engine identifier, stored as the record target
+	 * \param command Call as a command
+	 */
+	void record(const uint8_t id, const LedCommand &command);
+
+	/**
+	 * Get number of entries held
+	 *
+	 * \return Number of entries, at most the capacity
+	 */
+	uint32_t getCount();
+
+	/**
+	 * Get number of calls recorded since construction or clear, including overwritten ones
+	 *
+	 * \return Number of recorded calls
+	 */
+	uint32_t getTotal();
+
+	/**
+	 * Get an entry
+	 *
+	 * \param i Entry index, 0 is the oldest entry held
+	 * \return Entry bytes, ENTRY_SIZE of them
+	 */
+	const uint8_t *get(const uint32_t i);
+
+	/**
+	 * Writes the held entries oldest first
+	 *
+	 * \param writer Destination, e.g. a file or a socket
+	 */
+	void dump(LedWriter &writer);
+
+	/**
+	 * Discards all entries
+	 */
+	void clear();
+
+private:
+	/**
+	 * Source of the timestamps
+	 */
+	LedClock *clock_;
+
+	/**
+	 * Entry storage
+	 */
+	uint8_t *storage_;
+
+	/**
+	 * Number of entries the storage holds
+	 */
+	uint32_t capacity_;
+
+	/**
+	 * Index of the entry written next
+	 */
+	uint32_t head_ = 0;
+
+	/**
+	 * Number of recorded calls
+	 */
+	uint32_t total_ = 0;
+};
+
+#ifndef ARDUINO
+
+/**
+ * Statistics of a trace replay
+ */
+struct LedReplayReport {
+	/**
+	 * Number of replayed calls
+	 */
+	uint32_t count;
+
+	/**
+	 * Number of entries with unknown type or engine
+	 */
+	uint32_t skipped;
+
+	/**
+	 * Time span of the recorded calls in seconds
+	 */
+	double recordedSeconds;
+
+	/**
+	 * Replayed calls per second
+	 */
+	double callsPerSecond;
+
+	/**
+	 * Median call latency in nanoseconds
+	 */
+	float p50Nanoseconds;
+
+	/**
+	 * 99th percentile call latency in nanoseconds
+	 */
+	float p99Nanoseconds;
+
+	/**
+	 * Largest call latency in nanoseconds
+	 */
+	float maxNanoseconds;
+
+	/**
+	 * Number of calls after which the duties of the engine differed from the reference
+	 */
+	uint32_t divergent;
+
+	/**
+	 * Largest difference in PWM steps between the duties of an engine and the reference
+	 */
+	uint16_t maxDivergence;
+};
+
+/**
+ * Replays recorded traces against engines on host builds
+ *
+ * Calls are executed back to back as fast as possible and each one is timed. Engines can run on any output backend
+ * and with any solver settings. Passing reference engines, e.g. with default settings, replays each call on them too
+ * and compares the resulting duties, which shows whether an optimization changes the output for real traffic.
+ *
+ *     LedReplay replay(bytes, length);
+ *     LedReplayReport report = replay.run(candidates, references, count);
+ *     LedReplay::print(report);
+ *
+ * Building with LED_ENGINE_REPLAY_MAIN defined adds a main function which replays a trace file with the closed form
+ * solver as the reference and the solver mode given as an argument as the candidate.
+ */
+class LedReplay {
+public:
+	/**
+	 * Constructor
+	 *
+	 * \param trace Dumped trace, must outlive the replay
+	 * \param length Number of bytes, a trailing partial entry is ignored
+	 */
+	LedReplay(const uint8_t *trace, const uint32_t length);
+
+	/**
+	 * Get number of entries
+	 *
+	 * \return Number of entries
+	 */
+	uint32_t getCount();
+
+	/**
+	 * Get number of engines the trace addresses
+	 *
+	 * \return Highest engine identifier plus one
+	 */
+	uint16_t getEngineCount();
+
+	/**
+	 * Replays all entries
+	 *
+	 * \param engines Engines addressed by identifier
+	 * \param references Reference engines addressed by identifier, nullptr to skip the comparison
+	 * \param count Number of engines
+	 * \return Statistics
+	 */
+	LedReplayReport run(LedEngine *const *engines, LedEngine *const *references, const uint8_t count);
+
+	/**
+	 * Prints statistics to standard output
+	 *
+	 * \param report Statistics
+	 */
+	static void print(const LedReplayReport &report);
+
+private:
+	/**
+	 * Dumped trace
+	 */
+	const uint8_t *trace_;
+
+	/**
+	 * Number of entries
+	 */
+	uint32_t count_;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "LedTransition.h"
+
+LedTransition::LedTransition(LedEngine &engine) {
+	engine_ = &engine;
+}
+
+void LedTransition::start(const Luv target, const uint32_t duration, const uint32_t now) {
+	Luv current = engine_->getCie1976Ucs();
+	if (duration == 0 || current.L < 0) {
+		running_ = false;
+		engine_->setCie1976Ucs(target);
+		return;
+	}
+	from_[0] = current.L;
+	from_[1] = current.u;
+	from_[2] = current.v;
+	to_[0] = target.L;
+	to_[1] = target.u;
+	to_[2] = target.v;
+	kelvin_ = false;
+	start_ = now;
+	duration_ = duration;
+	running_ = true;
+}
+
+void LedTransition::start(const float L, const uint16_t T, const float duv, const uint32_t duration, const uint32_t now) {
+	LedState state = engine_->getState();
+
+	// Correlated color temperature of the current color, estimated unless set by color temperature
+	uint16_t current = state.T != 0xFFFF ? state.T : engine_->getColorTemperature();
+	if (duration == 0 || current == 0xFFFF || current == 0 || T == 0) {
+		running_ = false;
+		if (duv == 0) engine_->setColorTemperature(L, T);
+		else engine_->setColorTemperature(L, T > 0 ? 1000000.0f / T : LedLocus::MIRED_MAX, duv);
+		return;
+	}
+	from_[0] = state.luv.L >= 0 ? state.luv.L : engine_->getLightness();
+	from_[1] = 1000000.0f / current;
+	from_[2] = state.T != 0xFFFF ? state.duv : engine_->getDuv();
+	to_[0] = L;
+	to_[1] = 1000000.0f / T;
+	to_[2] = duv;
+	T_ = T;
+	kelvin_ = true;
+	start_ = now;
+	duration_ = duration;
+	running_ = true;
+}
+
+bool LedTransition::update(const uint32_t now) {
+	if (!running_) return false;
+
+	// Unsigned difference stays correct when the millisecond counter wraps around
+	uint32_t elapsed = now - start_;
+	if (elapsed >= duration_) {
+		running_ = false;
+		apply_(1);
+		return false;
+	}
+	apply_(static_cast<float>(elapsed) / duration_);
+	return true;
+}
+
+void LedTransition::stop() {
+	running_ = false;
+}
+
+bool LedTransition::isRunning() {
+	return running_;
+}
+
+LedEngine &LedTransition::getEngine() {
+	return *engine_;
+}
+
+void LedTransition::apply_(const float t) {
+	float x[3];
+	for (uint8_t i = 0; i < 3; ++i) {
+		x[i] = from_[i] + t * (to_[i] - from_[i]);
+	}
+	if (!kelvin_) {
+		Luv luv = { x[0], x[1], x[2] };
+		engine_->setCie1976Ucs(luv);
+	}
+	else if (t >= 1 && to_[2] == 0) {
+		// Exact target temperature instead of the rounded equivalent of the mireds
+		engine_->setColorTemperature(to_[0], T_);
+	}
+	else {
+		engine_->setColorTemperature(x[0], x[1], x[2]);
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "LedEngine.h"
+
+/**
+ * Fades an engine from its current color to a target over time
+ *
+ * Colors set by CIE 1976 UCS coordinates are interpolated linearly in lightness and u', v'. Colors set by color
+ * temperature are interpolated in lightness, mireds and Duv, so that the fade follows the Planckian locus and the
+ * engine keeps reporting a color temperature. Time is any millisecond counter, e.g. millis() or LedTicker::now, and
+ * wraps around safely.
+ *
+ *     LedTransition transition(light);
+ *     transition.start(50, 2700, 0, 1000, millis());
+ *     ...
+ *     transition.update(millis());
+ */
+class LedTransition {
+public:
+	/**
+	 * Constructor
+	 *
+	 * \param engine Engine whose color is faded
+	 */
+	LedTransition(LedEngine &engine);
+
+	/**
+	 * Starts a fade to CIE 1976 UCS coordinates
+	 *
+	 * Jumps straight to the target if the duration is zero or the current color is raw.
+	 *
+	 * \param target CIE 1976 UCS coordinates and lightness
+	 * \param duration Duration in milliseconds
+	 * \param now Current time in milliseconds
+	 */
+	void start(const Luv target, const uint32_t duration, const uint32_t now);
+
+	/**
+	 * Starts a fade to a color temperature
+	 *
+	 * Current color is taken as its correlated color temperature if it was not set by color temperature. Jumps
+	 * straight to the target if the duration is zero or the current color is black raw color.
+	 *
+	 * \param L CIE 1976 lightness
+	 * \param T Color temperature in Kelvins
+	 * \param duv Distance from the Planckian locus in CIE 1960 UCS
+	 * \param duration Duration in milliseconds
+	 * \param now Current time in milliseconds
+	 */
+	void start(const float L, const uint16_t T, const float duv, const uint32_t duration, const uint32_t now);
+
+	/**
+	 * Sets the engine to the color of the current time
+	 *
+	 * \param now Current time in milliseconds
+	 * \return Is the fade still running
+	 */
+	bool update(const uint32_t now);
+
+	/**
+	 * Stops the fade at the current color
+	 */
+	void stop();
+
+	/**
+	 * Is a fade running?
+	 *
+	 * \return Is a fade running
+	 */
+	bool isRunning();
+
+	/**
+	 * Get engine
+	 *
+	 * \return Engine whose color is faded
+	 */
+	LedEngine &getEngine();
+
+private:
+	/**
+	 * Engine whose color is faded
+	 */
+	LedEngine *engine_;
+
+	/**
+	 * Start color, lightness and u', v' or lightness, mireds and Duv
+	 */
+	float from_[3];
+
+	/**
+	 * Target color, lightness and u', v' or lightness, mireds and Duv
+	 */
+	float to_[3];
+
+	/**
+	 * Target color temperature in Kelvins, set exactly when the fade ends
+	 */
+	uint16_t T_ = 0;
+
+	/**
+	 * Start time in milliseconds
+	 */
+	uint32_t start_ = 0;
+
+	/**
+	 * Duration in milliseconds
+	 */
+	uint32_t duration_ = 0;
+
+	/**
+	 * Is the fade by color temperature?
+	 */
+	bool kelvin_ = false;
+
+	/**
+	 * Is a fade running?
+	 */
+	bool running_ = false;
+
+	/**
+	 * Sets the engine to a color between start and target
+	 *
+	 * \param t Fraction of the fade in the range 0..1
+	 */
+	void apply_(const float t);
+};
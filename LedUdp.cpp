@@ -0,0 +1,57 @@
+#include "LedUdp.h"
+
+#ifndef ARDUINO
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+LedUdpSocket::LedUdpSocket(const uint16_t port, const char *address) {
+	fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd_ < 0) return;
+
+	// Let several receivers share a port, desks broadcast to all of them
+	int on = 1;
+	setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	sockaddr_in local;
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_port = htons(port);
+	if (inet_pton(AF_INET, address, &local.sin_addr) != 1
+		|| bind(fd_, reinterpret_cast<sockaddr *>(&local), sizeof(local)) != 0
+		|| fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK) != 0) {
+		close(fd_);
+		fd_ = -1;
+	}
+}
+
+LedUdpSocket::~LedUdpSocket() {
+	if (fd_ >= 0) close(fd_);
+}
+
+bool LedUdpSocket::isOpen() {
+	return fd_ >= 0;
+}
+
+uint16_t LedUdpSocket::receive(uint8_t *buffer, const uint16_t size) {
+	if (fd_ < 0) return 0;
+	ssize_t n = recv(fd_, buffer, size, 0);
+	return n > 0 ? static_cast<uint16_t>(n) : 0;
+}
+
+bool LedUdpSocket::send(const char *address, const uint16_t port, const uint8_t *data, const uint16_t length) {
+	if (fd_ < 0) return false;
+	sockaddr_in remote;
+	memset(&remote, 0, sizeof(remote));
+	remote.sin_family = AF_INET;
+	remote.sin_port = htons(port);
+	if (inet_pton(AF_INET, address, &remote.sin_addr) != 1) return false;
+	ssize_t n = sendto(fd_, data, length, 0, reinterpret_cast<sockaddr *>(&remote), sizeof(remote));
+	return n == length;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifndef ARDUINO
+
+/**
+ * Non-blocking UDP socket for host builds
+ *
+ * Receives network protocols such as Art-Net and sACN on a host. Binding to 127.0.0.1 and sending to the same port
+ * loops packets back, so that receivers can be exercised without a network or a lighting desk.
+ */
+class LedUdpSocket {
+public:
+	/**
+	 * Constructor
+	 *
+	 * \param port UDP port to bind to, e.g. 6454 for Art-Net or 5568 for sACN
+	 * \param address IPv4 address to bind to in dotted decimal notation, e.g. "127.0.0.1" for loopback only
+	 */
+	LedUdpSocket(const uint16_t port, const char *address = "0.0.0.0");
+
+	LedUdpSocket(const LedUdpSocket &) = delete;
+
+	LedUdpSocket &operator=(const LedUdpSocket &) = delete;
+
+	~LedUdpSocket();
+
+	/**
+	 * Was the socket opened and bound?
+	 *
+	 * \return Is the socket usable
+	 */
+	bool isOpen();
+
+	/**
+	 * Receives a datagram if one is waiting, never blocks
+	 *
+	 * \param buffer Receive buffer
+	 * \param size Receive buffer size, longer datagrams are truncated
+	 * \return Number of bytes received, zero if nothing was waiting
+	 */
+	uint16_t receive(uint8_t *buffer, const uint16_t size);
+
+	/**
+	 * Sends a datagram
+	 *
+	 * \param address Destination IPv4 address in dotted decimal notation
+	 * \param port Destination UDP port
+	 * \param data Bytes to send
+	 * \param length Number of bytes
+	 * \return Was the whole datagram sent
+	 */
+	bool send(const char *address, const uint16_t port, const uint8_t *data, const uint16_t length);
+
+private:
+	/**
+	 * Socket descriptor, negative if opening failed
+	 */
+	int fd_;
+};
+
+#endif